@@ -1,4 +1,6 @@
+import ctypes
 import hashlib
+import os
 import string
 
 def generate_pmkid(pmk, mac_ap, mac_sta):
@@ -44,12 +46,96 @@ def generate_rand_pmks(max_len):
         yield from generate_permutations(perms, len)
         len += 1
 
+# Bindings for the C API in src/metaling.h, which hashes candidates with the CPU engine in-process.
+
+METALING_ABI_VERSION = 1
+METALING_MODE_PMK = 0
+CANDIDATE_SIZE = 64
+
+class MetalingTarget(ctypes.Structure):
+    _fields_ = [
+        ("essid", ctypes.c_uint8 * 32),
+        ("essid_len", ctypes.c_uint32),
+        ("mac_ap", ctypes.c_uint8 * 6),
+        ("mac_sta", ctypes.c_uint8 * 6),
+        ("hash", ctypes.c_uint8 * 20),
+    ]
+
+class MetalingHit(ctypes.Structure):
+    _fields_ = [("candidate_idx", ctypes.c_uint64), ("target_idx", ctypes.c_uint64)]
+
+def load_metaling(path):
+    lib = ctypes.CDLL(path)
+    lib.metaling_abi_version.restype = ctypes.c_uint32
+    lib.metaling_create.restype = ctypes.c_void_p
+    lib.metaling_create.argtypes = [
+        ctypes.c_int, ctypes.POINTER(MetalingTarget), ctypes.c_uint64, ctypes.c_char_p, ctypes.c_uint32,
+    ]
+    lib.metaling_destroy.argtypes = [ctypes.c_void_p]
+    lib.metaling_check.restype = ctypes.c_uint64
+    lib.metaling_check.argtypes = [
+        ctypes.c_void_p, ctypes.c_void_p, ctypes.c_uint64, ctypes.POINTER(MetalingHit), ctypes.c_uint64,
+    ]
+    lib.metaling_last_error.restype = ctypes.c_char_p
+
+    if lib.metaling_abi_version() != METALING_ABI_VERSION:
+        raise RuntimeError(f"{path} has an incompatible ABI version")
+    return lib
+
+def find_with_metaling(lib, target, mac_ap, mac_sta, pmks, batch_size=1 << 16):
+    t = MetalingTarget()
+    t.mac_ap[:] = mac_ap
+    t.mac_sta[:] = mac_sta
+    t.hash[:] = target
+
+    engine = lib.metaling_create(METALING_MODE_PMK, ctypes.byref(t), 1, None, 0)
+    if not engine:
+        raise RuntimeError(lib.metaling_last_error().decode())
+
+    # The engine reads the candidates straight out of this buffer.
+    buf = bytearray(batch_size * CANDIDATE_SIZE)
+    view = (ctypes.c_uint8 * len(buf)).from_buffer(buf)
+    hits = (MetalingHit * 1)()
+
+    try:
+        batch = []
+        for pmk in pmks:
+            batch.append(pmk)
+            if len(batch) < batch_size:
+                continue
+
+            found = check_batch(lib, engine, buf, view, hits, batch)
+            if found:
+                return found
+            batch = []
+
+        return check_batch(lib, engine, buf, view, hits, batch) if batch else None
+    finally:
+        lib.metaling_destroy(engine)
+
+def check_batch(lib, engine, buf, view, hits, batch):
+    buf[:] = bytes(len(buf))
+    for idx, pmk in enumerate(batch):
+        buf[idx * CANDIDATE_SIZE:idx * CANDIDATE_SIZE + len(pmk)] = pmk
+
+    if lib.metaling_check(engine, view, len(batch), hits, len(hits)):
+        return batch[hits[0].candidate_idx]
+    return None
+
 if __name__ == "__main__":
     mac_ap = mac_to_bytes('00:11:22:33:44:55')
     mac_sta = mac_to_bytes('66:77:88:99:AA:BB')
 
     target = generate_pmkid(b"lol", mac_ap, mac_sta)
 
+    # e.g. METALING_LIB=build/libmetaling.so
+    lib_path = os.environ.get("METALING_LIB")
+    if lib_path:
+        pmk = find_with_metaling(load_metaling(lib_path), target, mac_ap, mac_sta, generate_rand_pmks(4))
+        if pmk:
+            print(f"passphrase is: {pmk.decode('ascii')} ({target.hex()})")
+        exit()
+
     for pmk in generate_rand_pmks(4):
         pmkid = generate_pmkid(pmk, mac_ap, mac_sta)
 
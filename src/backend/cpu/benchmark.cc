@@ -0,0 +1,273 @@
+#include "src/backend/cpu/benchmark.hpp"
+#include "src/backend/cpu/cpu.hpp"
+#include "src/backend/cpu/kernels.hpp"
+#include "src/backend/cpu/modes.hpp"
+#include "src/backend/cpu/perf.hpp"
+#include "src/backend/cpu/topology.hpp"
+#include "src/common.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <random>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+namespace cpu::benchmark {
+
+// Long enough to never run out of candidates during a benchmark.
+const char* PATTERN = "????????";
+
+// Targets per run in the multi-target configurations, all of them sharing one ESSID.
+const u64 MULTI_TARGET_COUNT = 16;
+
+struct Entry {
+    kernels::Kernel kernel;
+    Mode mode;
+    u64 target_count;
+    Result result;
+
+    // Rate relative to a perfect linear scaling of the single threaded rate.
+    f64 efficiency;
+
+    // Whether `result.perf` holds hardware counts, see `Config::perf_report`.
+    bool perf_report;
+};
+
+Job make_job(Mode mode, u64 target_count) {
+    Job job = Job{
+        .pattern = PATTERN,
+        .mode = mode,
+        .targets = std::vector<Target>(target_count),
+    };
+
+    std::mt19937 rng(target_count);
+    for (Target& target : job.targets) {
+        memcpy(target.essid, "metaling", 8);
+        target.essid_len = 8;
+
+        for (u64 idx = 0; idx < 6; idx++) {
+            target.mac_ap[idx] = rng();
+            target.mac_sta[idx] = rng();
+        }
+
+        for (u64 idx = 0; idx < 5; idx++)
+            target.hash[idx] = rng();
+    }
+
+    return job;
+}
+
+Entry measure(
+    const Config& config,
+    const Options& options,
+    kernels::Kernel kernel,
+    Mode mode,
+    u64 target_count,
+    u64 thread_count) {
+    Config run_config = config;
+    run_config.kernel = kernel;
+    run_config.thread_count = thread_count;
+    run_config.time_limit = options.warmup + options.duration;
+    run_config.warmup = options.warmup;
+    run_config.verbose = false;
+
+    Entry entry = Entry{
+        .kernel = kernel,
+        .mode = mode,
+        .target_count = target_count,
+        .result = run(make_job(mode, target_count), run_config),
+        .efficiency = 0.0,
+        .perf_report = config.perf_report,
+    };
+
+    return entry;
+}
+
+void print_row(const Entry& entry) {
+    printf(
+        "  %-8s %-10s %7lld %7lld %14.1f",
+        kernels::name(entry.kernel),
+        modes::name(entry.mode),
+        entry.target_count,
+        entry.result.thread_count,
+        entry.result.rate);
+
+    if (entry.result.cycles_per_hash > 0.0)
+        printf(" %12.1f", entry.result.cycles_per_hash);
+    else
+        printf(" %12s", "-");
+
+    if (entry.efficiency > 0.0)
+        printf(" %9.1f%%", entry.efficiency * 100.0);
+
+    printf("\n");
+}
+
+void print_header(bool scaling) {
+    printf(
+        "  %-8s %-10s %7s %7s %14s %12s%s\n",
+        "kernel",
+        "mode",
+        "targets",
+        "threads",
+        "H/s",
+        "cycles/hash",
+        scaling ? " efficiency" : "");
+}
+
+std::string json_string(const std::string& str) {
+    std::string out = "\"";
+    for (char chr : str) {
+        if (chr == '"' || chr == '\\')
+            out += '\\';
+        if ((u8)chr < 0x20)
+            continue;
+        out += chr;
+    }
+    out += "\"";
+    return out;
+}
+
+void write_entry(FILE* file, const Entry& entry, bool last) {
+    const Result& result = entry.result;
+
+    fprintf(
+        file,
+        "    {\"kernel\": \"%s\", \"mode\": \"%s\", \"targets\": %lld, \"threads\": %lld, "
+        "\"hashes\": %lld, \"seconds\": %.4f, \"hashes_per_second\": %.1f, ",
+        kernels::name(entry.kernel),
+        modes::name(entry.mode),
+        entry.target_count,
+        result.thread_count,
+        result.hashes,
+        result.seconds,
+        result.rate);
+
+    if (result.cycles_per_hash > 0.0)
+        fprintf(file, "\"cycles_per_hash\": %.2f, ", result.cycles_per_hash);
+    else
+        fprintf(file, "\"cycles_per_hash\": null, ");
+
+    if (entry.efficiency > 0.0)
+        fprintf(file, "\"efficiency\": %.4f, ", entry.efficiency);
+
+    if (entry.perf_report) {
+        fprintf(file, "\"perf\": ");
+        perf::write_json(file, result.perf);
+        fprintf(file, ", ");
+    }
+
+    fprintf(file, "\"thread_hashes_per_second\": [");
+    for (u64 idx = 0; idx < result.thread_rates.size(); idx++)
+        fprintf(file, "%s%.1f", idx ? ", " : "", result.thread_rates[idx]);
+    fprintf(file, "]}%s\n", last ? "" : ",");
+}
+
+void write_json_header(FILE* file, const topology::Topology& topo) {
+    char hostname[256] = {0};
+    gethostname(hostname, sizeof(hostname) - 1);
+
+    char timestamp[32];
+    time_t now = time(nullptr);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    fprintf(file, "  \"timestamp\": \"%s\",\n", timestamp);
+    fprintf(
+        file,
+        "  \"host\": {\"name\": %s, \"cpu\": %s, \"packages\": %d, \"nodes\": %d, "
+        "\"cores\": %d, \"threads\": %lld},\n",
+        json_string(hostname).c_str(),
+        json_string(topo.model).c_str(),
+        topo.packages,
+        topo.nodes,
+        topo.cores,
+        (u64)topo.cpus.size());
+}
+
+void write_json(
+    const char* path,
+    const topology::Topology& topo,
+    const Options& options,
+    const std::vector<Entry>& runs,
+    const std::vector<Entry>& scaling) {
+    FILE* file = fopen(path, "w");
+    if (!file)
+        error("failed to open '%s' for writing\n", path);
+
+    fprintf(file, "{\n");
+    write_json_header(file, topo);
+    fprintf(file, "  \"pattern\": \"%s\",\n", PATTERN);
+    fprintf(file, "  \"duration\": %.3f,\n", options.duration);
+    fprintf(file, "  \"warmup\": %.3f,\n", options.warmup);
+
+    fprintf(file, "  \"runs\": [\n");
+    for (u64 idx = 0; idx < runs.size(); idx++)
+        write_entry(file, runs[idx], idx + 1 == runs.size());
+    fprintf(file, "  ],\n");
+
+    fprintf(file, "  \"scaling\": [\n");
+    for (u64 idx = 0; idx < scaling.size(); idx++)
+        write_entry(file, scaling[idx], idx + 1 == scaling.size());
+    fprintf(file, "  ]\n");
+
+    fprintf(file, "}\n");
+    fclose(file);
+}
+
+void main(const Config& config, const Options& options) {
+    topology::Topology topo = topology::discover();
+    printf("benchmarking on %s\n", topo.model.c_str());
+    printf("%.1fs per run after %.1fs of warmup\n\n", options.duration, options.warmup);
+
+    std::vector<Entry> runs;
+    print_header(false);
+
+    for (kernels::Kernel kernel : kernels::ALL) {
+        if (!kernels::available(kernel))
+            continue;
+
+        for (Mode mode : modes::ALL) {
+            for (u64 target_count : {(u64)1, MULTI_TARGET_COUNT}) {
+                runs.push_back(
+                    measure(config, options, kernel, mode, target_count, config.thread_count));
+                print_row(runs.back());
+                fflush(stdout);
+            }
+        }
+    }
+
+    // Scale the fastest kernel from a single thread up to the full thread count.
+    kernels::Kernel kernel = kernels::best();
+    u64 max_threads = runs.empty() ? 1 : runs.front().result.thread_count;
+
+    std::vector<u64> thread_counts;
+    for (u64 threads = 1; threads < max_threads; threads *= 2)
+        thread_counts.push_back(threads);
+    thread_counts.push_back(max_threads);
+
+    std::vector<Entry> scaling;
+    printf("\n");
+    print_header(true);
+
+    for (u64 threads : thread_counts) {
+        Entry entry = measure(config, options, kernel, Mode::Pmk, 1, threads);
+        if (!scaling.empty() && scaling.front().result.rate > 0.0)
+            entry.efficiency =
+                entry.result.rate / (scaling.front().result.rate * (f64)entry.result.thread_count);
+        else
+            entry.efficiency = 1.0;
+
+        scaling.push_back(entry);
+        print_row(scaling.back());
+        fflush(stdout);
+    }
+
+    if (options.json_path) {
+        write_json(options.json_path, topo, options, runs, scaling);
+        printf("\nwrote results to %s\n", options.json_path);
+    }
+}
+
+} // namespace cpu::benchmark
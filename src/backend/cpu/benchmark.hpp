@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+#include "src/common.hpp"
+#include "src/backend/cpu/cpu.hpp"
+
+namespace cpu::benchmark {
+
+struct Options {
+    // Measured seconds per run, after `warmup` seconds that aren't counted.
+    f64 duration = 2.0;
+    f64 warmup = 0.5;
+
+    // Where to write the results as JSON, nullptr to skip.
+    const char* json_path = nullptr;
+};
+
+// Runs every available kernel in each mode for a fixed duration and reports the hash rates, plus
+// how the fastest kernel scales with the number of threads. Placement options are taken from
+// `config`, its thread count is used as the upper bound.
+void main(const Config& config, const Options& options);
+
+// Targets that never match, such that every run lasts for the full duration.
+Job make_job(Mode mode, u64 target_count);
+
+// Quoted and escaped for a JSON document.
+std::string json_string(const std::string& str);
+
+// Writes the timestamp and host fields shared by every results file, each followed by a comma.
+void write_json_header(FILE* file, const topology::Topology& topo);
+
+} // namespace cpu::benchmark
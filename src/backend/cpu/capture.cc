@@ -0,0 +1,482 @@
+#include "src/backend/cpu/capture.hpp"
+#include "src/backend/cpu/file.hpp"
+#include "src/backend/cpu/hashfile.hpp"
+#include "src/common.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace cpu::capture {
+
+constexpr u32 PCAP_MAGIC = 0xa1b2c3d4;
+constexpr u32 PCAP_MAGIC_NS = 0xa1b23c4d;
+constexpr u32 PCAPNG_SHB = 0x0a0d0d0a;
+constexpr u32 PCAPNG_BYTE_ORDER = 0x1a2b3c4d;
+
+constexpr u32 PCAPNG_IDB = 1;
+constexpr u32 PCAPNG_OPB = 2;
+constexpr u32 PCAPNG_SPB = 3;
+constexpr u32 PCAPNG_EPB = 6;
+
+constexpr u32 LINKTYPE_IEEE802_11 = 105;
+constexpr u32 LINKTYPE_PRISM = 119;
+constexpr u32 LINKTYPE_RADIOTAP = 127;
+constexpr u32 LINKTYPE_AVS = 163;
+
+// Consumed parts of the capture are unmapped in steps of this size.
+constexpr u64 RELEASE_BYTES = 64 << 20;
+
+const u8 LLC_EAPOL[8] = {0xaa, 0xaa, 0x03, 0x00, 0x00, 0x00, 0x88, 0x8e};
+
+// Both capture formats are in the byte order of the machine that wrote them, which is little
+// endian on every host this runs on unless `swap` is set.
+u16 read16(const u8* ptr, bool swap) {
+    u16 val;
+    memcpy(&val, ptr, sizeof(val));
+    return swap ? __builtin_bswap16(val) : val;
+}
+
+u32 read32(const u8* ptr, bool swap) {
+    u32 val;
+    memcpy(&val, ptr, sizeof(val));
+    return swap ? __builtin_bswap32(val) : val;
+}
+
+// 802.11 and EAPOL fields are little and big endian respectively, independent of the capture.
+u16 le16(const u8* ptr) {
+    return ptr[0] | ptr[1] << 8;
+}
+
+u16 be16(const u8* ptr) {
+    return ptr[0] << 8 | ptr[1];
+}
+
+u32 be32(const u8* ptr) {
+    return (u32)ptr[0] << 24 | ptr[1] << 16 | ptr[2] << 8 | ptr[3];
+}
+
+u64 mac_key(const u8 mac[6]) {
+    u64 key = 0;
+    memcpy(&key, mac, 6);
+    return key;
+}
+
+struct Essid {
+    u8 data[32];
+    u64 len;
+};
+
+// A target without its ESSID yet.
+struct Pending {
+    Target target;
+    Handshake handshake;
+};
+
+// The last message 1 sent to a station.
+struct Anonce {
+    u8 nonce[32];
+    u8 replay_counter[8];
+};
+
+struct Parser {
+    Stats* stats;
+
+    // ESSIDs by BSSID. Beacons can come after the handshake, so targets are only paired with their
+    // ESSID once the whole capture has been read.
+    std::unordered_map<u64, Essid> essids;
+
+    // AKM suites advertised by each BSSID, see `rsn_akms`.
+    std::unordered_map<u64, u32> akms;
+    std::vector<Pending> pending;
+
+    // By AP and station MAC.
+    std::map<std::pair<u64, u64>, Anonce> anonces;
+};
+
+// Bit N is set for every AKM suite 00-0F-AC:N an RSN element lists.
+u32 rsn_akms(const u8* rsn, u64 len) {
+    // Version and group cipher, then the pairwise cipher and AKM suite lists with 16 bit counts.
+    u64 offset = 6;
+    if (offset + 2 > len)
+        return 0;
+    offset += 2 + 4 * (u64)le16(rsn + offset);
+    if (offset + 2 > len)
+        return 0;
+
+    u32 akms = 0;
+    u64 count = le16(rsn + offset);
+    offset += 2;
+    for (u64 idx = 0; idx < count && offset + 4 <= len; idx++, offset += 4) {
+        const u8* suite = rsn + offset;
+        if (suite[0] == 0x00 && suite[1] == 0x0f && suite[2] == 0xac && suite[3] < 32)
+            akms |= 1u << suite[3];
+    }
+
+    return akms;
+}
+
+// Looks for the SSID and RSN elements of beacons, probe responses and (re)association requests.
+void management(Parser* parser, const u8* frame, u64 len, u8 subtype, u8 flags) {
+    u64 offset = 24 + (flags & 0x80 ? 4 : 0);
+    switch (subtype) {
+    case 0: // Association request.
+        offset += 4;
+        break;
+    case 2: // Reassociation request.
+        offset += 10;
+        break;
+    case 5: // Probe response.
+    case 8: // Beacon.
+        offset += 12;
+        break;
+    default:
+        return;
+    }
+
+    while (offset + 2 <= len) {
+        u8 id = frame[offset];
+        u8 ie_len = frame[offset + 1];
+        if (offset + 2 + ie_len > len)
+            return;
+
+        const u8* body = frame + offset + 2;
+
+        // Hidden networks announce an empty or zeroed SSID.
+        if (id == 0 && ie_len != 0 && ie_len <= 32 &&
+            !std::all_of(body, body + ie_len, [](u8 c) { return c == 0; })) {
+            Essid essid = Essid{.data = {0}, .len = ie_len};
+            memcpy(essid.data, body, ie_len);
+            if (parser->essids.try_emplace(mac_key(frame + 16), essid).second)
+                parser->stats->essids++;
+        } else if (id == 48) {
+            parser->akms[mac_key(frame + 16)] |= rsn_akms(body, ie_len);
+        }
+
+        offset += 2 + ie_len;
+    }
+}
+
+// Adds the PMKID KDE of a message 1, if it has one. `kind` follows from the key descriptor version.
+void m1_pmkid(
+    Parser* parser,
+    const u8* key_data,
+    u64 len,
+    TargetKind kind,
+    const u8 mac_ap[6],
+    const u8 mac_sta[6]) {
+    for (u64 offset = 0; offset + 2 <= len;) {
+        u8 type = key_data[offset];
+        u8 kde_len = key_data[offset + 1];
+        if (offset + 2 + kde_len > len)
+            return;
+
+        // Vendor specific element with the 00-0F-AC OUI and data type 4 is the PMKID KDE.
+        const u8* body = key_data + offset + 2;
+        if (type == 0xdd && kde_len >= 20 && body[0] == 0x00 && body[1] == 0x0f &&
+            body[2] == 0xac && body[3] == 4) {
+            const u8* pmkid = body + 4;
+            if (std::all_of(pmkid, pmkid + 16, [](u8 c) { return c == 0; }))
+                return;
+
+            // Only the PMKID's 128 bits are compared, the last word stays zero.
+            Pending pending = Pending{};
+            pending.target.kind = kind;
+            memcpy(pending.target.mac_ap, mac_ap, 6);
+            memcpy(pending.target.mac_sta, mac_sta, 6);
+            memcpy(pending.target.hash, pmkid, 16);
+            parser->pending.push_back(pending);
+            parser->stats->pmkids++;
+            parser->stats->sha256_pmkids += kind == TargetKind::PmkidSha256;
+            return;
+        }
+
+        offset += 2 + kde_len;
+    }
+}
+
+// EAPOL frame from `transmitter` to `receiver`, starting with the EAPOL header.
+void eapol(Parser* parser, const u8* key, u64 len, const u8 transmitter[6], const u8 receiver[6]) {
+    // Descriptor type, key info, key length, replay counter, nonce, IV, RSC, reserved, MIC and
+    // the key data length follow the 4 byte EAPOL header.
+    constexpr u64 KEY_DATA_OFFSET = 99;
+    if (len < KEY_DATA_OFFSET || key[1] != 3 || (key[4] != 2 && key[4] != 254))
+        return;
+
+    // Trailing bytes, e.g. the FCS, aren't part of the frame.
+    u64 frame_len = std::min<u64>(len, 4 + be16(key + 2));
+    u64 key_data_len = be16(key + 97);
+    if (KEY_DATA_OFFSET + key_data_len > frame_len)
+        return;
+
+    // Message 1 is the only one with ACK set and MIC, install and secure unset. Message 2 has
+    // only MIC set, unlike message 4 it carries the supplicant's RSN element as key data.
+    u16 key_info = be16(key + 5);
+    u16 type = key_info & 0x03c8;
+
+    if (type == 0x0088) {
+        parser->stats->m1_frames++;
+
+        Anonce& anonce = parser->anonces[{mac_key(transmitter), mac_key(receiver)}];
+        memcpy(anonce.nonce, key + 17, sizeof(anonce.nonce));
+        memcpy(anonce.replay_counter, key + 9, sizeof(anonce.replay_counter));
+
+        // The SHA-1 AKMs use descriptor versions 1 and 2, the SHA-256 ones (00-0F-AC:5 and 6)
+        // version 3, which FT shares, see `load`.
+        u32 key_version = key_info & 0x07;
+        if (key_version == 1 || key_version == 2 || key_version == 3) {
+            TargetKind kind = key_version == 3 ? TargetKind::PmkidSha256 : TargetKind::Pmkid;
+            m1_pmkid(parser, key + KEY_DATA_OFFSET, key_data_len, kind, transmitter, receiver);
+        }
+    } else if (type == 0x0108 && key_data_len) {
+        parser->stats->m2_frames++;
+
+        auto anonce = parser->anonces.find({mac_key(receiver), mac_key(transmitter)});
+        if (anonce == parser->anonces.end() ||
+            memcmp(anonce->second.replay_counter, key + 9, 8) != 0)
+            return;
+        parser->stats->handshakes++;
+
+        u32 key_version = key_info & 0x07;
+        if ((key_version != 1 && key_version != 2) || frame_len > kernels::MAX_EAPOL_LEN) {
+            parser->stats->unsupported_handshakes++;
+            return;
+        }
+
+        Pending pending = Pending{};
+        pending.target.kind = TargetKind::Eapol;
+        memcpy(pending.target.mac_ap, receiver, 6);
+        memcpy(pending.target.mac_sta, transmitter, 6);
+        memcpy(pending.target.hash, key + 81, 16);
+
+        Handshake& handshake = pending.handshake;
+        memcpy(handshake.anonce, anonce->second.nonce, sizeof(handshake.anonce));
+        memcpy(handshake.snonce, key + 17, sizeof(handshake.snonce));
+        handshake.key_version = key_version;
+        memcpy(handshake.eapol, key, frame_len);
+        handshake.eapol_len = frame_len;
+        parser->pending.push_back(pending);
+    }
+}
+
+void data_frame(Parser* parser, const u8* frame, u64 len, u8 subtype, u8 flags) {
+    // Encrypted frames can't be EAPOL handshakes.
+    if (flags & 0x40)
+        return;
+
+    u64 offset = 24;
+    if ((flags & 0x03) == 0x03)
+        offset += 6;
+    if (subtype & 0x08) {
+        offset += 2;
+        if (flags & 0x80)
+            offset += 4;
+    }
+
+    if (offset + sizeof(LLC_EAPOL) > len ||
+        memcmp(frame + offset, LLC_EAPOL, sizeof(LLC_EAPOL)) != 0)
+        return;
+
+    offset += sizeof(LLC_EAPOL);
+    eapol(parser, frame + offset, len - offset, frame + 10, frame + 4);
+}
+
+void ieee80211(Parser* parser, const u8* frame, u64 len) {
+    if (len < 24)
+        return;
+
+    u8 type = (frame[0] >> 2) & 0x03;
+    u8 subtype = frame[0] >> 4;
+    u8 flags = frame[1];
+
+    if (type == 0)
+        management(parser, frame, len, subtype, flags);
+    else if (type == 2)
+        data_frame(parser, frame, len, subtype, flags);
+}
+
+void packet(Parser* parser, u32 linktype, const u8* bytes, u64 len) {
+    parser->stats->packets++;
+
+    u64 header = 0;
+    switch (linktype) {
+    case LINKTYPE_IEEE802_11:
+        break;
+    case LINKTYPE_RADIOTAP:
+        if (len < 4)
+            return;
+        header = le16(bytes + 2);
+        break;
+    case LINKTYPE_PRISM:
+        if (len < 8)
+            return;
+        header = read32(bytes + 4, false);
+        break;
+    case LINKTYPE_AVS:
+        if (len < 8)
+            return;
+        header = be32(bytes + 4);
+        break;
+    default:
+        parser->stats->unsupported++;
+        return;
+    }
+
+    if (header <= len)
+        ieee80211(parser, bytes + header, len - header);
+}
+
+void walk_pcap(Parser* parser, file::Mapping mapping) {
+    const u8* data = mapping.data;
+    u32 magic = read32(data, false);
+    bool swap = magic == __builtin_bswap32(PCAP_MAGIC) || magic == __builtin_bswap32(PCAP_MAGIC_NS);
+
+    // The upper bits of the link type can carry FCS information.
+    u32 linktype = read32(data + 20, swap) & 0xffff;
+
+    u64 released = 0;
+    for (u64 offset = 24; offset + 16 <= mapping.size;) {
+        u64 captured = read32(data + offset + 8, swap);
+        if (offset + 16 + captured > mapping.size)
+            break;
+
+        packet(parser, linktype, data + offset + 16, captured);
+        offset += 16 + captured;
+
+        if (offset - released >= RELEASE_BYTES) {
+            file::release(mapping, offset);
+            released = offset;
+        }
+    }
+}
+
+void walk_pcapng(Parser* parser, file::Mapping mapping) {
+    const u8* data = mapping.data;
+    bool swap = false;
+
+    // Link types of the interfaces in the current section.
+    std::vector<u32> interfaces;
+
+    u64 released = 0;
+    for (u64 offset = 0; offset + 12 <= mapping.size;) {
+        const u8* block = data + offset;
+
+        // The section header's type reads the same in either byte order, its byte order magic
+        // decides how the rest of the section is read.
+        if (read32(block, false) == PCAPNG_SHB) {
+            u32 byte_order = read32(block + 8, false);
+            if (byte_order != PCAPNG_BYTE_ORDER &&
+                byte_order != __builtin_bswap32(PCAPNG_BYTE_ORDER))
+                break;
+
+            swap = byte_order != PCAPNG_BYTE_ORDER;
+            interfaces.clear();
+        }
+
+        u32 type = read32(block, swap);
+        u64 block_len = read32(block + 4, swap);
+        if (block_len < 12 || block_len % 4 != 0 || offset + block_len > mapping.size)
+            break;
+
+        const u8* body = block + 8;
+        u64 body_len = block_len - 12;
+
+        if (type == PCAPNG_IDB && body_len >= 8) {
+            interfaces.push_back(read16(body, swap));
+        } else if (type == PCAPNG_EPB && body_len >= 20) {
+            u32 interface = read32(body, swap);
+            u64 captured = read32(body + 12, swap);
+            if (interface < interfaces.size() && captured <= body_len - 20)
+                packet(parser, interfaces[interface], body + 20, captured);
+        } else if (type == PCAPNG_SPB && body_len >= 4 && !interfaces.empty()) {
+            u64 captured = std::min<u64>(read32(body, swap), body_len - 4);
+            packet(parser, interfaces[0], body + 4, captured);
+        } else if (type == PCAPNG_OPB && body_len >= 20) {
+            u32 interface = read16(body, swap);
+            u64 captured = read32(body + 12, swap);
+            if (interface < interfaces.size() && captured <= body_len - 20)
+                packet(parser, interfaces[interface], body + 20, captured);
+        }
+
+        offset += block_len;
+
+        if (offset - released >= RELEASE_BYTES) {
+            file::release(mapping, offset);
+            released = offset;
+        }
+    }
+}
+
+bool is_capture_magic(u32 magic) {
+    return magic == PCAP_MAGIC || magic == __builtin_bswap32(PCAP_MAGIC) ||
+           magic == PCAP_MAGIC_NS || magic == __builtin_bswap32(PCAP_MAGIC_NS) ||
+           magic == PCAPNG_SHB;
+}
+
+bool detect(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    u8 header[4];
+    bool capture = read(fd, header, sizeof(header)) == sizeof(header) &&
+                   is_capture_magic(read32(header, false));
+    close(fd);
+
+    return capture;
+}
+
+void load(const char* path, Job* job, Stats* stats) {
+    file::Mapping mapping = file::map(path);
+    if (mapping.size < 24 || !is_capture_magic(read32(mapping.data, false)))
+        error("'%s' isn't a pcap or pcapng capture\n", path);
+
+    *stats = Stats{};
+    Parser parser =
+        Parser{.stats = stats, .essids = {}, .akms = {}, .pending = {}, .anonces = {}};
+
+    if (read32(mapping.data, false) == PCAPNG_SHB)
+        walk_pcapng(&parser, mapping);
+    else
+        walk_pcap(&parser, mapping);
+
+    file::unmap(mapping);
+
+    job->targets.clear();
+    job->handshakes.clear();
+
+    for (Pending& pending : parser.pending) {
+        Target& target = pending.target;
+
+        // Version 3 PMKIDs of APs advertising only FT are derived differently.
+        constexpr u32 SHA256_AKMS = 1u << 5 | 1u << 6;
+        auto akms = parser.akms.find(mac_key(target.mac_ap));
+        if (target.kind == TargetKind::PmkidSha256 && akms != parser.akms.end() &&
+            !(akms->second & SHA256_AKMS)) {
+            stats->unsupported_pmkids++;
+            continue;
+        }
+
+        auto essid = parser.essids.find(mac_key(target.mac_ap));
+        if (essid == parser.essids.end()) {
+            stats->no_essid++;
+            continue;
+        }
+
+        memcpy(target.essid, essid->second.data, sizeof(target.essid));
+        target.essid_len = essid->second.len;
+
+        if (target.kind == TargetKind::Eapol) {
+            target.handshake_idx = job->handshakes.size();
+            job->handshakes.push_back(pending.handshake);
+        }
+        job->targets.push_back(target);
+    }
+
+    stats->duplicates = hashfile::dedup(&job->targets);
+}
+
+} // namespace cpu::capture
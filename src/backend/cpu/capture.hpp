@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+
+#include "src/common.hpp"
+#include "src/backend/cpu/cpu.hpp"
+
+namespace cpu::capture {
+
+struct Stats {
+    u64 packets;
+
+    // Packets of link types other than 802.11, radiotap, prism and AVS.
+    u64 unsupported;
+
+    // BSSIDs with a (non-hidden) ESSID from beacons, probe responses or association requests.
+    u64 essids;
+
+    u64 m1_frames;
+    u64 m2_frames;
+
+    // PMKIDs of either AKM family, SHA-1 (00-0F-AC:1/2) or SHA-256 (00-0F-AC:5/6).
+    u64 pmkids;
+    u64 sha256_pmkids;
+
+    // Descriptor version 3 PMKIDs of APs that advertise FT but no SHA-256 AKM.
+    u64 unsupported_pmkids;
+
+    // Message 2 frames following a message 1 with the same replay counter.
+    u64 handshakes;
+
+    // Handshakes with AES-CMAC MICs or frames too long for the kernels.
+    u64 unsupported_handshakes;
+
+    // PMKIDs and handshakes of BSSIDs that never announced their ESSID, these can't be searched.
+    u64 no_essid;
+    u64 duplicates;
+};
+
+// Whether the file starts like a pcap or pcapng capture.
+bool detect(const char* path);
+
+// Walks a pcap or pcapng capture front to back into the targets and handshakes of `job`. Every
+// PMKID found in an EAPOL-Key message 1 becomes a target, tagged by the AKM family that its
+// descriptor version and the AP's RSN element imply, as does every message 2 that answers a
+// message 1. Both are paired with the ESSID of their BSSID and passed through `hashfile::dedup`.
+void load(const char* path, Job* job, Stats* stats);
+
+} // namespace cpu::capture
@@ -1,13 +1,35 @@
 #include "src/common.hpp"
 #include "src/hash.hpp"
+#include "src/backend/cpu/capture.hpp"
 #include "src/backend/cpu/hash.hpp"
+#include "src/backend/cpu/hashfile.hpp"
+#include "src/backend/cpu/hits.hpp"
+#include "src/backend/cpu/kernels.hpp"
+#include "src/backend/cpu/metrics.hpp"
+#include "src/backend/cpu/modes.hpp"
+#include "src/backend/cpu/perf.hpp"
+#include "src/backend/cpu/pool.hpp"
+#include "src/backend/cpu/potfile.hpp"
+#include "src/backend/cpu/priority.hpp"
+#include "src/backend/cpu/probes.hpp"
+#include "src/backend/cpu/targets.hpp"
+#include "src/backend/cpu/telemetry.hpp"
+#include "src/backend/cpu/topology.hpp"
+#include "src/backend/cpu/trace.hpp"
+#include "src/backend/cpu/tuning.hpp"
+#include "src/backend/cpu/cpu.hpp"
 
 #include <atomic>
 #include <cassert>
 #include <chrono>
 #include <cstring>
+#include <memory>
+#include <string>
 #include <thread>
+#include <unistd.h>
+#include <vector>
 
+using namespace std::chrono_literals;
 using namespace std::chrono;
 
 namespace cpu {
@@ -24,130 +46,755 @@ void print_progress(double rate, double percentage) {
 }
 
 struct GlobalContext {
-    u8 mac_ap[6];
-    u8 mac_sta[6];
-    u32 target_hash[5];
+    const Job* job;
+    kernels::Kernel kernel;
 
+    u64 thread_count;
+    bool all_hits;
+
+    // Count hardware events around each worker's hashing loop, see `cpu::perf`.
+    bool perf_report;
+
+    // Candidates of each thread before it skips the strides of the others, see `Config::stride`.
+    u64 stride;
+
+    // Order of the keyspace with `Config::shuffle_seed`, null for the lexicographic one.
+    const hash::Permutation* permutation;
+
+    // Cracked targets, each worker drops them from its own table, see `targets::Retired`.
+    targets::Retired* retired;
+
+    // Reported on their own thread, see `hits::Queue`.
+    hits::Queue* hits;
+
+    // Tells every worker to return, either after the last match or when the time limit is up.
+    std::atomic<bool>* stop;
+
+    // In background mode, workers park while more than `allowed_threads` of them are running.
+    std::atomic<u64>* allowed_threads;
+    std::atomic<u64>* running_threads;
+
+    // With `Config::trace_path`, one buffer per worker and one for the reporter.
+    trace::Tracer* tracer;
+    u64 trace_sample;
+};
+
+// Everything a worker reads in the hot loop. The table is allocated by the worker itself after
+// pinning, such that it lives on the worker's own NUMA node.
+struct LocalContext {
     u8 pattern[64];
-    u64 pattern_len;
+    targets::Table* table;
 
-    u64 thread_count;
-    u64 hashes_to_check;
+    // Epoch of `GlobalContext::retired` the table was last compacted at.
+    u64 epoch;
 
-    u8 passphrase[64];
-    std::atomic<bool> *found_passphrase;
-    std::atomic<u64> *total_hash_count;
+    // The worker's events, null without tracing.
+    trace::Buffer* trace;
 };
 
 struct ThreadContext {
     u64 idx;
     std::thread thread;
+    telemetry::Counter* counter;
+
+    // Logical CPU to pin the worker to, or -1 to leave placement to the OS.
+    i64 cpu_id;
+    bool pinned;
+
+    // Hardware events of the hashing loop with `Config::perf_report`.
+    perf::Counts perf;
 };
 
-const u64 PRINT_INTERVAL = 500000;
+const milliseconds REPORT_INTERVAL = 500ms;
+
+// Time limited runs need to be stopped with a finer granularity.
+const milliseconds TIMED_REPORT_INTERVAL = 50ms;
+
+const milliseconds PARKED_POLL_INTERVAL = 50ms;
+
+// Gives up the worker's slot while too many workers run, returns false if the search got
+// cancelled in the meantime.
+bool park_if_throttled(GlobalContext* gctx, trace::Buffer* trace) {
+    if (gctx->running_threads->load() <= gctx->allowed_threads->load())
+        return true;
+
+    u64 parked = gctx->running_threads->fetch_sub(1) - 1;
+    u64 park_start = trace || PROBE_ENABLED(park) ? trace::now() : 0;
+
+    while (true) {
+        if (gctx->stop->load(std::memory_order_relaxed)) {
+            gctx->running_threads->fetch_add(1);
+            return false;
+        }
+
+        std::this_thread::sleep_for(PARKED_POLL_INTERVAL);
+
+        u64 running = gctx->running_threads->load();
+        if (running < gctx->allowed_threads->load() &&
+            gctx->running_threads->compare_exchange_weak(running, running + 1)) {
+            u64 park_end = park_start ? trace::now() : 0;
+            if (trace)
+                trace->record(trace::Span::Park, park_start, park_end, parked);
+            PROBE(park, parked, park_end - park_start);
+            return true;
+        }
+    }
+}
+
+// Hashes a batch of candidates against every target that isn't cracked yet, returns false once
+// the search is over.
+template <typename M>
+bool check_batch(GlobalContext* gctx, LocalContext* lctx, const u8 batch[][64], u64 count) {
+    u64 epoch = gctx->retired->epoch.load(std::memory_order_acquire);
+    if (epoch != lctx->epoch) {
+        u64 compact_start = lctx->trace || PROBE_ENABLED(compact) ? trace::now() : 0;
+        targets::compact(lctx->table, *gctx->retired);
+        lctx->epoch = epoch;
+
+        u64 compact_end = compact_start ? trace::now() : 0;
+        if (lctx->trace)
+            lctx->trace->record(
+                trace::Span::Compact,
+                compact_start,
+                compact_end,
+                gctx->retired->remaining.load(std::memory_order_relaxed));
+        PROBE(compact, lctx->table->digest_count, compact_end - compact_start);
+    }
+
+    auto on_hit = [&](u64 idx, u64 target_idx) {
+        // Until our table gets compacted, other workers may still hit the same target.
+        bool retired = targets::retire(gctx->retired, target_idx);
+        PROBE(hit, target_idx, !retired);
+        if (!retired)
+            return true;
+
+        PROBE(retire, target_idx, gctx->retired->remaining.load(std::memory_order_relaxed));
+
+        Hit hit = {.target_idx = target_idx};
+        memcpy(hit.passphrase, batch[idx], sizeof(hit.passphrase));
+        gctx->hits->push(hit);
+
+        if (gctx->all_hits && gctx->retired->remaining.load() > 0)
+            return true;
+
+        gctx->stop->store(true);
+        return false;
+    };
+
+    return targets::check<M>(gctx->kernel, lctx->table, batch, count, on_hit);
+}
+
+// Specialised for the job's hash mode `M`, see `cpu::modes`.
+template <typename M>
+void worker(GlobalContext* gctx, ThreadContext* tctx, bool background) {
+    if (tctx->cpu_id >= 0)
+        tctx->pinned = topology::pin_current_thread(tctx->cpu_id);
+
+    if (background)
+        priority::lower_current_thread();
+
+    LocalContext local = {
+        .pattern = {0},
+        .table = targets::new_table(*gctx->job),
+        .epoch = 0,
+        .trace = gctx->tracer ? gctx->tracer->buffer(tctx->idx) : nullptr,
+    };
+    LocalContext* lctx = &local;
+    strncpy((char*)lctx->pattern, gctx->job->pattern.c_str(), sizeof(lctx->pattern) - 1);
 
-void worker(GlobalContext* gctx, ThreadContext* tctx) {
-    u32 hash[5];
     u64 hash_count = 0;
-    std::chrono::time_point<std::chrono::high_resolution_clock> start;
-
-    // Only the main thread has to record time for showing the progress.
-    if (tctx->idx == 0)
-        start = high_resolution_clock::now();
-
-    hash::generate_permutations(
-        gctx->pattern, gctx->pattern_len, tctx->idx, gctx->thread_count, [&](const u8 tc[64]) {
-            hash::pmkid(tc, gctx->mac_ap, gctx->mac_sta, hash);
-            hash_count++;
-
-            if (hash_count == PRINT_INTERVAL) {
-                // Early return if match is found by different thread.
-                if (gctx->found_passphrase->load())
-                    return false;
-
-                u64 total_hash_count = gctx->total_hash_count->load(std::memory_order_acquire);
-                gctx->total_hash_count->store(
-                    total_hash_count + hash_count, std::memory_order_release);
-
-                // Only the main thread updates the progress.
-                if (tctx->idx == 0) {
-                    auto now = high_resolution_clock::now();
-                    auto duration = duration_cast<milliseconds>(now - start);
-                    double hps = ((double)hash_count / (double)duration.count()) * 1000;
-                    double progress = (double)total_hash_count / (double)gctx->hashes_to_check;
-
-                    // It isn't entirely correct to just multiply the local hash count by the
-                    // #thread.
-                    print_progress(hps * (double)gctx->thread_count / 1024.0, progress);
-
-                    start = now;
-                }
-
-                hash_count = 0;
-            }
-
-            for (u64 jdx = 0; jdx < 5; jdx++)
-                if (hash[jdx] != gctx->target_hash[jdx])
-                    // Keep looking for matching hashes.
-                    return true;
-
-            memcpy(gctx->passphrase, tc, 64);
-            gctx->found_passphrase->store(true);
+
+    // Strides are always traced, batches only every `trace_sample`th. Reading the clock around
+    // every batch would cost more than hashing it in the unsalted modes.
+    u64 batch_idx = 0;
+    u64 stride_start = lctx->trace || PROBE_ENABLED(stride_done) ? trace::now() : 0;
+    u64 stride_hashes = 0;
+    u64 generate_start = stride_start;
+    PROBE(stride_start, tctx->idx, hash_count);
+
+    // Closes the current stride at `end`, which is 0 if nobody read the clock yet. A stride that
+    // started before a probe got attached reports 0ns.
+    auto end_stride = [&](u64 end, bool last) {
+        if (!end && (lctx->trace || PROBE_ENABLED(stride_done)))
+            end = trace::now();
+
+        if (lctx->trace)
+            lctx->trace->record(trace::Span::Stride, stride_start, end, hash_count - stride_hashes);
+        PROBE(
+            stride_done,
+            tctx->idx,
+            hash_count - stride_hashes,
+            stride_start && end ? end - stride_start : 0);
+
+        stride_start = end;
+        stride_hashes = hash_count;
+        if (!last)
+            PROBE(stride_start, tctx->idx, hash_count);
+    };
+
+    // Publishing once per batch is a single store to a line nobody else writes to.
+    auto flush = [&](const u8 batch[][64], u64 batch_len) {
+        bool sampled = lctx->trace && batch_idx++ % gctx->trace_sample == 0;
+        u64 check_start = sampled || PROBE_ENABLED(batch_done) ? trace::now() : 0;
+
+        bool keep_going = check_batch<M>(gctx, lctx, batch, batch_len);
+        hash_count += batch_len;
+
+        tctx->counter->hashes.store(hash_count, std::memory_order_relaxed);
+
+        u64 check_end = check_start ? trace::now() : 0;
+        if (sampled) {
+            lctx->trace->record(trace::Span::Generate, generate_start, check_start, batch_len);
+            lctx->trace->record(trace::Span::Check, check_start, check_end, batch_len);
+        }
+        PROBE(batch_done, batch_len, check_end - check_start);
+
+        if (hash_count / gctx->stride != (hash_count - batch_len) / gctx->stride)
+            end_stride(check_end, false);
+
+        // Early return if match is found by different thread.
+        if (!keep_going || gctx->stop->load(std::memory_order_relaxed))
             return false;
-        });
+
+        if (background && !park_if_throttled(gctx, lctx->trace))
+            return false;
+
+        // The next batch gets generated from here on.
+        if (lctx->trace && batch_idx % gctx->trace_sample == 0)
+            generate_start = trace::now();
+
+        return true;
+    };
+
+    // Opened after the table is built, such that the counts cover generation and hashing only.
+    perf::Counters perf_counters;
+    if (gctx->perf_report)
+        perf::start(&perf_counters);
+
+    hash::generate_batches(
+        lctx->pattern,
+        gctx->job->pattern.size(),
+        tctx->idx,
+        gctx->thread_count,
+        flush,
+        gctx->permutation,
+        gctx->stride);
+
+    if (gctx->perf_report)
+        perf::stop(&perf_counters, hash_count, &tctx->perf);
+
+    if (hash_count > stride_hashes)
+        end_stride(0, true);
+
+    gctx->running_threads->fetch_sub(1);
+    targets::free_table(lctx->table);
 }
 
-void main(const char* pattern) {
-    u64 pattern_len = std::strlen(pattern);
+std::vector<i64> worker_cpus(const Config& config, const topology::Topology& topo) {
+    std::vector<topology::Cpu> cpus = topology::placement(topo, config.pinning, config.smt);
+    if (cpus.empty())
+        error("no usable cpus were found\n");
+
+    // Sized like every other entry point does, only the CPU quota makes it fall short of the placed
+    // CPUs.
+    u64 thread_count = config.thread_count;
+    if (!thread_count) {
+        thread_count = topology::default_thread_count(topo, config.smt);
+        if (config.verbose && thread_count < cpus.size())
+            printf("limiting threads to cpu quota of %lld\n", thread_count);
+    }
+
+    std::vector<i64> cpu_ids(thread_count, -1);
+    if (config.pinning != topology::Pinning::None)
+        for (u64 idx = 0; idx < thread_count; idx++)
+            cpu_ids[idx] = cpus[idx % cpus.size()].id;
+
+    return cpu_ids;
+}
+
+void print_topology(const topology::Topology& topo) {
+    printf(
+        "detected %d packages, %d numa nodes, %d cores, %lld threads",
+        topo.packages,
+        topo.nodes,
+        topo.cores,
+        (u64)topo.cpus.size());
+
+    if (topo.performance_cpus && topo.efficiency_cpus)
+        printf(" (%d performance, %d efficiency)", topo.performance_cpus, topo.efficiency_cpus);
 
-    if (pattern_len > 63)
+    printf("\n");
+}
+
+Result run(const Job& job, const Config& config) {
+    if (job.pattern.size() > 63)
         error("input patterns must be less than 63 characters");
 
-    u64 hashes_to_check = 100; // broken
-    printf("hashes to check: %lld\n", hashes_to_check);
+    if (job.targets.empty())
+        error("no targets to check\n");
+
+    u64 max_len = 0;
+    modes::dispatch(job.mode, [&](auto m) { max_len = decltype(m)::MAX_CANDIDATE_LEN; });
+    if (job.pattern.size() > max_len)
+        error(
+            "%s mode takes candidates of at most %lld characters\n",
+            modes::name(job.mode),
+            max_len);
+
+    if (!kernels::available(config.kernel))
+        error("kernel '%s' is not supported on this cpu\n", kernels::name(config.kernel));
+
+    u64 stride = config.stride ? config.stride : hash::STRIDE;
+    if (!hash::valid_stride(stride))
+        error("stride %lld is not a power of two\n", stride);
+
+    u128 hashes_to_check = hash::keyspace((const u8*)job.pattern.c_str(), job.pattern.size());
+    if (config.verbose)
+        printf("hashes to check: %s\n", hash::to_string(hashes_to_check).c_str());
+
+    std::vector<i64> cpu_ids;
+    if (config.pool) {
+        cpu_ids.assign(config.pool->size(), -1);
+    } else {
+        topology::Topology topo = topology::discover();
+        if (config.verbose)
+            print_topology(topo);
+        cpu_ids = worker_cpus(config, topo);
+    }
 
-    u64 thread_count = std::thread::hardware_concurrency();
-    printf("detected %lld threads\n", thread_count);
+    u64 thread_count = cpu_ids.size();
+
+    if (config.verbose)
+        printf(
+            "using %lld threads (mode: %s, kernel: %s, pinning: %s, smt: %s%s%s)\n",
+            thread_count,
+            modes::name(job.mode),
+            kernels::name(config.kernel),
+            topology::pinning_name(config.pinning),
+            config.smt ? "on" : "off",
+            config.background ? ", background" : "",
+            config.shuffle_seed ? ", shuffled" : "");
+
+    hash::Permutation permutation;
+    hash::init_permutation(hashes_to_check, config.shuffle_seed, &permutation);
+
+    std::unique_ptr<trace::Tracer> tracer;
+    if (config.trace_path) {
+        std::vector<std::string> names;
+        for (u64 idx = 0; idx < thread_count; idx++)
+            names.push_back("worker " + std::to_string(idx));
+        names.push_back("reporter");
+        tracer = std::make_unique<trace::Tracer>(config.trace_path, names);
+    }
 
-    std::atomic<bool> found_passphrase = false;
-    std::atomic<u64> total_hash_count = 0;
+    targets::Retired retired(job.targets.size());
+    hits::Queue hit_queue([&](const Hit& hit) {
+        u64 hit_start = tracer ? trace::now() : 0;
+
+        if (config.potfile_path)
+            potfile::append(
+                config.potfile_path,
+                potfile::target_key(job.mode, job.targets[hit.target_idx]),
+                hit.passphrase,
+                strnlen((const char*)hit.passphrase, sizeof(hit.passphrase)));
+
+        if (config.on_hit)
+            config.on_hit(hit);
+
+        if (tracer)
+            tracer->buffer(thread_count)
+                ->record(trace::Span::Hit, hit_start, trace::now(), hit.target_idx);
+    });
+    std::atomic<bool> stop = false;
+    std::atomic<u64> allowed_threads = thread_count;
+    std::atomic<u64> running_threads = thread_count;
     GlobalContext gctx = GlobalContext{
-        .pattern = {0},
-        .pattern_len = pattern_len,
+        .job = &job,
+        .kernel = config.kernel,
         .thread_count = thread_count,
-        .hashes_to_check = hashes_to_check,
-        .found_passphrase = &found_passphrase,
-        .total_hash_count = &total_hash_count,
+        .all_hits = config.all_hits,
+        .perf_report = config.perf_report,
+        .stride = stride,
+        .permutation = config.shuffle_seed ? &permutation : nullptr,
+        .retired = &retired,
+        .hits = &hit_queue,
+        .stop = &stop,
+        .allowed_threads = &allowed_threads,
+        .running_threads = &running_threads,
+        .tracer = tracer.get(),
+        .trace_sample = config.trace_sample ? config.trace_sample : 1,
+    };
+
+    std::vector<ThreadContext> threads(thread_count);
+    auto counters = std::make_unique<telemetry::Counter[]>(thread_count);
+
+    telemetry::Reporter reporter(counters.get(), thread_count);
+    priority::LoadMonitor load_monitor;
+
+    // A progress bar only makes sense on a terminal, job runners get `Config::metrics_path`.
+    bool show_progress = config.verbose && isatty(STDOUT_FILENO);
+    bool showed_progress = false;
+
+    std::unique_ptr<metrics::Exporter> exporter;
+    if (config.metrics_path || config.prometheus_path)
+        exporter = std::make_unique<metrics::Exporter>(
+            config.metrics_path,
+            config.prometheus_path,
+            config.metrics_interval,
+            modes::name(job.mode),
+            kernels::name(config.kernel));
+
+    auto progress = [&](bool finished) {
+        return metrics::Progress{
+            .keyspace = hashes_to_check,
+            .targets = job.targets.size(),
+            .remaining_targets = retired.remaining.load(std::memory_order_relaxed),
+            .hit_queue_depth = hit_queue.depth(),
+            .finished = finished,
+        };
+    };
+
+    // Everything before the end of the warmup is subtracted from the results.
+    bool warm = config.warmup <= 0.0;
+    telemetry::Snapshot baseline = {.thread_hashes = std::vector<u64>(thread_count, 0)};
+    u64 baseline_cycles = telemetry::read_cycle_counter();
+
+    // When the time limit or `Config::cancel` stopped the workers, only touched by the reporter
+    // until it's stopped.
+    bool stop_requested = false;
+    steady_clock::time_point stop_time;
+    auto request_stop = [&]() {
+        if (!stop_requested)
+            stop_time = steady_clock::now();
+        stop_requested = true;
+        stop.store(true);
     };
 
-    // Copy over pattern, the rest of the characters are '\0's.
-    std::strcpy((char*)gctx.pattern, pattern);
+    milliseconds interval = config.time_limit > 0.0 ? TIMED_REPORT_INTERVAL : REPORT_INTERVAL;
+    reporter.start(interval, [&](const telemetry::Snapshot& snapshot) {
+        if (!warm && snapshot.elapsed >= config.warmup) {
+            baseline = snapshot;
+            baseline_cycles = telemetry::read_cycle_counter();
+            warm = true;
+        }
+
+        if (config.time_limit > 0.0 && snapshot.elapsed >= config.time_limit)
+            request_stop();
 
-    // Example packet.
-    ::hash::mac_to_bytes("00:11:22:33:44:55", gctx.mac_ap);
-    ::hash::mac_to_bytes("66:77:88:99:AA:BB", gctx.mac_sta);
-    ::hash::generate_example("lola1", gctx.mac_ap, gctx.mac_sta, gctx.target_hash);
+        if (config.background)
+            allowed_threads.store(load_monitor.allowed_threads(thread_count));
 
-    ThreadContext threads[thread_count];
+        if (exporter)
+            exporter->sample(snapshot, progress(false));
+
+        if (config.cancel && config.cancel->load(std::memory_order_relaxed))
+            request_stop();
+
+        if (config.on_progress)
+            config.on_progress(snapshot.total_hashes, snapshot.rate);
+
+        if (show_progress) {
+            print_progress(
+                snapshot.rate / 1000.0, (f64)snapshot.total_hashes / (f64)hashes_to_check);
+            showed_progress = true;
+        }
+    });
+
+    hit_queue.start();
+    if (tracer)
+        tracer->start();
+
+    PROBE(run_start, thread_count, (u64)job.targets.size());
 
     for (u64 idx = 0; idx < thread_count; idx++) {
         ThreadContext* tctx = &threads[idx];
         tctx->idx = idx;
-        tctx->thread = std::thread(worker, &gctx, tctx);
+        tctx->counter = &counters[idx];
+        tctx->pinned = false;
+        tctx->cpu_id = cpu_ids[idx];
+        tctx->perf = {};
     }
 
-    for (u64 idx = 0; idx < thread_count; idx++)
-        threads[idx].thread.join();
+    // Pool threads were pinned when the pool started.
+    if (config.pool) {
+        modes::dispatch(job.mode, [&](auto m) {
+            config.pool->run(thread_count, [&](u64 idx) {
+                worker<decltype(m)>(&gctx, &threads[idx], config.background);
+            });
+        });
+    } else {
+        for (u64 idx = 0; idx < thread_count; idx++)
+            modes::dispatch(job.mode, [&](auto m) {
+                threads[idx].thread =
+                    std::thread(worker<decltype(m)>, &gctx, &threads[idx], config.background);
+            });
+
+        for (u64 idx = 0; idx < thread_count; idx++)
+            threads[idx].thread.join();
+    }
+
+    u64 end_cycles = telemetry::read_cycle_counter();
+    steady_clock::time_point end_time = steady_clock::now();
+    telemetry::Snapshot summary = reporter.stop();
+    std::vector<Hit> hits = hit_queue.stop();
+    if (tracer)
+        tracer->stop();
+
+    PROBE(run_done, summary.total_hashes, (u64)(summary.elapsed * 1e9));
+
+    if (exporter)
+        exporter->sample(summary, progress(true));
 
     // We showed the progress bar, so print a newline.
-    if (gctx.total_hash_count->load() >= PRINT_INTERVAL)
+    if (showed_progress)
         printf("\n");
 
-    if (gctx.found_passphrase->load()) {
-        printf("passphrase is: %s\n", gctx.passphrase);
+    // Runs that ended during the warmup are reported as a whole.
+    if (!warm) {
+        baseline = {.thread_hashes = std::vector<u64>(thread_count, 0)};
+        baseline_cycles = end_cycles;
+    }
+
+    Result result = Result{
+        .found = !hits.empty(),
+        .passphrase = {0},
+        .target_idx = hits.empty() ? 0 : hits[0].target_idx,
+        .hits = std::move(hits),
+        .thread_count = thread_count,
+        .keyspace = hashes_to_check,
+        .hashes = summary.total_hashes - baseline.total_hashes,
+        .seconds = summary.elapsed - baseline.elapsed,
+        .rate = 0.0,
+        .thread_rates = std::vector<f64>(thread_count, 0.0),
+        .cycles_per_hash = 0.0,
+        .perf = {},
+        .cancel_latency = 0.0,
+        .unpinned_threads = 0,
+    };
+    if (result.found)
+        memcpy(result.passphrase, result.hits[0].passphrase, sizeof(result.passphrase));
+
+    if (result.seconds > 0.0) {
+        result.rate = (f64)result.hashes / result.seconds;
+        for (u64 idx = 0; idx < thread_count; idx++)
+            result.thread_rates[idx] =
+                (f64)(summary.thread_hashes[idx] - baseline.thread_hashes[idx]) / result.seconds;
+    }
+
+    if (stop_requested)
+        result.cancel_latency = duration<f64>(end_time - stop_time).count();
+
+    if (end_cycles && result.hashes)
+        result.cycles_per_hash =
+            (f64)(end_cycles - baseline_cycles) * (f64)thread_count / (f64)result.hashes;
+
+    for (u64 idx = 0; idx < thread_count; idx++)
+        if (threads[idx].cpu_id >= 0 && !threads[idx].pinned)
+            result.unpinned_threads++;
+
+    for (u64 idx = 0; idx < thread_count; idx++)
+        perf::add(threads[idx].perf, &result.perf);
+
+    return result;
+}
+
+// Drops the targets the potfile knows and those that one of its passphrases cracks, the latter get
+// recorded. Returns false if no target is left.
+bool apply_potfile(const Config& config, Job* job) {
+    potfile::Index index;
+    potfile::load(config.potfile_path, &index);
+
+    u64 target_count = job->targets.size();
+    std::vector<potfile::Cracked> known = potfile::drop_cracked(index, job);
+    std::vector<potfile::Cracked> reused =
+        potfile::recheck(index, job, config.kernel, config.thread_count);
+
+    for (const potfile::Cracked& hit : reused)
+        potfile::append(
+            config.potfile_path,
+            potfile::target_key(job->mode, hit.target),
+            (const u8*)hit.passphrase.data(),
+            hit.passphrase.size());
+
+    if (config.verbose)
+        printf(
+            "potfile has %lld records, %lld of %lld targets were cracked before and %lld by their "
+            "passphrases\n",
+            index.count,
+            (u64)known.size(),
+            target_count,
+            (u64)reused.size());
+
+    for (const std::vector<potfile::Cracked>* cracked : {&known, &reused})
+        for (const potfile::Cracked& hit : *cracked)
+            printf(
+                "%s:%s\n",
+                potfile::target_key(job->mode, hit.target).c_str(),
+                hit.passphrase.c_str());
+
+    potfile::unload(&index);
+
+    if (job->targets.empty()) {
+        printf("every target is cracked already\n");
+        return false;
+    }
+
+    return true;
+}
+
+void print_hit(const Job& job, const Hit& hit, const char* hashes_path, bool verbose) {
+    // Clear the progress bar, the next report redraws it.
+    if (verbose)
+        printf("\r%*s\r", (int)PBWIDTH + 24, "");
+
+    const Target& target = job.targets[hit.target_idx];
+    printf("passphrase is: %s\n", hit.passphrase);
+
+    if (hashes_path && !modes::is_wpa(job.mode)) {
+        u64 digest_bytes = 0;
+        modes::dispatch(job.mode, [&](auto m) { digest_bytes = decltype(m)::DIGEST_BYTES; });
+        printf(
+            "from the %s digest %s\n",
+            modes::name(job.mode),
+            ::hash::bytes_to_digest((const u8*)target.hash, digest_bytes).c_str());
+    } else if (hashes_path) {
+        printf(
+            "from the %s of ESSID '%.*s', AP %s, station %s\n",
+            target.kind == TargetKind::Eapol         ? "handshake"
+            : target.kind == TargetKind::PmkidSha256 ? "SHA-256 PMKID"
+                                                     : "PMKID",
+            (int)target.essid_len,
+            target.essid,
+            ::hash::bytes_to_digest(target.mac_ap, sizeof(target.mac_ap)).c_str(),
+            ::hash::bytes_to_digest(target.mac_sta, sizeof(target.mac_sta)).c_str());
+    }
+
+    fflush(stdout);
+}
+
+void main(const char* pattern, const char* hashes_path, Mode mode, const Config& config) {
+    Job job = Job{
+        .pattern = pattern,
+        .mode = modes::is_wpa(mode) ? Mode::Pmk : mode,
+        .targets = std::vector<Target>(1),
+    };
+
+    if (!modes::is_wpa(mode) && hashes_path) {
+        hashfile::Stats stats;
+        hashfile::load(hashes_path, config.thread_count, &job, &stats);
+
+        if (config.verbose)
+            printf(
+                "read %lld %s digests from %lld lines (%lld duplicates, %lld invalid)\n",
+                stats.digests,
+                modes::name(mode),
+                stats.lines,
+                stats.duplicates,
+                stats.invalid);
+
+        if (job.targets.empty())
+            error("no %s digests in '%s'\n", modes::name(mode), hashes_path);
+    } else if (!modes::is_wpa(mode)) {
+        // Example digest of the same passphrase as the example packet.
+        u8 example[1][64] = {"lola1"};
+        modes::dispatch(mode, [&](auto m) {
+            u32 keys[1][8];
+            decltype(m)::hash(
+                config.kernel, nullptr, targets::Group{}, example, 1, keys, &job.targets[0].hash);
+        });
+    } else if (hashes_path && capture::detect(hashes_path)) {
+        capture::Stats stats;
+        job.mode = Mode::Passphrase;
+        capture::load(hashes_path, &job, &stats);
+
+        if (config.verbose)
+            printf(
+                "read %lld packets (%lld of unsupported link types), %lld ESSIDs, %lld M1 and "
+                "%lld M2 frames\n"
+                "found %lld PMKIDs (%lld SHA-256, %lld unsupported) and %lld handshakes (%lld "
+                "unsupported), %lld without ESSID, %lld duplicates\n",
+                stats.packets,
+                stats.unsupported,
+                stats.essids,
+                stats.m1_frames,
+                stats.m2_frames,
+                stats.pmkids,
+                stats.sha256_pmkids,
+                stats.unsupported_pmkids,
+                stats.handshakes,
+                stats.unsupported_handshakes,
+                stats.no_essid,
+                stats.duplicates);
+
+        if (job.targets.empty())
+            error("no PMKIDs or handshakes with a known ESSID in '%s'\n", hashes_path);
+    } else if (hashes_path) {
+        hashfile::Stats stats;
+        job.mode = Mode::Passphrase;
+        hashfile::load(hashes_path, config.thread_count, &job, &stats);
+
+        if (config.verbose)
+            printf(
+                "read %lld PMKIDs and %lld handshakes from %lld lines (%lld duplicates, %lld "
+                "skipped, %lld invalid)\n",
+                stats.pmkids,
+                stats.eapols,
+                stats.lines,
+                stats.duplicates,
+                stats.skipped,
+                stats.invalid);
+
+        if (job.targets.empty())
+            error("no PMKIDs or handshakes in '%s'\n", hashes_path);
     } else {
-        printf("didn't find a passphrase with the given pattern\n");
+        // Example packet.
+        Target& target = job.targets[0];
+        ::hash::mac_to_bytes("00:11:22:33:44:55", target.mac_ap);
+        ::hash::mac_to_bytes("66:77:88:99:AA:BB", target.mac_sta);
+        ::hash::generate_example("lola1", target.mac_ap, target.mac_sta, target.hash);
+    }
+
+    if (config.potfile_path && !apply_potfile(config, &job))
+        return;
+
+    // Hits are printed as they come in, a search with `all_hits` can take a while.
+    Config run_config = config;
+    run_config.on_hit = [&](const Hit& hit) { print_hit(job, hit, hashes_path, config.verbose); };
+    if (config.autotune)
+        tuning::apply(job.mode, config.tuning_path, &run_config);
+
+    Result result = run(job, run_config);
+
+    if (result.unpinned_threads)
+        printf(
+            "failed to pin %lld threads, they were left to the OS scheduler\n",
+            result.unpinned_threads);
+
+    f64 min_rate = 0.0;
+    f64 max_rate = 0.0;
+    for (u64 idx = 0; idx < result.thread_count; idx++) {
+        f64 rate = result.thread_rates[idx];
+        if (idx == 0 || rate < min_rate)
+            min_rate = rate;
+        if (idx == 0 || rate > max_rate)
+            max_rate = rate;
     }
+
+    printf(
+        "checked %lld hashes in %.2fs, avg %.1f KH/s (per thread: min %.1f, max %.1f KH/s)\n",
+        result.hashes,
+        result.seconds,
+        result.rate / 1000.0,
+        min_rate / 1000.0,
+        max_rate / 1000.0);
+
+    if (config.perf_report)
+        perf::print(result.perf);
+
+    if (!result.found)
+        printf("didn't find a passphrase with the given pattern\n");
+    else if (config.all_hits && result.hits.size() < job.targets.size())
+        printf("cracked %lld of %lld targets\n", (u64)result.hits.size(), (u64)job.targets.size());
 }
 
 }
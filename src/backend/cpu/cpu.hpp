@@ -1,5 +1,203 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "src/common.hpp"
+#include "src/backend/cpu/kernels.hpp"
+#include "src/backend/cpu/perf.hpp"
+#include "src/backend/cpu/topology.hpp"
+
 namespace cpu {
 
-void main(const char* pattern);
+namespace pool {
+struct Pool;
+}
+
+enum class Mode {
+    // Candidates are used as the PMK directly.
+    Pmk,
+    // Candidates are WPA passphrases, the PMK is derived with PBKDF2 from the target's ESSID.
+    Passphrase,
+    // Unsalted digests of the candidate, only `Target::hash` is used. See `cpu::modes`.
+    RawSha1,
+    RawMd5,
+    Ntlm,
+};
+
+enum class TargetKind {
+    // `hash` is a PMKID.
+    Pmkid,
+    // `hash` is the MIC of message 2 of a 4-way handshake, only in `Mode::Passphrase`.
+    Eapol,
+    // `hash` is an HMAC-SHA256 PMKID of the SHA-256 AKMs, only in `Mode::Passphrase`.
+    PmkidSha256,
+};
+
+struct Target {
+    // Only used in `Mode::Passphrase`.
+    u8 essid[32];
+    u64 essid_len;
+
+    u8 mac_ap[6];
+    u8 mac_sta[6];
+
+    // In the byte order of `cpu::hash::pmkid`, only the first 128 bits (the PMKID or MIC) are
+    // compared.
+    u32 hash[5];
+
+    TargetKind kind;
+
+    // Index into `Job::handshakes` of `TargetKind::Eapol` targets.
+    u64 handshake_idx;
+};
+
+// What's needed to check the MIC of a handshake besides the target's ESSID and MACs.
+struct Handshake {
+    u8 anonce[32];
+    u8 snonce[32];
+
+    // Key descriptor version, 1 for HMAC-MD5 and 2 for HMAC-SHA1 MICs.
+    u32 key_version;
+
+    // EAPOL-Key frame of message 2, including the EAPOL header. The MIC in it is ignored.
+    u8 eapol[kernels::MAX_EAPOL_LEN];
+    u64 eapol_len;
+};
+
+struct Job {
+    std::string pattern;
+    Mode mode = Mode::Pmk;
+    std::vector<Target> targets;
+    std::vector<Handshake> handshakes;
+};
+
+struct Hit {
+    u64 target_idx;
+    u8 passphrase[64];
+};
+
+struct Config {
+    // Number of worker threads, 0 picks one per usable CPU.
+    u64 thread_count = 0;
+
+    topology::Pinning pinning = topology::Pinning::None;
+
+    // Whether to schedule workers on more than one hardware thread per physical core.
+    bool smt = true;
+
+    // Run workers at idle priority and back off while other processes need the CPUs.
+    bool background = false;
+
+    kernels::Kernel kernel = kernels::best();
+
+    // Stop after this many seconds, 0 runs until the keyspace is exhausted or a target is found.
+    f64 time_limit = 0.0;
+
+    // Candidates each thread takes at a time, a power of two. Larger strides keep more of a
+    // thread's candidates sequential, smaller ones split the end of the keyspace more evenly. 0
+    // picks `hash::STRIDE`.
+    u64 stride = 0;
+
+    // Let `main` replace the kernel, SMT, thread count and stride with the ones calibrated for the
+    // mode on this host, cached in `tuning_path` (null for the default), see `cpu::tuning`. A
+    // thread count or stride set here is kept.
+    bool autotune = false;
+    const char* tuning_path = nullptr;
+
+    // Visit the keyspace in a pseudorandom order keyed by this seed, such that a run stopped early
+    // has covered it uniformly rather than its lexicographically lowest part. 0 keeps the order.
+    u64 shuffle_seed = 0;
+
+    // Keep searching after a hit until every target is cracked, instead of stopping at the first.
+    // Cracked targets are retired from the workers' tables while they run.
+    bool all_hits = false;
+
+    // Count cycles, instructions, cache and branch misses of every worker's hashing loop with
+    // perf_event_open, see `Result::perf`.
+    bool perf_report = false;
+
+    // Write a Chrome/Perfetto trace of what every worker and the reporter spend their time on to
+    // this path, see `cpu::trace`. Only every `trace_sample`th batch is timed.
+    const char* trace_path = nullptr;
+    u64 trace_sample = 1024;
+
+    // Export rates, progress and hits every `metrics_interval` seconds as JSON lines appended to
+    // `metrics_path` and/or as a Prometheus textfile at `prometheus_path`, see `cpu::metrics`.
+    const char* metrics_path = nullptr;
+    const char* prometheus_path = nullptr;
+    f64 metrics_interval = 5.0;
+
+    // Seconds at the start of a run that don't count towards the reported rates.
+    f64 warmup = 0.0;
+
+    // Print the setup and a progress bar.
+    bool verbose = true;
+
+    // Append-only record of cracked targets, `run` adds every hit to it and `main` skips the
+    // targets it has a record for, see `cpu::potfile`.
+    const char* potfile_path = nullptr;
+
+    // Called on the reporter thread for every hit as soon as it's in the potfile, while the
+    // workers keep going.
+    std::function<void(const Hit&)> on_hit;
+
+    // Called on the telemetry thread about twice a second with the candidates checked so far and
+    // the current rate.
+    std::function<void(u64 hashes, f64 rate)> on_progress;
+
+    // Stops the search once set, checked as often as `on_progress` is called.
+    const std::atomic<bool>* cancel = nullptr;
+
+    // Run the workers on these threads instead of spawning them, `thread_count` and `pinning`
+    // were applied when it was created. See `cpu::daemon`.
+    pool::Pool* pool = nullptr;
+};
+
+struct Result {
+    // The first hit.
+    bool found;
+    u8 passphrase[64];
+    u64 target_idx;
+
+    // Every hit in the order they were found, at most one per target. Workers that hit a target in
+    // the same batch as the first one can add more even without `Config::all_hits`.
+    std::vector<Hit> hits;
+
+    u64 thread_count;
+    u128 keyspace;
+
+    // Candidates checked after the warmup, and how long that took.
+    u64 hashes;
+    f64 seconds;
+    f64 rate;
+    std::vector<f64> thread_rates;
+
+    // Reference cycles spent per candidate by a single thread, 0 without a cycle counter.
+    f64 cycles_per_hash;
+
+    // Hardware events summed over the workers with `Config::perf_report`. Unlike the rates these
+    // include the warmup, the events of each worker are only read once it returns.
+    perf::Counts perf;
+
+    // Seconds from the time limit or `Config::cancel` stopping the search until every worker
+    // returned, 0 if neither did.
+    f64 cancel_latency;
+
+    u64 unpinned_threads;
+};
+
+Result run(const Job& job, const Config& config);
+
+// Logical CPU of each worker that `config` asks for, -1 for those left to the OS scheduler.
+std::vector<i64> worker_cpus(const Config& config, const topology::Topology& topo);
+
+// Without `hashes_path` an example PMK target is searched, otherwise the PMKIDs of the hashcat
+// 22000/16800 file or pcap/pcapng capture are searched for passphrases. Unsalted modes take a file
+// of hex digests instead, or search an example digest. `Mode::Pmk` and `Mode::Passphrase` both
+// pick WPA.
+void main(const char* pattern, const char* hashes_path, Mode mode, const Config& config);
 
 }
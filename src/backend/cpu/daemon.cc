@@ -0,0 +1,457 @@
+#include "src/backend/cpu/daemon.hpp"
+#include "src/backend/cpu/hash.hpp"
+#include "src/backend/cpu/hashfile.hpp"
+#include "src/backend/cpu/modes.hpp"
+#include "src/backend/cpu/pool.hpp"
+#include "src/backend/cpu/potfile.hpp"
+#include "src/common.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace std::chrono;
+
+namespace cpu::daemon {
+
+// How often blocked threads look at the shutdown flag.
+const int POLL_INTERVAL_MS = 500;
+
+// A client that doesn't take a reply within this long is treated as gone, such that it can't stall
+// the threads of a run.
+const int REPLY_TIMEOUT_MS = 2000;
+
+// Longer than any 22000 EAPOL line.
+const u64 MAX_LINE_LEN = 4096;
+
+std::atomic<bool> signalled = false;
+
+void on_signal(int) {
+    signalled.store(true);
+}
+
+struct Request {
+    u64 id;
+    i64 priority;
+    Job job;
+
+    // Replies are written by the hit reporter and the telemetry thread while the job runs.
+    int fd;
+    std::mutex write_mutex;
+
+    // Set once the client is gone.
+    std::atomic<bool> cancelled = false;
+
+    // Stops the job, set once the client is gone or the daemon shuts down.
+    std::atomic<bool> stop = false;
+
+    ~Request() {
+        close(fd);
+    }
+
+    void reply(const std::string& line) {
+        std::lock_guard<std::mutex> lock(write_mutex);
+        if (cancelled.load())
+            return;
+
+        std::string out = line + "\n";
+        steady_clock::time_point deadline = steady_clock::now() + milliseconds(REPLY_TIMEOUT_MS);
+        for (u64 sent = 0; sent < out.size();) {
+            ssize_t len =
+                send(fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (len > 0) {
+                sent += len;
+                continue;
+            }
+
+            i64 left = duration_cast<milliseconds>(deadline - steady_clock::now()).count();
+            if (len == 0 || (errno != EAGAIN && errno != EWOULDBLOCK) || left <= 0) {
+                cancelled.store(true);
+                stop.store(true);
+                return;
+            }
+
+            pollfd pfd = {.fd = fd, .events = POLLOUT, .revents = 0};
+            poll(&pfd, 1, (int)left);
+        }
+    }
+};
+
+struct Server {
+    const Config* config;
+    const std::atomic<bool>* shutdown;
+    pool::Pool* pool;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<std::unique_ptr<Request>> pending;
+    Request* current = nullptr;
+    u64 next_id = 1;
+    bool stopping = false;
+};
+
+// Buffered line reader over a socket that gives up on shutdown.
+struct LineReader {
+    int fd;
+    const std::atomic<bool>* shutdown;
+    std::string buffer;
+    bool eof = false;
+
+    // Returns false at the end of the stream, on errors and on overlong lines.
+    bool next(std::string* line) {
+        while (true) {
+            u64 end = buffer.find('\n');
+            if (end != std::string::npos) {
+                *line = buffer.substr(0, end);
+                buffer.erase(0, end + 1);
+                if (!line->empty() && line->back() == '\r')
+                    line->pop_back();
+                return true;
+            }
+
+            if (eof || buffer.size() > MAX_LINE_LEN || shutdown->load())
+                return false;
+
+            pollfd pfd = {.fd = fd, .events = POLLIN, .revents = 0};
+            if (poll(&pfd, 1, POLL_INTERVAL_MS) <= 0)
+                continue;
+
+            char chunk[4096];
+            ssize_t len = recv(fd, chunk, sizeof(chunk), 0);
+            if (len <= 0) {
+                // A last line without a newline still counts.
+                eof = true;
+                if (buffer.empty())
+                    return false;
+                buffer.push_back('\n');
+                continue;
+            }
+
+            buffer.append(chunk, len);
+        }
+    }
+};
+
+std::vector<std::string> split(const std::string& line) {
+    std::vector<std::string> words;
+    u64 start = 0;
+    while (start < line.size()) {
+        u64 end = line.find(' ', start);
+        if (end == std::string::npos)
+            end = line.size();
+        if (end > start)
+            words.push_back(line.substr(start, end - start));
+        start = end + 1;
+    }
+
+    return words;
+}
+
+// Reads the job header and its targets, returns an empty string or why the job can't be run.
+std::string read_job(LineReader* reader, Request* request) {
+    std::string line;
+    if (!reader->next(&line))
+        return "missing job line";
+
+    std::vector<std::string> words = split(line);
+    if (words.size() < 3 || words.size() > 4 || words[0] != "job")
+        return "expected 'job <mode> <pattern> [priority]'";
+
+    Mode mode;
+    if (words[1] == "wpa")
+        mode = Mode::Passphrase;
+    else if (!modes::parse(words[1].c_str(), &mode) || modes::is_wpa(mode))
+        return "unknown mode '" + words[1] + "'";
+
+    u64 max_len = 0;
+    u64 digest_bytes = 0;
+    modes::dispatch(mode, [&](auto m) {
+        max_len = decltype(m)::MAX_CANDIDATE_LEN;
+        digest_bytes = decltype(m)::DIGEST_BYTES;
+    });
+
+    const std::string& pattern = words[2];
+    if (!hash::valid_pattern((const u8*)pattern.c_str(), pattern.size()))
+        return "invalid pattern '" + pattern + "'";
+    if (pattern.size() > max_len)
+        return words[1] + " mode takes candidates of at most " + std::to_string(max_len) +
+               " characters";
+
+    request->priority = 0;
+    if (words.size() == 4) {
+        char* end;
+        request->priority = strtoll(words[3].c_str(), &end, 10);
+        if (*end != '\0')
+            return "invalid priority '" + words[3] + "'";
+    }
+
+    Job* job = &request->job;
+    job->pattern = pattern;
+    job->mode = mode;
+
+    while (reader->next(&line) && !line.empty()) {
+        Target target;
+        if (!modes::is_wpa(mode)) {
+            if (!hashfile::parse_digest(line.c_str(), line.size(), digest_bytes, &target))
+                return "invalid digest '" + line + "'";
+        } else {
+            Handshake handshake;
+            bool skipped = false;
+            if (!hashfile::parse_line(line.c_str(), line.size(), &target, &handshake, &skipped)) {
+                if (skipped)
+                    continue;
+                return "invalid hash line '" + line + "'";
+            }
+
+            if (target.kind == TargetKind::Eapol) {
+                target.handshake_idx = job->handshakes.size();
+                job->handshakes.push_back(handshake);
+            }
+        }
+
+        job->targets.push_back(target);
+    }
+
+    if (reader->buffer.size() > MAX_LINE_LEN)
+        return "line too long";
+
+    hashfile::dedup(&job->targets);
+    if (job->targets.empty())
+        return "no usable targets";
+
+    return "";
+}
+
+// Reads a job from a fresh connection and queues it.
+void handle(Server* server, int fd) {
+    auto request = std::make_unique<Request>();
+    request->fd = fd;
+
+    LineReader reader = {.fd = fd, .shutdown = server->shutdown};
+    std::string problem = read_job(&reader, request.get());
+    if (!problem.empty()) {
+        request->reply("error " + problem);
+        return;
+    }
+
+    // Replies are sent without holding the server's mutex, a client that doesn't read its socket
+    // would stall the runner and every other connection otherwise.
+    u64 ahead;
+    {
+        std::lock_guard<std::mutex> lock(server->mutex);
+        request->id = server->next_id++;
+        ahead = server->pending.size();
+    }
+
+    request->reply(
+        "queued " + std::to_string(request->id) + " " +
+        std::to_string(request->job.targets.size()) + " " + std::to_string(ahead));
+
+    {
+        std::lock_guard<std::mutex> lock(server->mutex);
+        if (!server->stopping) {
+            server->pending.push_back(std::move(request));
+            server->cv.notify_one();
+            return;
+        }
+    }
+
+    request->reply("error shutting down");
+}
+
+// Highest priority first, then the oldest.
+std::unique_ptr<Request> pop(Server* server) {
+    std::unique_lock<std::mutex> lock(server->mutex);
+    server->cv.wait(lock, [&] { return server->stopping || !server->pending.empty(); });
+    if (server->stopping)
+        return nullptr;
+
+    u64 best = 0;
+    for (u64 idx = 1; idx < server->pending.size(); idx++) {
+        const Request& request = *server->pending[idx];
+        const Request& other = *server->pending[best];
+        if (request.priority > other.priority ||
+            (request.priority == other.priority && request.id < other.id))
+            best = idx;
+    }
+
+    std::unique_ptr<Request> request = std::move(server->pending[best]);
+    server->pending.erase(server->pending.begin() + best);
+    server->current = request.get();
+    return request;
+}
+
+void run_job(Server* server, Request* request) {
+    std::string id = std::to_string(request->id);
+    const Job& job = request->job;
+
+    std::string keyspace =
+        hash::to_string(hash::keyspace((const u8*)job.pattern.c_str(), job.pattern.size()));
+
+    Config config = *server->config;
+    config.verbose = false;
+    config.pool = server->pool;
+    config.cancel = &request->stop;
+    config.on_hit = [&](const Hit& hit) {
+        u64 len = strnlen((const char*)hit.passphrase, sizeof(hit.passphrase));
+        request->reply(
+            "hit " + id + " " + potfile::target_key(job.mode, job.targets[hit.target_idx]) + ":" +
+            potfile::encode(hit.passphrase, len));
+    };
+    config.on_progress = [&](u64 hashes, f64 rate) {
+        char line[128];
+        snprintf(line, sizeof(line), " %lld %s %.1f", hashes, keyspace.c_str(), rate);
+        request->reply("progress " + id + line);
+    };
+
+    Result result = run(job, config);
+
+    char line[128];
+    snprintf(
+        line,
+        sizeof(line),
+        " %lld %lld %.3f",
+        (u64)result.hits.size(),
+        result.hashes,
+        result.seconds);
+
+    // Replies to a client that is gone are dropped, so a stopped job here means a shutdown.
+    request->reply(request->stop.load() ? std::string("error shutting down") : "done " + id + line);
+
+    if (!server->config->verbose)
+        return;
+
+    printf(
+        "job %s: %s '%s' against %lld targets, %lld hits in %.2fs%s\n",
+        id.c_str(),
+        modes::name(job.mode),
+        job.pattern.c_str(),
+        (u64)job.targets.size(),
+        (u64)result.hits.size(),
+        result.seconds,
+        request->stop.load() ? " (cancelled)" : "");
+    fflush(stdout);
+}
+
+void run_jobs(Server* server) {
+    while (std::unique_ptr<Request> request = pop(server)) {
+        request->reply("started " + std::to_string(request->id));
+        if (!request->cancelled.load())
+            run_job(server, request.get());
+
+        std::lock_guard<std::mutex> lock(server->mutex);
+        server->current = nullptr;
+    }
+}
+
+struct Connection {
+    std::thread thread;
+    std::atomic<bool> done = false;
+};
+
+void serve(const char* socket_path, const Config& config, const std::atomic<bool>* shutdown) {
+    if (!shutdown) {
+        signal(SIGINT, on_signal);
+        signal(SIGTERM, on_signal);
+        shutdown = &signalled;
+    }
+
+    sockaddr_un addr = {.sun_family = AF_UNIX, .sun_path = {0}};
+    if (strlen(socket_path) >= sizeof(addr.sun_path))
+        error("socket path '%s' is too long\n", socket_path);
+    strncpy(addr.sun_path, socket_path, sizeof(addr.sun_path) - 1);
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0)
+        error("failed to create socket: %s\n", strerror(errno));
+
+    // A daemon that was killed leaves its socket file behind.
+    unlink(socket_path);
+    if (bind(listen_fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listen_fd, 64) != 0)
+        error("failed to listen on '%s': %s\n", socket_path, strerror(errno));
+
+    topology::Topology topo = topology::discover();
+    pool::Pool pool(worker_cpus(config, topo));
+
+    u64 unpinned = 0;
+    for (u64 idx = 0; idx < pool.size(); idx++)
+        unpinned += config.pinning != topology::Pinning::None && !pool.pinned(idx);
+
+    if (config.verbose) {
+        printf(
+            "listening on %s with %lld threads (kernel: %s, pinning: %s)\n",
+            socket_path,
+            (u64)pool.size(),
+            kernels::name(config.kernel),
+            topology::pinning_name(config.pinning));
+        if (unpinned)
+            printf("failed to pin %lld threads, they were left to the OS scheduler\n", unpinned);
+        fflush(stdout);
+    }
+
+    Server server = {.config = &config, .shutdown = shutdown, .pool = &pool};
+    std::thread runner(run_jobs, &server);
+    std::list<Connection> connections;
+
+    while (!shutdown->load()) {
+        connections.remove_if([](Connection& connection) {
+            if (!connection.done.load())
+                return false;
+            connection.thread.join();
+            return true;
+        });
+
+        pollfd pfd = {.fd = listen_fd, .events = POLLIN, .revents = 0};
+        if (poll(&pfd, 1, POLL_INTERVAL_MS) <= 0)
+            continue;
+
+        int fd = accept(listen_fd, nullptr, nullptr);
+        if (fd < 0)
+            continue;
+
+        Connection* connection = &connections.emplace_back();
+        connection->thread = std::thread([&server, connection, fd]() {
+            handle(&server, fd);
+            connection->done.store(true);
+        });
+    }
+
+    close(listen_fd);
+    unlink(socket_path);
+
+    for (Connection& connection : connections)
+        connection.thread.join();
+
+    // The running job is stopped and replies itself, queued ones are turned away. Replies are sent
+    // after releasing the mutex, like everywhere else.
+    std::vector<std::unique_ptr<Request>> turned_away;
+    {
+        std::lock_guard<std::mutex> lock(server.mutex);
+        server.stopping = true;
+        turned_away = std::move(server.pending);
+        server.pending.clear();
+
+        if (server.current)
+            server.current->stop.store(true);
+    }
+    server.cv.notify_all();
+
+    for (std::unique_ptr<Request>& request : turned_away)
+        request->reply("error shutting down");
+    runner.join();
+}
+
+} // namespace cpu::daemon
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+
+#include "src/common.hpp"
+#include "src/backend/cpu/cpu.hpp"
+
+namespace cpu::daemon {
+
+// Long-lived server for many small jobs, which keeps its pinned worker threads between them (see
+// `pool::Pool`) and parses the next jobs while the current one runs. Clients connect to a Unix
+// stream socket and send a job as lines of text:
+//
+//   job <wpa | sha1 | md5 | ntlm> <pattern> [priority]
+//   <22000/16800 line or hex digest>
+//   ...
+//   <empty line or end of stream>
+//
+// Jobs run one at a time on the whole pool, highest priority first (0 by default) and in arrival
+// order otherwise. The connection stays open while the job waits and runs and gets back:
+//
+//   queued <id> <targets> <jobs ahead>
+//   started <id>
+//   progress <id> <hashes> <keyspace> <hashes per second>
+//   hit <id> <target key>:<passphrase>       in the potfile's format
+//   done <id> <hits> <hashes> <seconds>
+//
+// or `error <message>` for a job that can't be run. Closing the connection cancels the job, so
+// does not reading replies for two seconds. A hangup is noticed when a reply fails, so a job whose
+// client left while it was queued is only dropped once it's reached.
+// `config` applies to every job, its `potfile_path` records their hits.
+//
+// Serves until `shutdown` is set, or without one until SIGINT or SIGTERM.
+void serve(
+    const char* socket_path,
+    const Config& config,
+    const std::atomic<bool>* shutdown = nullptr);
+
+} // namespace cpu::daemon
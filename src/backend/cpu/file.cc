@@ -0,0 +1,48 @@
+#include "src/backend/cpu/file.hpp"
+#include "src/common.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace cpu::file {
+
+Mapping map(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        error("failed to open '%s'\n", path);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+        error("failed to stat '%s'\n", path);
+
+    Mapping mapping = Mapping{.data = nullptr, .size = (u64)st.st_size};
+    if (mapping.size) {
+        void* ptr = mmap(nullptr, mapping.size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (ptr == MAP_FAILED)
+            error("failed to map '%s'\n", path);
+
+        // Files are read front to back, let the kernel read ahead aggressively.
+        madvise(ptr, mapping.size, MADV_SEQUENTIAL);
+        mapping.data = static_cast<const u8*>(ptr);
+    }
+
+    // The mapping keeps the file alive.
+    close(fd);
+    return mapping;
+}
+
+void unmap(Mapping mapping) {
+    if (mapping.data)
+        munmap(const_cast<u8*>(mapping.data), mapping.size);
+}
+
+void release(Mapping mapping, u64 offset) {
+    u64 page_size = sysconf(_SC_PAGESIZE);
+    u64 len = offset / page_size * page_size;
+    if (mapping.data && len)
+        madvise(const_cast<u8*>(mapping.data), len, MADV_DONTNEED);
+}
+
+} // namespace cpu::file
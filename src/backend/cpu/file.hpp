@@ -0,0 +1,21 @@
+#pragma once
+
+#include "src/common.hpp"
+
+namespace cpu::file {
+
+// Read-only view of a whole file, paged in by the OS as it's read.
+struct Mapping {
+    const u8* data;
+    u64 size;
+};
+
+// Errors out if the file can't be opened. Empty files map to a null pointer and a size of 0.
+Mapping map(const char* path);
+void unmap(Mapping mapping);
+
+// Unmaps the pages before `offset` from the process, such that streaming through files larger
+// than memory doesn't grow the resident set. They are read again from disk if touched.
+void release(Mapping mapping, u64 offset);
+
+} // namespace cpu::file
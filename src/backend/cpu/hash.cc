@@ -1,7 +1,11 @@
+#include <cstring>
+#include <array>
 #include <functional>
+#include <utility>
 
 #include "src/common.hpp"
 #include "src/backend/cpu/hash.hpp"
+#include "src/backend/cpu/kernels.hpp"
 #include "src/backend/cpu/sha1.hpp"
 
 namespace cpu::hash {
@@ -52,23 +56,183 @@ void pmkid(const u8 pmk[64], const u8 mac_ap[6], const u8 mac_sta[6], u32 out_ha
     hmac_sha1_128(reinterpret_cast<const u32*>(pmk), reinterpret_cast<u32*>(msg), out_hash);
 }
 
-// Function to initialize indices based on a given index.
-inline void initialize_indices(u64 current_idx, u32 indices[], const u32 set_sizes[], u64 len) {
+#define MAX_LEN 64
+
+const char* char_set(u8 chr, u32* size) {
+    switch (chr) {
+        case 'd':
+            *size = sizeof(DIGITS);
+            return DIGITS;
+        case 'l':
+            *size = sizeof(LOWERCASE);
+            return LOWERCASE;
+        case 'u':
+            *size = sizeof(UPPERCASE);
+            return UPPERCASE;
+        case 'a':
+            *size = sizeof(ALPHA);
+            return ALPHA;
+        case 'n':
+            *size = sizeof(ALPHA_NUM);
+            return ALPHA_NUM;
+        case '?':
+            *size = sizeof(ANY);
+            return ANY;
+    }
+
+    return nullptr;
+}
+
+// Precompute character sets for each position in the pattern.
+void init_char_sets(const u8 pattern[MAX_LEN], u64 len, const char* char_sets[], u32 set_sizes[]) {
     for (u64 idx = 0; idx < len; idx++) {
-        u32 set_size = set_sizes[idx];
-        indices[idx] = current_idx % set_size;
-        current_idx /= set_size;
+        char_sets[idx] = char_set(pattern[idx], &set_sizes[idx]);
+        if (!char_sets[idx])
+            error("invalid pattern character '%c'\n", pattern[idx]);
     }
 }
 
-#define MAX_LEN 64
+bool valid_pattern(const u8* pattern, u64 len) {
+    if (len >= MAX_LEN)
+        return false;
+
+    u128 perms = 1;
+    for (u64 idx = 0; idx < len; idx++) {
+        u32 size;
+        if (!char_set(pattern[idx], &size) || perms > ~(u128)0 / size)
+            return false;
+        perms *= size;
+    }
+
+    return true;
+}
+
+Radix make_radix(u32 size) {
+    if (size < 2)
+        error("charsets need at least two characters\n");
+
+    u32 log2 = 0;
+    while ((1ull << log2) < size)
+        log2++;
+
+    if ((1u << log2) == size)
+        return Radix{.size = size, .pow2 = true, .shift = log2, .magic = 0};
+
+    // m' = floor(2^64 * (2^l - d) / d) + 1 and l >= 2, such that the first shift is always 1.
+    u64 magic = (u64)((((u128)((1ull << log2) - size)) << 64) / size) + 1;
+    return Radix{.size = size, .pow2 = false, .shift = log2 - 1, .magic = magic};
+}
+
+void init_decoder(const u32 set_sizes[], u64 len, Decoder* out) {
+    out->len = len;
+    for (u64 idx = 0; idx < len; idx++) {
+        out->set_sizes[idx] = set_sizes[idx];
+        out->radixes[idx] = make_radix(set_sizes[idx]);
+    }
+}
+
+u64 decode_batch(
+    const Decoder& decoder,
+    const char* const char_sets[],
+    u128 first,
+    u64 count,
+    u8 out[][64]) {
+    u32 indices[MAX_LEN];
+    initialize_indices(decoder, first, indices);
+
+    for (u64 idx = 0; idx < count; idx++) {
+        memset(out[idx], 0, MAX_LEN);
+        pack_candidate(indices, char_sets, decoder.len, out[idx]);
+
+        if (idx + 1 < count && !next_indices(indices, decoder.set_sizes, decoder.len))
+            return idx + 1;
+    }
+
+    return count;
+}
+
+// The finalizer of splitmix64.
+u64 mix64(u64 x) {
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+    return x ^ (x >> 31);
+}
+
+void init_permutation(u128 size, u64 seed, Permutation* out) {
+    u32 bits = 0;
+    while (bits < 128 && ((u128)1 << bits) < size)
+        bits++;
+
+    out->size = size;
+    out->half_bits = bits < 2 ? 1 : (bits + 1) / 2;
+    for (u64 round = 0; round < FEISTEL_ROUNDS; round++) {
+        seed += 0x9e3779b97f4a7c15;
+        out->keys[round] = mix64(seed);
+    }
+}
+
+u128 permute(const Permutation& permutation, u128 idx) {
+    if (permutation.size <= 1)
+        return idx;
+
+    u32 half_bits = permutation.half_bits;
+    u64 mask = half_bits == 64 ? ~(u64)0 : ((u64)1 << half_bits) - 1;
+
+    // Cycle walking, every value in range is reached from one in range.
+    do {
+        u64 left = (u64)(idx >> half_bits) & mask;
+        u64 right = (u64)idx & mask;
+
+        for (u64 round = 0; round < FEISTEL_ROUNDS; round++) {
+            u64 next = left ^ (mix64(right ^ permutation.keys[round]) & mask);
+            left = right;
+            right = next;
+        }
+
+        idx = ((u128)left << half_bits) | right;
+    } while (idx >= permutation.size);
+
+    return idx;
+}
+
+bool valid_stride(u64 stride) {
+    return stride && (stride & (stride - 1)) == 0;
+}
+
+u128 keyspace(const u8 pattern[MAX_LEN], u64 len) {
+    const char* char_sets[MAX_LEN];
+    u32 set_sizes[MAX_LEN];
+    init_char_sets(pattern, len, char_sets, set_sizes);
+
+    u128 perms = 1;
+    for (u64 idx = 0; idx < len; idx++) {
+        if (perms > ~(u128)0 / set_sizes[idx])
+            error("patterns can have at most 2^128 candidates\n");
+        perms *= set_sizes[idx];
+    }
+
+    return perms;
+}
+
+std::string to_string(u128 value) {
+    char digits[40];
+    char* start = digits + sizeof(digits);
+    do {
+        *--start = (char)('0' + (u32)(value % 10));
+        value /= 10;
+    } while (value);
+
+    return std::string(start, digits + sizeof(digits) - start);
+}
 
 void generate_permutations(
     const u8 pattern[MAX_LEN],
     u64 len,
     u64 chunk_idx,
     u64 chunk_count,
-    std::function<bool(const u8[MAX_LEN])> callback) {
+    std::function<bool(const u8[MAX_LEN])> callback,
+    const Permutation* permutation,
+    u64 stride) {
     u8 current[MAX_LEN] = {0};
 
     if (chunk_idx >= chunk_count)
@@ -77,87 +241,151 @@ void generate_permutations(
     if (chunk_count == 0)
         error("chunk count of 0 is not supported.\n");
 
-    // Precompute character sets for each position in the pattern.
+    if (!valid_stride(stride))
+        error("stride %lld is not a power of two\n", stride);
+
     const char* char_sets[MAX_LEN];
     u32 set_sizes[MAX_LEN];
+    init_char_sets(pattern, len, char_sets, set_sizes);
 
-    for (u64 idx = 0; idx < len; idx++) {
-        switch (pattern[idx]) {
-            case 'd':
-                char_sets[idx] = DIGITS;
-                set_sizes[idx] = sizeof(DIGITS);
-                break;
-            case 'l':
-                char_sets[idx] = LOWERCASE;
-                set_sizes[idx] = sizeof(LOWERCASE);
-                break;
-            case 'u':
-                char_sets[idx] = UPPERCASE;
-                set_sizes[idx] = sizeof(UPPERCASE);
-                break;
-            case 'a':
-                char_sets[idx] = ALPHA;
-                set_sizes[idx] = sizeof(ALPHA);
-                break;
-            case 'n':
-                char_sets[idx] = ALPHA_NUM;
-                set_sizes[idx] = sizeof(ALPHA_NUM);
-                break;
-            case '?':
-                char_sets[idx] = ANY;
-                set_sizes[idx] = sizeof(ANY);
-                break;
-            default:
-                error("invalid pattern character '%c'\n", pattern[idx]);
-        }
-    }
-
-    // Calculate the total number of permutations.
-    u64 perms = 1;
-    for (u64 idx = 0; idx < len; idx++)
-        perms *= set_sizes[idx];
+    Decoder decoder;
+    init_decoder(set_sizes, len, &decoder);
 
     // Calculate the range of permutations this chunk will handle.
-    u64 stride = 1024 * 64;
-    u64 start_idx = chunk_idx * stride;
-    u64 end_idx = perms;
+    u128 start_idx = (u128)chunk_idx * stride;
+    u128 end_idx = keyspace(pattern, len);
 
     // Initialize indices to start at start_index.
     u32 indices[MAX_LEN];
-    initialize_indices(start_idx, indices, set_sizes, len);
+
+    // The same strides, but every candidate is decoded from its permuted index.
+    if (permutation) {
+        while (start_idx < end_idx) {
+            initialize_indices(decoder, permute(*permutation, start_idx), indices);
+            pack_candidate(indices, char_sets, len, current);
+
+            if (!callback(current))
+                return;
+
+            start_idx++;
+            if (((u64)start_idx & (stride - 1)) == 0)
+                start_idx += (u128)(chunk_count - 1) * stride;
+        }
+
+        return;
+    }
+
+    initialize_indices(decoder, start_idx, indices);
 
     while (start_idx < end_idx) {
-        // Construct the current permutation based on indices.
-        for (u64 idx = 0; idx < len; idx++)
-            current[idx] = char_sets[idx][indices[idx]];
+        pack_candidate(indices, char_sets, len, current);
 
         if (!callback(current))
             return;
 
-        // Increment indices from left to right.
-        u64 pos = 0;
-        while (pos < len) {
-            if (indices[pos] < set_sizes[pos] - 1) {
-                indices[pos]++;
-                break;
-            } else {
-                indices[pos] = 0;
-                pos++;
-            }
-        }
-
         // All permutations generated
-        if (pos == len)
+        if (!next_indices(indices, set_sizes, len))
             break;
 
         start_idx++;
 
         // If we've completed a stride, move to the next chunk's corresponding stride.
-        if (start_idx % stride == 0) {
-            start_idx += (chunk_count - 1) * stride;
-            initialize_indices(start_idx, indices, set_sizes, len);
+        if (((u64)start_idx & (stride - 1)) == 0) {
+            start_idx += (u128)(chunk_count - 1) * stride;
+            initialize_indices(decoder, start_idx, indices);
+        }
+    }
+}
+
+// What the instantiations of `generate_batches_len` share.
+struct Enumeration {
+    const char* char_sets[MAX_LEN];
+    u32 set_sizes[MAX_LEN];
+    Decoder decoder;
+    u128 keyspace;
+    u64 stride;
+};
+
+template <u64 LEN>
+void generate_batches_len(
+    const Enumeration& en,
+    u64 chunk_idx,
+    u64 chunk_count,
+    const BatchCallback& callback,
+    const Permutation* permutation) {
+    // Rows are only ever written up to `LEN`, the padding after it is zeroed once.
+    u8 batch[kernels::MAX_LANES][MAX_LEN] = {{0}};
+    u64 count = 0;
+
+    u128 idx = (u128)chunk_idx * en.stride;
+    u32 indices[MAX_LEN];
+    if (!permutation)
+        initialize_indices(en.decoder, idx, indices);
+
+    while (idx < en.keyspace) {
+        if (permutation)
+            initialize_indices(en.decoder, permute(*permutation, idx), indices);
+
+#pragma GCC unroll 64
+        for (u64 pos = 0; pos < LEN; pos++)
+            batch[count][pos] = en.char_sets[pos][indices[pos]];
+
+        if (++count == kernels::MAX_LANES) {
+            if (!callback(batch, count))
+                return;
+            count = 0;
+        }
+
+        // Wraps around exactly when `idx` reaches the end of the keyspace.
+        if (!permutation)
+            next_indices(indices, en.set_sizes, LEN);
+
+        idx++;
+        if (((u64)idx & (en.stride - 1)) == 0) {
+            idx += (u128)(chunk_count - 1) * en.stride;
+            if (!permutation)
+                initialize_indices(en.decoder, idx, indices);
         }
     }
+
+    if (count)
+        callback(batch, count);
+}
+
+using Generator = void (*)(const Enumeration&, u64, u64, const BatchCallback&, const Permutation*);
+
+template <size_t... LENS>
+constexpr std::array<Generator, sizeof...(LENS)> make_generators(std::index_sequence<LENS...>) {
+    return {&generate_batches_len<LENS>...};
+}
+
+const std::array<Generator, MAX_LEN> GENERATORS =
+    make_generators(std::make_index_sequence<MAX_LEN>());
+
+void generate_batches(
+    const u8 pattern[MAX_LEN],
+    u64 len,
+    u64 chunk_idx,
+    u64 chunk_count,
+    BatchCallback callback,
+    const Permutation* permutation,
+    u64 stride) {
+    if (chunk_count == 0 || chunk_idx >= chunk_count)
+        error("idx %lld, is out of range of chunk count %lld\n", chunk_idx, chunk_count);
+
+    if (!valid_stride(stride))
+        error("stride %lld is not a power of two\n", stride);
+
+    if (len >= MAX_LEN)
+        error("patterns must be shorter than %d characters\n", MAX_LEN);
+
+    Enumeration en;
+    init_char_sets(pattern, len, en.char_sets, en.set_sizes);
+    init_decoder(en.set_sizes, len, &en.decoder);
+    en.keyspace = keyspace(pattern, len);
+    en.stride = stride;
+
+    GENERATORS[len](en, chunk_idx, chunk_count, callback, permutation);
 }
 
 } // namespace hash
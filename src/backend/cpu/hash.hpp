@@ -1,6 +1,7 @@
 #pragma once 
 
 #include <functional>
+#include <string>
 
 #include "src/common.hpp"
 
@@ -38,11 +39,140 @@ const char ANY[] =
     "!\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~";
 
 void pmkid(const u8 pmk[64], const u8 mac_ap[6], const u8 mac_sta[6], u32 out_hash[5]);
+
+// Precompute character sets for each position in the pattern.
+void init_char_sets(const u8 pattern[64], u64 len, const char* char_sets[], u32 set_sizes[]);
+
+// Divides by a charset size with a multiplication and shifts instead of a division, following
+// Granlund and Montgomery, "Division by Invariant Integers using Multiplication", figure 4.1.
+// Sizes that are powers of two only shift.
+struct Radix {
+    u32 size;
+    bool pow2;
+    u32 shift;
+    u64 magic;
+};
+
+Radix make_radix(u32 size);
+
+inline u64 divide(const Radix& radix, u64 n) {
+    if (radix.pow2)
+        return n >> radix.shift;
+
+    u64 t = (u64)(((u128)radix.magic * n) >> 64);
+    return (t + ((n - t) >> 1)) >> radix.shift;
+}
+
+// Maps keyspace indices to the index into each position's charset, position 0 being the least
+// significant digit like in `next_indices`.
+struct Decoder {
+    u64 len;
+    u32 set_sizes[64];
+    Radix radixes[64];
+};
+
+void init_decoder(const u32 set_sizes[], u64 len, Decoder* out);
+
+// Function to initialize indices based on a given index.
+inline void initialize_indices(const Decoder& decoder, u128 current_idx, u32 indices[]) {
+    u64 pos = 0;
+
+    // Only indices past 2^64 take the slow 128-bit division, and only for the first few digits.
+    for (; pos < decoder.len && (current_idx >> 64); pos++) {
+        u32 set_size = decoder.radixes[pos].size;
+        indices[pos] = (u32)(current_idx % set_size);
+        current_idx /= set_size;
+    }
+
+    u64 rest = (u64)current_idx;
+    for (; pos < decoder.len; pos++) {
+        u64 quotient = divide(decoder.radixes[pos], rest);
+        indices[pos] = (u32)(rest - quotient * decoder.radixes[pos].size);
+        rest = quotient;
+    }
+}
+
+// Increment indices from left to right, returns false once they wrapped around.
+inline bool next_indices(u32 indices[], const u32 set_sizes[], u64 len) {
+    for (u64 pos = 0; pos < len; pos++) {
+        if (indices[pos] < set_sizes[pos] - 1) {
+            indices[pos]++;
+            return true;
+        }
+        indices[pos] = 0;
+    }
+
+    return false;
+}
+
+// Construct the candidate based on indices.
+inline void pack_candidate(const u32 indices[], const char* const char_sets[], u64 len, u8 out[]) {
+    for (u64 idx = 0; idx < len; idx++)
+        out[idx] = char_sets[idx][indices[idx]];
+}
+
+// Candidates of `count` consecutive indices starting at `first`, zero padded, as a batch for the
+// kernels. Only the first index is decoded, the others are steps of `next_indices`. Returns how
+// many candidates were written, fewer than `count` where the keyspace ends.
+u64 decode_batch(
+    const Decoder& decoder,
+    const char* const char_sets[],
+    u128 first,
+    u64 count,
+    u8 out[][64]);
+
+constexpr u64 FEISTEL_ROUNDS = 4;
+
+// Keyed bijection of [0, size): a balanced Feistel network over the fewest even number of bits
+// that covers `size`, applied again while the result is out of range. That domain is less than
+// four times `size`, so it takes fewer than four walks on average. Visiting 0, 1, 2, ... through it
+// spreads any prefix of a run uniformly over the keyspace.
+struct Permutation {
+    u128 size;
+    u32 half_bits;
+    u64 keys[FEISTEL_ROUNDS];
+};
+
+void init_permutation(u128 size, u64 seed, Permutation* out);
+u128 permute(const Permutation& permutation, u128 idx);
+
+// Whether every character of the pattern names a character set and its keyspace stays below
+// 2^128, for patterns that come from somewhere other than the command line.
+bool valid_pattern(const u8* pattern, u64 len);
+
+// Number of candidates of the pattern, which must stay below 2^128.
+u128 keyspace(const u8 pattern[64], u64 len);
+
+std::string to_string(u128 value);
+
+// Candidates a thread enumerates before skipping over the strides of the other threads, unless a
+// `stride` is passed. Strides are powers of two.
+const u64 STRIDE = 1024 * 64;
+
+bool valid_stride(u64 stride);
+
 void generate_permutations(
     const u8 pattern[64],
     u64 len,
     u64 chunk_idx,
     u64 chunk_count,
-    std::function<bool(const u8[64])> callback);
+    std::function<bool(const u8[64])> callback,
+    const Permutation* permutation = nullptr,
+    u64 stride = STRIDE);
+
+// Gets a batch of up to `kernels::MAX_LANES` zero padded candidates, returns false to stop.
+using BatchCallback = std::function<bool(const u8 batch[][64], u64 count)>;
+
+// The candidates of `generate_permutations` in the same order, a batch at a time. Each pattern
+// length has its own instantiation of the loop, picked from a table, such that packing, stepping
+// and the zero padding of the batch rows are unrolled for the length.
+void generate_batches(
+    const u8 pattern[64],
+    u64 len,
+    u64 chunk_idx,
+    u64 chunk_count,
+    BatchCallback callback,
+    const Permutation* permutation = nullptr,
+    u64 stride = STRIDE);
 
 } // namespace hash
@@ -0,0 +1,312 @@
+#include "src/backend/cpu/hashfile.hpp"
+#include "src/backend/cpu/file.hpp"
+#include "src/backend/cpu/modes.hpp"
+#include "src/backend/cpu/topology.hpp"
+#include "src/common.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace cpu::hashfile {
+
+// Smaller files aren't worth spawning threads for.
+constexpr u64 MIN_BYTES_PER_THREAD = 1 << 20;
+
+constexpr u64 MAX_FIELDS = 10;
+
+struct Field {
+    const char* data;
+    u64 len;
+};
+
+// Splits `line` at `sep`, returns the number of fields or MAX_FIELDS + 1 if there are too many.
+u64 split(const char* line, u64 len, char sep, Field fields[MAX_FIELDS]) {
+    u64 count = 0;
+    u64 start = 0;
+    for (u64 idx = 0; idx <= len; idx++) {
+        if (idx < len && line[idx] != sep)
+            continue;
+        if (count == MAX_FIELDS)
+            return MAX_FIELDS + 1;
+
+        fields[count++] = Field{.data = line + start, .len = idx - start};
+        start = idx + 1;
+    }
+
+    return count;
+}
+
+i32 hex_value(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+bool parse_hex(Field field, u8* out, u64 len) {
+    if (field.len != len * 2)
+        return false;
+
+    for (u64 idx = 0; idx < len; idx++) {
+        i32 hi = hex_value(field.data[idx * 2]);
+        i32 lo = hex_value(field.data[idx * 2 + 1]);
+        if (hi < 0 || lo < 0)
+            return false;
+        out[idx] = static_cast<u8>(hi << 4 | lo);
+    }
+
+    return true;
+}
+
+// Fields shared by all formats: PMKID or MIC, MAC_AP, MAC_STA and the hex encoded ESSID.
+bool parse_target(const Field fields[4], Target* target) {
+    *target = Target{};
+
+    u64 essid_len = fields[3].len / 2;
+    if (essid_len == 0 || essid_len > sizeof(target->essid) || fields[3].len % 2 != 0)
+        return false;
+    target->essid_len = essid_len;
+
+    // Only the 128 bits of the PMKID or MIC are compared, the last word stays zero.
+    return parse_hex(fields[0], reinterpret_cast<u8*>(target->hash), 16) &&
+           parse_hex(fields[1], target->mac_ap, sizeof(target->mac_ap)) &&
+           parse_hex(fields[2], target->mac_sta, sizeof(target->mac_sta)) &&
+           parse_hex(fields[3], target->essid, essid_len);
+}
+
+// ANONCE and the EAPOL-Key frame of message 2, which starts with the EAPOL header.
+bool parse_handshake(const Field fields[2], Handshake* handshake, bool* skipped) {
+    *handshake = Handshake{};
+
+    u64 eapol_len = fields[1].len / 2;
+    if (eapol_len < 99 || fields[1].len % 2 != 0 ||
+        !parse_hex(fields[0], handshake->anonce, sizeof(handshake->anonce)))
+        return false;
+
+    // Frames too long for the kernels are still well formed.
+    if (eapol_len > sizeof(handshake->eapol)) {
+        *skipped = true;
+        return false;
+    }
+
+    if (!parse_hex(fields[1], handshake->eapol, eapol_len))
+        return false;
+    handshake->eapol_len = eapol_len;
+
+    // Key information is a big endian field after the descriptor type, the SNonce follows the
+    // replay counter.
+    u8* key = handshake->eapol;
+    handshake->key_version = key[6] & 0x07;
+    memcpy(handshake->snonce, key + 17, sizeof(handshake->snonce));
+
+    // Version 3 uses AES-CMAC, which isn't supported.
+    if (handshake->key_version != 1 && handshake->key_version != 2) {
+        *skipped = true;
+        return false;
+    }
+
+    return true;
+}
+
+bool parse_line(const char* line, u64 len, Target* target, Handshake* handshake, bool* skipped) {
+    *skipped = false;
+    if (len && line[len - 1] == '\r')
+        len--;
+
+    Field fields[MAX_FIELDS];
+
+    if (len >= 4 && memcmp(line, "WPA*", 4) == 0) {
+        // WPA*TYPE*PMKID/MIC*MAC_AP*MAC_STA*ESSID*ANONCE*EAPOL*MESSAGEPAIR
+        if (split(line, len, '*', fields) != 9 || fields[1].len != 2)
+            return false;
+
+        if (memcmp(fields[1].data, "01", 2) == 0)
+            return parse_target(&fields[2], target);
+
+        if (memcmp(fields[1].data, "02", 2) == 0 && parse_target(&fields[2], target) &&
+            parse_handshake(&fields[6], handshake, skipped)) {
+            target->kind = TargetKind::Eapol;
+            return true;
+        }
+
+        return false;
+    }
+
+    // The separator follows the 32 hex characters of the PMKID.
+    if (len <= 32 || (line[32] != '*' && line[32] != ':'))
+        return false;
+
+    return split(line, len, line[32], fields) == 4 && parse_target(fields, target);
+}
+
+bool parse_digest(const char* line, u64 len, u64 digest_bytes, Target* target) {
+    if (len && line[len - 1] == '\r')
+        len--;
+
+    *target = Target{};
+    Field field = Field{.data = line, .len = len};
+    return parse_hex(field, reinterpret_cast<u8*>(target->hash), digest_bytes);
+}
+
+struct Chunk {
+    const char* begin;
+    const char* end;
+    std::vector<Target> targets;
+
+    // Indexed by the `handshake_idx` of the chunk's targets until they are merged.
+    std::vector<Handshake> handshakes;
+    Stats stats;
+
+    // Bytes of the unsalted mode's digests, 0 for WPA lines.
+    u64 digest_bytes;
+};
+
+void parse_chunk(Chunk* chunk) {
+    const char* line = chunk->begin;
+    while (line < chunk->end) {
+        const char* newline = static_cast<const char*>(memchr(line, '\n', chunk->end - line));
+        const char* line_end = newline ? newline : chunk->end;
+        u64 len = line_end - line;
+
+        if (len && !(len == 1 && line[0] == '\r')) {
+            chunk->stats.lines++;
+
+            Target target;
+            Handshake handshake;
+            bool skipped;
+            if (chunk->digest_bytes) {
+                if (parse_digest(line, len, chunk->digest_bytes, &target)) {
+                    chunk->targets.push_back(target);
+                    chunk->stats.digests++;
+                } else {
+                    chunk->stats.invalid++;
+                }
+            } else if (!parse_line(line, len, &target, &handshake, &skipped)) {
+                if (skipped)
+                    chunk->stats.skipped++;
+                else
+                    chunk->stats.invalid++;
+            } else if (target.kind == TargetKind::Eapol) {
+                target.handshake_idx = chunk->handshakes.size();
+                chunk->handshakes.push_back(handshake);
+                chunk->targets.push_back(target);
+                chunk->stats.eapols++;
+            } else {
+                chunk->targets.push_back(target);
+                chunk->stats.pmkids++;
+            }
+        }
+
+        line = line_end + 1;
+    }
+}
+
+i64 compare(const Target& a, const Target& b) {
+    if (a.essid_len != b.essid_len)
+        return a.essid_len < b.essid_len ? -1 : 1;
+    if (i64 cmp = memcmp(a.essid, b.essid, a.essid_len))
+        return cmp;
+    if (i64 cmp = memcmp(a.mac_ap, b.mac_ap, sizeof(a.mac_ap)))
+        return cmp;
+    if (i64 cmp = memcmp(a.mac_sta, b.mac_sta, sizeof(a.mac_sta)))
+        return cmp;
+    if (a.kind != b.kind)
+        return a.kind < b.kind ? -1 : 1;
+
+    // Handshakes are told apart by their MIC, which covers both nonces.
+    return memcmp(a.hash, b.hash, sizeof(a.hash));
+}
+
+u64 dedup(std::vector<Target>* targets) {
+    std::sort(targets->begin(), targets->end(), [](const Target& a, const Target& b) {
+        return compare(a, b) < 0;
+    });
+
+    auto last = std::unique(targets->begin(), targets->end(), [](const Target& a, const Target& b) {
+        return compare(a, b) == 0;
+    });
+
+    u64 dropped = targets->end() - last;
+    targets->erase(last, targets->end());
+    return dropped;
+}
+
+void load(const char* path, u64 thread_count, Job* job, Stats* stats) {
+    file::Mapping mapping = file::map(path);
+    const char* data = reinterpret_cast<const char*>(mapping.data);
+
+    if (thread_count == 0)
+        thread_count = topology::default_thread_count(topology::discover(), true);
+    thread_count = std::max<u64>(1, std::min(thread_count, mapping.size / MIN_BYTES_PER_THREAD));
+
+    u64 digest_bytes = 0;
+    if (!modes::is_wpa(job->mode))
+        modes::dispatch(job->mode, [&](auto m) { digest_bytes = decltype(m)::DIGEST_BYTES; });
+
+    // Every chunk but the first starts after a newline, such that no line is split.
+    std::vector<Chunk> chunks(thread_count, Chunk{});
+    const char* begin = data;
+    for (u64 idx = 0; idx < thread_count; idx++) {
+        const char* end = data + mapping.size * (idx + 1) / thread_count;
+        if (idx + 1 < thread_count) {
+            end = std::max(end, begin);
+            const char* newline =
+                static_cast<const char*>(memchr(end, '\n', data + mapping.size - end));
+            end = newline ? newline + 1 : data + mapping.size;
+        }
+
+        chunks[idx].begin = begin;
+        chunks[idx].end = end;
+        chunks[idx].digest_bytes = digest_bytes;
+        begin = end;
+    }
+
+    std::vector<std::thread> threads;
+    for (u64 idx = 1; idx < thread_count; idx++)
+        threads.emplace_back(parse_chunk, &chunks[idx]);
+    parse_chunk(&chunks[0]);
+    for (std::thread& thread : threads)
+        thread.join();
+
+    *stats = Stats{};
+    u64 total = 0;
+    u64 total_handshakes = 0;
+    for (const Chunk& chunk : chunks) {
+        stats->lines += chunk.stats.lines;
+        stats->pmkids += chunk.stats.pmkids;
+        stats->digests += chunk.stats.digests;
+        stats->eapols += chunk.stats.eapols;
+        stats->skipped += chunk.stats.skipped;
+        stats->invalid += chunk.stats.invalid;
+        total += chunk.targets.size();
+        total_handshakes += chunk.handshakes.size();
+    }
+
+    job->targets.clear();
+    job->targets.reserve(total);
+    job->handshakes.clear();
+    job->handshakes.reserve(total_handshakes);
+
+    for (Chunk& chunk : chunks) {
+        u64 handshake_offset = job->handshakes.size();
+        for (Target& target : chunk.targets)
+            if (target.kind == TargetKind::Eapol)
+                target.handshake_idx += handshake_offset;
+
+        job->targets.insert(job->targets.end(), chunk.targets.begin(), chunk.targets.end());
+        job->handshakes.insert(
+            job->handshakes.end(), chunk.handshakes.begin(), chunk.handshakes.end());
+        chunk.targets = {};
+        chunk.handshakes = {};
+    }
+
+    file::unmap(mapping);
+
+    stats->duplicates = dedup(&job->targets);
+}
+
+} // namespace cpu::hashfile
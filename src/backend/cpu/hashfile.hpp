@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+
+#include "src/common.hpp"
+#include "src/backend/cpu/cpu.hpp"
+
+namespace cpu::hashfile {
+
+struct Stats {
+    u64 lines;
+    u64 pmkids;
+
+    // Plain digests of the unsalted modes.
+    u64 digests;
+
+    // 22000 EAPOL (type 02) records.
+    u64 eapols;
+
+    // Well formed lines that can't be checked, e.g. handshakes with AES-CMAC MICs.
+    u64 skipped;
+    u64 invalid;
+
+    // Lines with the same PMKID or MIC, ESSID and MAC pair as an earlier one.
+    u64 duplicates;
+};
+
+// Parses a single hashcat 22000 (`WPA*01*PMKID*MAC_AP*MAC_STA*ESSID***` or
+// `WPA*02*MIC*MAC_AP*MAC_STA*ESSID*ANONCE*EAPOL*MESSAGEPAIR`) or 16800
+// (`PMKID*MAC_AP*MAC_STA*ESSID`, `:` also accepted) line, without its newline. EAPOL records
+// also set `*handshake`, the target's `handshake_idx` is left to the caller.
+// Returns false if the line can't be used, `*skipped` is set if it was still well formed.
+bool parse_line(const char* line, u64 len, Target* target, Handshake* handshake, bool* skipped);
+
+// Parses a hex digest of `digest_bytes` bytes for the unsalted modes, without its newline.
+bool parse_digest(const char* line, u64 len, u64 digest_bytes, Target* target);
+
+// Orders targets by ESSID and then MAC pair, the way `targets::new_table` groups them, and drops
+// identical ones. Returns how many were dropped.
+u64 dedup(std::vector<Target>* targets);
+
+// Maps the file and parses it with `thread_count` threads (0 picks one per usable CPU) into the
+// targets and handshakes of `job`. The targets are passed through `dedup`. In the unsalted modes of
+// `job->mode` every line is a digest, see `parse_digest`.
+void load(const char* path, u64 thread_count, Job* job, Stats* stats);
+
+} // namespace cpu::hashfile
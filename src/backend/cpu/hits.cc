@@ -0,0 +1,89 @@
+#include "src/backend/cpu/hits.hpp"
+#include "src/common.hpp"
+
+namespace cpu::hits {
+
+Queue::Queue(Callback on_hit)
+    : on_hit(std::move(on_hit)), published(0), pending(0), stopping(false) {
+    // The tail always points at a node that was reported already, initially a stub.
+    tail = new Node{.next = nullptr, .hit = {}};
+    head.store(tail);
+}
+
+Queue::~Queue() {
+    if (thread.joinable())
+        stop();
+
+    Hit hit;
+    while (pop(&hit)) {
+    }
+    delete tail;
+}
+
+void Queue::start() {
+    thread = std::thread(&Queue::run, this);
+}
+
+void Queue::push(const Hit& hit) {
+    Node* node = new Node{.next = nullptr, .hit = hit};
+
+    // Counted before the node is linked, such that the reporter can't take it off first and make
+    // `depth` wrap around.
+    pending.fetch_add(1, std::memory_order_relaxed);
+
+    // Until `prev` links to it the reporter sees the queue as shorter, but the bump of `published`
+    // that follows wakes it up again.
+    Node* prev = head.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+
+    published.fetch_add(1, std::memory_order_release);
+    published.notify_one();
+}
+
+bool Queue::pop(Hit* hit) {
+    Node* next = tail->next.load(std::memory_order_acquire);
+    if (!next)
+        return false;
+
+    *hit = next->hit;
+    delete tail;
+    tail = next;
+    return true;
+}
+
+std::vector<Hit> Queue::stop() {
+    stopping.store(true, std::memory_order_release);
+    published.fetch_add(1, std::memory_order_release);
+    published.notify_one();
+
+    // Without a thread the final round runs right here.
+    if (thread.joinable())
+        thread.join();
+    else
+        run();
+
+    return std::move(hits);
+}
+
+void Queue::run() {
+    while (true) {
+        u32 seen = published.load(std::memory_order_acquire);
+        bool last = stopping.load(std::memory_order_acquire);
+
+        Hit hit;
+        while (pop(&hit)) {
+            hits.push_back(hit);
+            if (on_hit)
+                on_hit(hit);
+            pending.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        // Every push finished before `stop`, so the last round drained them all.
+        if (last)
+            return;
+
+        published.wait(seen, std::memory_order_acquire);
+    }
+}
+
+} // namespace cpu::hits
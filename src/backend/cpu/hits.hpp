@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#include "src/common.hpp"
+#include "src/backend/cpu/cpu.hpp"
+#include "src/backend/cpu/telemetry.hpp"
+
+namespace cpu::hits {
+
+using Callback = std::function<void(const Hit&)>;
+
+// Intrusive multi-producer single-consumer queue (Vyukov's), the reporter owns every node that
+// isn't being pushed.
+struct Node {
+    std::atomic<Node*> next;
+    Hit hit;
+};
+
+// Hands hits from the workers to a reporter thread that does the slow parts, like syncing the
+// potfile or printing. Pushing is an exchange, a store and two increments, it never takes a lock
+// or waits on the reporter, so a hit never stalls a hashing thread.
+struct Queue {
+    explicit Queue(Callback on_hit);
+    ~Queue();
+
+    void start();
+
+    // Called by any worker.
+    void push(const Hit& hit);
+
+    // Reports everything pushed so far and stops the reporter thread, the workers must be joined.
+    // Returns every hit in the order they were reported.
+    std::vector<Hit> stop();
+
+    // Hits pushed but not reported yet.
+    u64 depth() const {
+        return pending.load(std::memory_order_relaxed);
+    }
+
+  private:
+    void run();
+    bool pop(Hit* hit);
+
+    Callback on_hit;
+
+    // Producers only touch `head`, `published` and `pending`, the reporter only `tail` and
+    // `pending`.
+    alignas(telemetry::CACHE_LINE_SIZE) std::atomic<Node*> head;
+    std::atomic<u32> published;
+    std::atomic<u64> pending;
+    std::atomic<bool> stopping;
+
+    alignas(telemetry::CACHE_LINE_SIZE) Node* tail;
+    std::vector<Hit> hits;
+    std::thread thread;
+};
+
+} // namespace cpu::hits
@@ -0,0 +1,1306 @@
+#include "src/backend/cpu/kernels.hpp"
+#include "src/backend/cpu/sha1.hpp"
+#include "src/common.hpp"
+
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// Vectors are only passed between inlined helpers, the ABI note about AVX arguments doesn't apply.
+// Helpers taking or returning vectors by value must stay `ALWAYS_INLINE` for that to hold, even
+// without optimizations, as the AVX2 clone of `simd_compress` passes them in different registers.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+
+namespace cpu::kernels {
+
+typedef u32 u32x8 __attribute__((vector_size(32)));
+
+const u32 SHA1_IV[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+const u32 MD5_IV[4] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476};
+const u32 SHA256_IV[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+alignas(16) const u32 SHA256_K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+// Bytes hashed before the second block in every HMAC, which is the key block.
+const u32 HMAC_PREFIX_BITS = 64 * 8;
+
+inline u32 load_be32(const u8* ptr) {
+    return ((u32)ptr[0] << 24) | ((u32)ptr[1] << 16) | ((u32)ptr[2] << 8) | (u32)ptr[3];
+}
+
+inline u32 load_le32(const u8* ptr) {
+    return ((u32)ptr[3] << 24) | ((u32)ptr[2] << 16) | ((u32)ptr[1] << 8) | (u32)ptr[0];
+}
+
+inline u32 bswap32(u32 x) {
+    return __builtin_bswap32(x);
+}
+
+// Uniform access to the lanes of scalars and vectors.
+template <typename V>
+struct Lanes;
+
+template <>
+struct Lanes<u32> {
+    static constexpr u64 COUNT = 1;
+
+    static u32 splat(u32 x) {
+        return x;
+    }
+    static u32 get(const u32& v, u64 lane) {
+        return v;
+    }
+    static void set(u32& v, u64 lane, u32 x) {
+        v = x;
+    }
+    static bool any_equal(const u32& v, u32 x) {
+        return v == x;
+    }
+};
+
+template <>
+struct Lanes<u32x8> {
+    static constexpr u64 COUNT = 8;
+
+    static ALWAYS_INLINE u32x8 splat(u32 x) {
+        return u32x8{} + x;
+    }
+    static ALWAYS_INLINE u32 get(const u32x8& v, u64 lane) {
+        return v[lane];
+    }
+    static ALWAYS_INLINE void set(u32x8& v, u64 lane, u32 x) {
+        v[lane] = x;
+    }
+    static ALWAYS_INLINE bool any_equal(const u32x8& v, u32 x) {
+        auto eq = v == splat(x);
+        bool any = false;
+        for (u64 lane = 0; lane < COUNT; lane++)
+            any |= eq[lane] != 0;
+        return any;
+    }
+};
+
+template <typename V>
+ALWAYS_INLINE V rotl(V x, u32 n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+// Plain SHA-1 compression, written once for scalars and vectors of lanes. With fewer `STEPS` the
+// working variables after the last one replace the state instead of being added to it.
+template <typename V, u32 STEPS = 80>
+ALWAYS_INLINE void sha1_rounds(V state[5], const V block[16]) {
+    using L = Lanes<V>;
+
+    V w[16];
+    for (u64 idx = 0; idx < 16; idx++)
+        w[idx] = block[idx];
+
+    V a = state[0];
+    V b = state[1];
+    V c = state[2];
+    V d = state[3];
+    V e = state[4];
+
+#define SHA1_STEP(t, f, k)                                                                \
+    do {                                                                                  \
+        if ((t) >= 16)                                                                    \
+            w[(t) & 15] = rotl<V>(                                                        \
+                w[((t) - 3) & 15] ^ w[((t) - 8) & 15] ^ w[((t) - 14) & 15] ^ w[(t) & 15], \
+                1);                                                                       \
+        V tmp = rotl<V>(a, 5) + (f) + e + L::splat(k) + w[(t) & 15];                      \
+        e = d;                                                                            \
+        d = c;                                                                            \
+        c = rotl<V>(b, 30);                                                               \
+        b = a;                                                                            \
+        a = tmp;                                                                          \
+    } while (0)
+
+#pragma GCC unroll 20
+    for (u32 t = 0; t < 20 && t < STEPS; t++)
+        SHA1_STEP(t, d ^ (b & (c ^ d)), 0x5a827999);
+#pragma GCC unroll 20
+    for (u32 t = 20; t < 40 && t < STEPS; t++)
+        SHA1_STEP(t, b ^ c ^ d, 0x6ed9eba1);
+#pragma GCC unroll 20
+    for (u32 t = 40; t < 60 && t < STEPS; t++)
+        SHA1_STEP(t, (b & c) | (d & (b | c)), 0x8f1bbcdc);
+#pragma GCC unroll 20
+    for (u32 t = 60; t < 80 && t < STEPS; t++)
+        SHA1_STEP(t, b ^ c ^ d, 0xca62c1d6);
+
+#undef SHA1_STEP
+
+    if constexpr (STEPS < 80) {
+        state[0] = a;
+        state[1] = b;
+        state[2] = c;
+        state[3] = d;
+        state[4] = e;
+        return;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+// Plain MD5 compression for the MICs of key descriptor version 1, blocks are little endian words.
+template <typename V>
+ALWAYS_INLINE void md5_rounds(V state[4], const V block[16]) {
+    using L = Lanes<V>;
+
+    static constexpr u32 K[64] = {
+        0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613,
+        0xfd469501, 0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193,
+        0xa679438e, 0x49b40821, 0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d,
+        0x02441453, 0xd8a1e681, 0xe7d3fbc8, 0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
+        0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a, 0xfffa3942, 0x8771f681, 0x6d9d6122,
+        0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70, 0x289b7ec6, 0xeaa127fa,
+        0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665, 0xf4292244,
+        0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+        0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb,
+        0xeb86d391,
+    };
+    static constexpr u32 S[4][4] = {
+        {7, 12, 17, 22},
+        {5, 9, 14, 20},
+        {4, 11, 16, 23},
+        {6, 10, 15, 21},
+    };
+
+    V a = state[0];
+    V b = state[1];
+    V c = state[2];
+    V d = state[3];
+
+#define MD5_STEP(t, f, g)                            \
+    do {                                             \
+        V tmp = a + (f) + L::splat(K[t]) + block[g]; \
+        a = d;                                       \
+        d = c;                                       \
+        c = b;                                       \
+        b = b + rotl<V>(tmp, S[(t) / 16][(t) & 3]);  \
+    } while (0)
+
+#pragma GCC unroll 16
+    for (u32 t = 0; t < 16; t++)
+        MD5_STEP(t, d ^ (b & (c ^ d)), t);
+#pragma GCC unroll 16
+    for (u32 t = 16; t < 32; t++)
+        MD5_STEP(t, c ^ (d & (b ^ c)), (5 * t + 1) & 15);
+#pragma GCC unroll 16
+    for (u32 t = 32; t < 48; t++)
+        MD5_STEP(t, b ^ c ^ d, (3 * t + 5) & 15);
+#pragma GCC unroll 16
+    for (u32 t = 48; t < 64; t++)
+        MD5_STEP(t, c ^ (b | ~d), (7 * t) & 15);
+
+#undef MD5_STEP
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+}
+
+// Plain MD4 compression for NTLM, blocks are little endian words.
+template <typename V>
+ALWAYS_INLINE void md4_rounds(V state[4], const V block[16]) {
+    using L = Lanes<V>;
+
+    static constexpr u32 S[3][4] = {
+        {3, 7, 11, 19},
+        {3, 5, 9, 13},
+        {3, 9, 11, 15},
+    };
+    static constexpr u32 ROUND2[16] = {0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15};
+    static constexpr u32 ROUND3[16] = {0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15};
+
+    V a = state[0];
+    V b = state[1];
+    V c = state[2];
+    V d = state[3];
+
+#define MD4_STEP(t, f, k, g)                      \
+    do {                                          \
+        V tmp = a + (f) + L::splat(k) + block[g]; \
+        a = d;                                    \
+        d = c;                                    \
+        c = b;                                    \
+        b = rotl<V>(tmp, S[(t) / 16][(t) & 3]);   \
+    } while (0)
+
+#pragma GCC unroll 16
+    for (u32 t = 0; t < 16; t++)
+        MD4_STEP(t, d ^ (b & (c ^ d)), 0, t);
+#pragma GCC unroll 16
+    for (u32 t = 16; t < 32; t++)
+        MD4_STEP(t, (b & c) | (d & (b | c)), 0x5a827999, ROUND2[t - 16]);
+#pragma GCC unroll 16
+    for (u32 t = 32; t < 48; t++)
+        MD4_STEP(t, b ^ c ^ d, 0x6ed9eba1, ROUND3[t - 32]);
+
+#undef MD4_STEP
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+}
+
+// Plain SHA-256 compression for the PMKIDs of the SHA-256 AKMs, blocks are big endian words.
+template <typename V>
+ALWAYS_INLINE void sha256_rounds(V state[8], const V block[16]) {
+    using L = Lanes<V>;
+
+    V w[16];
+    for (u64 idx = 0; idx < 16; idx++)
+        w[idx] = block[idx];
+
+    V a = state[0];
+    V b = state[1];
+    V c = state[2];
+    V d = state[3];
+    V e = state[4];
+    V f = state[5];
+    V g = state[6];
+    V h = state[7];
+
+#pragma GCC unroll 64
+    for (u32 t = 0; t < 64; t++) {
+        if (t >= 16) {
+            V w15 = w[(t - 15) & 15];
+            V w2 = w[(t - 2) & 15];
+            V s0 = rotl<V>(w15, 25) ^ rotl<V>(w15, 14) ^ (w15 >> 3);
+            V s1 = rotl<V>(w2, 15) ^ rotl<V>(w2, 13) ^ (w2 >> 10);
+            w[t & 15] += s0 + w[(t - 7) & 15] + s1;
+        }
+
+        V t1 = h + (rotl<V>(e, 26) ^ rotl<V>(e, 21) ^ rotl<V>(e, 7)) + (g ^ (e & (f ^ g))) +
+               L::splat(SHA256_K[t]) + w[t & 15];
+        V t2 = (rotl<V>(a, 30) ^ rotl<V>(a, 19) ^ rotl<V>(a, 10)) + ((a & b) | (c & (a | b)));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+// The last SHA-1 step whose `a` lands in the fourth digest word without passing through another
+// step: after step 79, `d` is `a` of step 76 rotated by 30. Kernels with `EARLY_REJECT` can stop
+// there to check a single target.
+const u32 EARLY_STEPS = 77;
+
+struct Sha1dc {
+    using V = u32;
+
+    static constexpr bool EARLY_REJECT = false;
+
+    static void compress(u32 state[5], const u32 block[16]) {
+        u32 raw[16];
+        for (u64 idx = 0; idx < 16; idx++)
+            raw[idx] = bswap32(block[idx]);
+
+        u32 expanded[80];
+        u32 states[80][5];
+        sha1_compression_states(state, raw, expanded, states);
+    }
+
+    static void sha256(u32 state[8], const u32 block[16]) {
+        sha256_rounds<u32>(state, block);
+    }
+};
+
+struct Scalar {
+    using V = u32;
+
+    static constexpr bool EARLY_REJECT = true;
+
+    static void compress(u32 state[5], const u32 block[16]) {
+        sha1_rounds<u32>(state, block);
+    }
+
+    static void compress_early(u32 state[5], const u32 block[16]) {
+        sha1_rounds<u32, EARLY_STEPS>(state, block);
+    }
+
+    static void sha256(u32 state[8], const u32 block[16]) {
+        sha256_rounds<u32>(state, block);
+    }
+};
+
+// MD5 and MD4 (below) have no dedicated instructions, so the kernels without lanes share these.
+inline void md5_compress(u32 state[4], const u32 block[16]) {
+    md5_rounds<u32>(state, block);
+}
+
+// Without AVX2 the 256-bit vectors get split into pairs of SSE operations, so on x86 we let the
+// dynamic loader pick an AVX2 build of the rounds when the CPU has it.
+#if defined(__x86_64__) && defined(__ELF__)
+__attribute__((target_clones("avx2", "default")))
+#endif
+void simd_compress(u32x8 state[5], const u32x8 block[16]) {
+    sha1_rounds<u32x8>(state, block);
+}
+
+#if defined(__x86_64__) && defined(__ELF__)
+__attribute__((target_clones("avx2", "default")))
+#endif
+void simd_compress_early(u32x8 state[5], const u32x8 block[16]) {
+    sha1_rounds<u32x8, EARLY_STEPS>(state, block);
+}
+
+#if defined(__x86_64__) && defined(__ELF__)
+__attribute__((target_clones("avx2", "default")))
+#endif
+void simd_md5_compress(u32x8 state[4], const u32x8 block[16]) {
+    md5_rounds<u32x8>(state, block);
+}
+
+inline void md5_compress(u32x8 state[4], const u32x8 block[16]) {
+    simd_md5_compress(state, block);
+}
+
+inline void md4_compress(u32 state[4], const u32 block[16]) {
+    md4_rounds<u32>(state, block);
+}
+
+#if defined(__x86_64__) && defined(__ELF__)
+__attribute__((target_clones("avx2", "default")))
+#endif
+void simd_md4_compress(u32x8 state[4], const u32x8 block[16]) {
+    md4_rounds<u32x8>(state, block);
+}
+
+inline void md4_compress(u32x8 state[4], const u32x8 block[16]) {
+    simd_md4_compress(state, block);
+}
+
+#if defined(__x86_64__) && defined(__ELF__)
+__attribute__((target_clones("avx2", "default")))
+#endif
+void simd_sha256_compress(u32x8 state[8], const u32x8 block[16]) {
+    sha256_rounds<u32x8>(state, block);
+}
+
+struct Simd {
+    using V = u32x8;
+
+    static constexpr bool EARLY_REJECT = true;
+
+    static void compress(u32x8 state[5], const u32x8 block[16]) {
+        simd_compress(state, block);
+    }
+
+    static void compress_early(u32x8 state[5], const u32x8 block[16]) {
+        simd_compress_early(state, block);
+    }
+
+    static void sha256(u32x8 state[8], const u32x8 block[16]) {
+        simd_sha256_compress(state, block);
+    }
+};
+
+#if defined(__x86_64__)
+
+#define SHANI_TARGET __attribute__((target("sha,sse4.1"), always_inline))
+
+// Four rounds of the SHA-NI pipeline, see the Intel SHA extensions whitepaper. `m` holds the
+// message schedule in a ring of four registers and `G` is the index of the 4-round group.
+template <int G>
+SHANI_TARGET inline void shani_group(__m128i& abcd, __m128i& e0, __m128i& e1, __m128i m[4]) {
+    __m128i& e_in = (G % 2 == 0) ? e0 : e1;
+    __m128i& e_out = (G % 2 == 0) ? e1 : e0;
+
+    __m128i& m0 = m[G % 4];
+    __m128i& m1 = m[(G + 1) % 4];
+    __m128i& m2 = m[(G + 2) % 4];
+    __m128i& m3 = m[(G + 3) % 4];
+
+    if constexpr (G == 0)
+        e_in = _mm_add_epi32(e_in, m0);
+    else
+        e_in = _mm_sha1nexte_epu32(e_in, m0);
+
+    e_out = abcd;
+
+    if constexpr (G >= 3 && G <= 18)
+        m1 = _mm_sha1msg2_epu32(m1, m0);
+
+    abcd = _mm_sha1rnds4_epu32(abcd, e_in, G / 5);
+
+    if constexpr (G >= 1 && G <= 16)
+        m3 = _mm_sha1msg1_epu32(m3, m0);
+
+    if constexpr (G >= 2 && G <= 17)
+        m2 = _mm_xor_si128(m2, m0);
+}
+
+struct ShaNi {
+    using V = u32;
+
+    // The last four steps are a single instruction.
+    static constexpr bool EARLY_REJECT = false;
+
+    __attribute__((target("sha,sse4.1"))) static void compress(
+        u32 state[5],
+        const u32 block[16]) {
+        __m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)state), 0x1b);
+        __m128i e0 = _mm_set_epi32(state[4], 0, 0, 0);
+        __m128i e1;
+
+        __m128i abcd_save = abcd;
+        __m128i e0_save = e0;
+
+        // The instructions expect the first word of each group in the highest lane.
+        __m128i m[4];
+        for (u64 idx = 0; idx < 4; idx++)
+            m[idx] = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&block[idx * 4]), 0x1b);
+
+        shani_group<0>(abcd, e0, e1, m);
+        shani_group<1>(abcd, e0, e1, m);
+        shani_group<2>(abcd, e0, e1, m);
+        shani_group<3>(abcd, e0, e1, m);
+        shani_group<4>(abcd, e0, e1, m);
+        shani_group<5>(abcd, e0, e1, m);
+        shani_group<6>(abcd, e0, e1, m);
+        shani_group<7>(abcd, e0, e1, m);
+        shani_group<8>(abcd, e0, e1, m);
+        shani_group<9>(abcd, e0, e1, m);
+        shani_group<10>(abcd, e0, e1, m);
+        shani_group<11>(abcd, e0, e1, m);
+        shani_group<12>(abcd, e0, e1, m);
+        shani_group<13>(abcd, e0, e1, m);
+        shani_group<14>(abcd, e0, e1, m);
+        shani_group<15>(abcd, e0, e1, m);
+        shani_group<16>(abcd, e0, e1, m);
+        shani_group<17>(abcd, e0, e1, m);
+        shani_group<18>(abcd, e0, e1, m);
+        shani_group<19>(abcd, e0, e1, m);
+
+        e0 = _mm_sha1nexte_epu32(e0, e0_save);
+        abcd = _mm_add_epi32(abcd, abcd_save);
+
+        _mm_storeu_si128((__m128i*)state, _mm_shuffle_epi32(abcd, 0x1b));
+        state[4] = _mm_extract_epi32(e0, 3);
+    }
+
+    // The SHA-256 instructions keep the state as ABEF and CDGH, and take two rounds at a time with
+    // the message words already added to the constants.
+    __attribute__((target("sha,sse4.1"))) static void sha256(
+        u32 state[8],
+        const u32 block[16]) {
+        __m128i dcba = _mm_loadu_si128((const __m128i*)&state[0]);
+        __m128i hgfe = _mm_loadu_si128((const __m128i*)&state[4]);
+        __m128i cdab = _mm_shuffle_epi32(dcba, 0xb1);
+        __m128i efgh = _mm_shuffle_epi32(hgfe, 0x1b);
+        __m128i abef = _mm_alignr_epi8(cdab, efgh, 8);
+        __m128i cdgh = _mm_blend_epi16(efgh, cdab, 0xf0);
+
+        __m128i abef_save = abef;
+        __m128i cdgh_save = cdgh;
+
+        __m128i w[16];
+#pragma GCC unroll 16
+        for (u64 idx = 0; idx < 16; idx++) {
+            if (idx < 4)
+                w[idx] = _mm_loadu_si128((const __m128i*)&block[idx * 4]);
+            else
+                w[idx] = _mm_sha256msg2_epu32(
+                    _mm_add_epi32(
+                        _mm_sha256msg1_epu32(w[idx - 4], w[idx - 3]),
+                        _mm_alignr_epi8(w[idx - 1], w[idx - 2], 4)),
+                    w[idx - 1]);
+
+            __m128i msg = _mm_add_epi32(w[idx], _mm_load_si128((const __m128i*)&SHA256_K[idx * 4]));
+            cdgh = _mm_sha256rnds2_epu32(cdgh, abef, msg);
+            abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(msg, 0x0e));
+        }
+
+        abef = _mm_add_epi32(abef, abef_save);
+        cdgh = _mm_add_epi32(cdgh, cdgh_save);
+
+        __m128i feba = _mm_shuffle_epi32(abef, 0x1b);
+        __m128i dchg = _mm_shuffle_epi32(cdgh, 0xb1);
+        _mm_storeu_si128((__m128i*)&state[0], _mm_blend_epi16(feba, dchg, 0xf0));
+        _mm_storeu_si128((__m128i*)&state[4], _mm_alignr_epi8(dchg, feba, 8));
+    }
+};
+
+#endif
+
+// Finishes a block whose first `words` words were already written, for a message of `bits` bits.
+template <typename V>
+inline void sha1_pad(V block[16], u64 words, u32 bits) {
+    using L = Lanes<V>;
+
+    block[words] = L::splat(0x80000000);
+    for (u64 idx = words + 1; idx < 15; idx++)
+        block[idx] = L::splat(0);
+    block[15] = L::splat(bits);
+}
+
+template <typename C>
+void hmac_init(
+    const typename C::V key[16],
+    u32 ipad,
+    u32 opad,
+    typename C::V istate[5],
+    typename C::V ostate[5]) {
+    using V = typename C::V;
+    using L = Lanes<V>;
+
+    V block[16];
+
+    for (u64 idx = 0; idx < 5; idx++)
+        istate[idx] = L::splat(SHA1_IV[idx]);
+    for (u64 idx = 0; idx < 16; idx++)
+        block[idx] = key[idx] ^ L::splat(ipad);
+    C::compress(istate, block);
+
+    for (u64 idx = 0; idx < 5; idx++)
+        ostate[idx] = L::splat(SHA1_IV[idx]);
+    for (u64 idx = 0; idx < 16; idx++)
+        block[idx] = key[idx] ^ L::splat(opad);
+    C::compress(ostate, block);
+}
+
+// HMAC-SHA1 of a 20 byte message, given the key's inner and outer midstates.
+template <typename C>
+inline void hmac_20(
+    const typename C::V istate[5],
+    const typename C::V ostate[5],
+    const typename C::V msg[5],
+    typename C::V out[5]) {
+    using V = typename C::V;
+
+    V block[16];
+    V inner[5];
+
+    for (u64 idx = 0; idx < 5; idx++) {
+        block[idx] = msg[idx];
+        inner[idx] = istate[idx];
+    }
+    sha1_pad<V>(block, 5, HMAC_PREFIX_BITS + 20 * 8);
+    C::compress(inner, block);
+
+    for (u64 idx = 0; idx < 5; idx++) {
+        block[idx] = inner[idx];
+        out[idx] = ostate[idx];
+    }
+    C::compress(out, block);
+}
+
+// Like `hmac_20`, for a single target whose fourth digest word is `word`. The outer compression
+// stops after `EARLY_STEPS` and only runs in full if a lane can still match, otherwise `out` only
+// holds the fourth word, which is enough for the lookup to reject every lane. The fifth word is
+// never needed, as only 128 bits of a PMKID are compared.
+template <typename C>
+inline void hmac_20_early(
+    const typename C::V istate[5],
+    const typename C::V ostate[5],
+    const typename C::V msg[5],
+    u32 word,
+    typename C::V out[5]) {
+    using V = typename C::V;
+    using L = Lanes<V>;
+
+    if constexpr (!C::EARLY_REJECT) {
+        hmac_20<C>(istate, ostate, msg, out);
+    } else {
+        V block[16];
+        V inner[5];
+
+        for (u64 idx = 0; idx < 5; idx++) {
+            block[idx] = msg[idx];
+            inner[idx] = istate[idx];
+        }
+        sha1_pad<V>(block, 5, HMAC_PREFIX_BITS + 20 * 8);
+        C::compress(inner, block);
+
+        for (u64 idx = 0; idx < 5; idx++) {
+            block[idx] = inner[idx];
+            out[idx] = ostate[idx];
+        }
+        C::compress_early(out, block);
+
+        V last = ostate[3] + rotl<V>(out[0], 30);
+        if (!L::any_equal(last, word)) {
+            out[3] = last;
+            return;
+        }
+
+        // A match, or one in 2^32 candidates per lane, the steps are just run again.
+        for (u64 idx = 0; idx < 5; idx++)
+            out[idx] = ostate[idx];
+        C::compress(out, block);
+    }
+}
+
+template <typename C>
+void load_keys(const u8 keys[][64], u64 count, typename C::V out[16]) {
+    using L = Lanes<typename C::V>;
+
+    for (u64 idx = 0; idx < 16; idx++)
+        for (u64 lane = 0; lane < L::COUNT; lane++)
+            L::set(out[idx], lane, lane < count ? load_be32(&keys[lane][idx * 4]) : 0);
+}
+
+template <typename C>
+void store_digests(const typename C::V digest[5], u64 count, u32 out[][5]) {
+    using L = Lanes<typename C::V>;
+
+    for (u64 lane = 0; lane < count; lane++)
+        for (u64 idx = 0; idx < 5; idx++)
+            out[lane][idx] = bswap32(L::get(digest[idx], lane));
+}
+
+template <typename C>
+void compress_lanes(u32 states[][5], const u32 blocks[][16], u64 count) {
+    using V = typename C::V;
+    using L = Lanes<V>;
+
+    V state[5], block[16];
+    for (u64 lane = 0; lane < L::COUNT; lane++) {
+        for (u64 idx = 0; idx < 5; idx++)
+            L::set(state[idx], lane, lane < count ? states[lane][idx] : 0);
+        for (u64 idx = 0; idx < 16; idx++)
+            L::set(block[idx], lane, lane < count ? blocks[lane][idx] : 0);
+    }
+
+    C::compress(state, block);
+
+    for (u64 lane = 0; lane < count; lane++)
+        for (u64 idx = 0; idx < 5; idx++)
+            states[lane][idx] = L::get(state[idx], lane);
+}
+
+template <typename C>
+void pmkid_lanes(
+    const u8 keys[][64],
+    u64 count,
+    const u8 msg[20],
+    const u32* reject,
+    u32 out[][5]) {
+    using V = typename C::V;
+    using L = Lanes<V>;
+
+    V key[16];
+    load_keys<C>(keys, count, key);
+
+    // `cpu::hash::hmac_sha1_128_init` additionally mixes the byte offset into the pads.
+    for (u64 idx = 0; idx < 16; idx++) {
+        u32 offset = ((idx * 4) << 24) | ((idx * 4 + 1) << 16) | ((idx * 4 + 2) << 8) | (idx * 4 + 3);
+        key[idx] ^= L::splat(offset);
+    }
+
+    V istate[5], ostate[5];
+    hmac_init<C>(key, 0x36363636, 0x5c5c5c5c, istate, ostate);
+
+    V words[5];
+    for (u64 idx = 0; idx < 5; idx++)
+        words[idx] = L::splat(load_be32(&msg[idx * 4]));
+
+    V digest[5];
+    if (reject)
+        hmac_20_early<C>(istate, ostate, words, bswap32(*reject), digest);
+    else
+        hmac_20<C>(istate, ostate, words, digest);
+    store_digests<C>(digest, count, out);
+}
+
+template <typename C>
+void wpa_pmk_lanes(
+    const u8 passphrases[][64],
+    u64 count,
+    const u8* essid,
+    u64 essid_len,
+    u32 out[][8]) {
+    using V = typename C::V;
+    using L = Lanes<V>;
+
+    V key[16];
+    load_keys<C>(passphrases, count, key);
+
+    V istate[5], ostate[5];
+    hmac_init<C>(key, 0x36363636, 0x5c5c5c5c, istate, ostate);
+
+    // The PMK is the first 32 bytes of two PBKDF2 blocks.
+    for (u32 block_idx = 1; block_idx <= 2; block_idx++) {
+        // U_1 = HMAC(passphrase, essid || INT(block_idx)), which fits in a single block as the
+        // ESSID is at most 32 bytes.
+        u8 salt[64] = {0};
+        memcpy(salt, essid, essid_len);
+        salt[essid_len + 3] = block_idx;
+        salt[essid_len + 4] = 0x80;
+
+        V block[16];
+        for (u64 idx = 0; idx < 16; idx++)
+            block[idx] = L::splat(load_be32(&salt[idx * 4]));
+        block[15] = L::splat(HMAC_PREFIX_BITS + (essid_len + 4) * 8);
+
+        V u[5];
+        for (u64 idx = 0; idx < 5; idx++)
+            u[idx] = istate[idx];
+        C::compress(u, block);
+
+        for (u64 idx = 0; idx < 5; idx++)
+            block[idx] = u[idx];
+        sha1_pad<V>(block, 5, HMAC_PREFIX_BITS + 20 * 8);
+        for (u64 idx = 0; idx < 5; idx++)
+            u[idx] = ostate[idx];
+        C::compress(u, block);
+
+        V acc[5];
+        for (u64 idx = 0; idx < 5; idx++)
+            acc[idx] = u[idx];
+
+        // U_n = HMAC(passphrase, U_n-1), the padding of `block` stays the same throughout.
+        for (u32 iter = 1; iter < 4096; iter++) {
+            for (u64 idx = 0; idx < 5; idx++) {
+                block[idx] = u[idx];
+                u[idx] = istate[idx];
+            }
+            C::compress(u, block);
+
+            for (u64 idx = 0; idx < 5; idx++) {
+                block[idx] = u[idx];
+                u[idx] = ostate[idx];
+            }
+            C::compress(u, block);
+
+            for (u64 idx = 0; idx < 5; idx++)
+                acc[idx] ^= u[idx];
+        }
+
+        u64 offset = (block_idx - 1) * 5;
+        for (u64 lane = 0; lane < count; lane++)
+            for (u64 idx = 0; idx < 5 && offset + idx < 8; idx++)
+                out[lane][offset + idx] = L::get(acc[idx], lane);
+    }
+}
+
+template <typename C>
+void wpa_pmkid_lanes(
+    const u32 pmks[][8],
+    u64 count,
+    const u8 msg[20],
+    const u32* reject,
+    u32 out[][5]) {
+    using V = typename C::V;
+    using L = Lanes<V>;
+
+    V key[16];
+    for (u64 idx = 0; idx < 16; idx++)
+        for (u64 lane = 0; lane < L::COUNT; lane++)
+            L::set(key[idx], lane, lane < count && idx < 8 ? pmks[lane][idx] : 0);
+
+    V istate[5], ostate[5];
+    hmac_init<C>(key, 0x36363636, 0x5c5c5c5c, istate, ostate);
+
+    V words[5];
+    for (u64 idx = 0; idx < 5; idx++)
+        words[idx] = L::splat(load_be32(&msg[idx * 4]));
+
+    V digest[5];
+    if (reject)
+        hmac_20_early<C>(istate, ostate, words, bswap32(*reject), digest);
+    else
+        hmac_20<C>(istate, ostate, words, digest);
+    store_digests<C>(digest, count, out);
+}
+
+template <typename C>
+void wpa_pmkid_sha256_lanes(const u32 pmks[][8], u64 count, const u8 msg[20], u32 out[][5]) {
+    using V = typename C::V;
+    using L = Lanes<V>;
+
+    V block[16];
+    V istate[8], ostate[8];
+    for (u64 idx = 0; idx < 8; idx++) {
+        istate[idx] = L::splat(SHA256_IV[idx]);
+        ostate[idx] = L::splat(SHA256_IV[idx]);
+    }
+
+    for (u64 idx = 0; idx < 16; idx++)
+        for (u64 lane = 0; lane < L::COUNT; lane++)
+            L::set(block[idx], lane, (lane < count && idx < 8 ? pmks[lane][idx] : 0) ^ 0x36363636);
+    C::sha256(istate, block);
+
+    for (u64 idx = 0; idx < 16; idx++)
+        block[idx] ^= L::splat(0x36363636 ^ 0x5c5c5c5c);
+    C::sha256(ostate, block);
+
+    // SHA-256 pads the same way as SHA-1.
+    for (u64 idx = 0; idx < 5; idx++)
+        block[idx] = L::splat(load_be32(&msg[idx * 4]));
+    sha1_pad<V>(block, 5, HMAC_PREFIX_BITS + 20 * 8);
+    C::sha256(istate, block);
+
+    for (u64 idx = 0; idx < 8; idx++)
+        block[idx] = istate[idx];
+    sha1_pad<V>(block, 8, HMAC_PREFIX_BITS + 32 * 8);
+    C::sha256(ostate, block);
+
+    // Truncated to 128 bits like the SHA-1 PMKID.
+    for (u64 lane = 0; lane < count; lane++) {
+        for (u64 idx = 0; idx < 4; idx++)
+            out[lane][idx] = bswap32(L::get(ostate[idx], lane));
+        out[lane][4] = 0;
+    }
+}
+
+template <typename C>
+void eapol_mic_lanes(const u32 pmks[][8], u64 count, const Eapol& eapol, u32 out[][5]) {
+    using V = typename C::V;
+    using L = Lanes<V>;
+
+    V key[16];
+    for (u64 idx = 0; idx < 16; idx++)
+        for (u64 lane = 0; lane < L::COUNT; lane++)
+            L::set(key[idx], lane, lane < count && idx < 8 ? pmks[lane][idx] : 0);
+
+    V istate[5], ostate[5];
+    hmac_init<C>(key, 0x36363636, 0x5c5c5c5c, istate, ostate);
+
+    // The KCK is the first 128 bits of the first PRF-512 block, the rest of the PTK isn't needed.
+    V block[16];
+    V inner[5];
+    for (u64 idx = 0; idx < 5; idx++)
+        inner[idx] = istate[idx];
+    for (u64 prf_idx = 0; prf_idx < 2; prf_idx++) {
+        for (u64 idx = 0; idx < 16; idx++)
+            block[idx] = L::splat(eapol.prf_blocks[prf_idx][idx]);
+        C::compress(inner, block);
+    }
+
+    V kck[5];
+    for (u64 idx = 0; idx < 5; idx++) {
+        block[idx] = inner[idx];
+        kck[idx] = ostate[idx];
+    }
+    sha1_pad<V>(block, 5, HMAC_PREFIX_BITS + 20 * 8);
+    C::compress(kck, block);
+
+    for (u64 idx = 0; idx < 16; idx++)
+        key[idx] = idx < 4 ? kck[idx] : L::splat(0);
+
+    if (eapol.key_version == 2) {
+        hmac_init<C>(key, 0x36363636, 0x5c5c5c5c, istate, ostate);
+
+        for (u64 idx = 0; idx < 5; idx++)
+            inner[idx] = istate[idx];
+        for (u64 block_idx = 0; block_idx < eapol.mic_block_count; block_idx++) {
+            for (u64 idx = 0; idx < 16; idx++)
+                block[idx] = L::splat(eapol.mic_blocks[block_idx][idx]);
+            C::compress(inner, block);
+        }
+
+        V mic[5];
+        for (u64 idx = 0; idx < 5; idx++) {
+            block[idx] = inner[idx];
+            mic[idx] = ostate[idx];
+        }
+        sha1_pad<V>(block, 5, HMAC_PREFIX_BITS + 20 * 8);
+        C::compress(mic, block);
+
+        store_digests<C>(mic, count, out);
+    } else {
+        // MD5 reads the key bytes as little endian words.
+        for (u64 idx = 0; idx < 4; idx++)
+            for (u64 lane = 0; lane < L::COUNT; lane++)
+                L::set(key[idx], lane, bswap32(L::get(key[idx], lane)));
+
+        V md5_istate[4], md5_ostate[4];
+        for (u64 idx = 0; idx < 4; idx++) {
+            md5_istate[idx] = L::splat(MD5_IV[idx]);
+            md5_ostate[idx] = L::splat(MD5_IV[idx]);
+        }
+        for (u64 idx = 0; idx < 16; idx++)
+            block[idx] = key[idx] ^ L::splat(0x36363636);
+        md5_compress(md5_istate, block);
+        for (u64 idx = 0; idx < 16; idx++)
+            block[idx] = key[idx] ^ L::splat(0x5c5c5c5c);
+        md5_compress(md5_ostate, block);
+
+        for (u64 block_idx = 0; block_idx < eapol.mic_block_count; block_idx++) {
+            for (u64 idx = 0; idx < 16; idx++)
+                block[idx] = L::splat(eapol.mic_blocks[block_idx][idx]);
+            md5_compress(md5_istate, block);
+        }
+
+        for (u64 idx = 0; idx < 16; idx++)
+            block[idx] = idx < 4 ? md5_istate[idx] : L::splat(0);
+        block[4] = L::splat(0x80);
+        block[14] = L::splat(HMAC_PREFIX_BITS + 16 * 8);
+        md5_compress(md5_ostate, block);
+
+        // MD5 digests are little endian already.
+        for (u64 lane = 0; lane < count; lane++) {
+            for (u64 idx = 0; idx < 4; idx++)
+                out[lane][idx] = L::get(md5_ostate[idx], lane);
+            out[lane][4] = 0;
+        }
+    }
+}
+
+// Pads each lane's candidate into a single block, `BigEndian` for SHA-1 and little endian words
+// for MD4/MD5. `Utf16` widens every byte to a UTF-16LE code unit first, as NTLM does. Candidates
+// are cut at the first zero byte and at `MAX_RAW_LEN` bytes (or code units).
+template <typename C, bool BigEndian, bool Utf16>
+void load_messages(const u8 keys[][64], u64 count, typename C::V block[16]) {
+    using L = Lanes<typename C::V>;
+
+    for (u64 lane = 0; lane < L::COUNT; lane++) {
+        u8 bytes[64] = {0};
+        u64 len = 0;
+        if (lane < count) {
+            const u8* key = keys[lane];
+            len = strnlen(reinterpret_cast<const char*>(key), 64);
+            if constexpr (Utf16) {
+                len = len < MAX_RAW_LEN / 2 ? len : MAX_RAW_LEN / 2;
+                for (u64 idx = 0; idx < len; idx++)
+                    bytes[idx * 2] = key[idx];
+                len *= 2;
+            } else {
+                len = len < MAX_RAW_LEN ? len : MAX_RAW_LEN;
+                memcpy(bytes, key, len);
+            }
+            bytes[len] = 0x80;
+        }
+
+        for (u64 idx = 0; idx < 14; idx++) {
+            const u8* word = &bytes[idx * 4];
+            L::set(block[idx], lane, BigEndian ? load_be32(word) : load_le32(word));
+        }
+        L::set(block[14], lane, BigEndian ? 0 : len * 8);
+        L::set(block[15], lane, BigEndian ? len * 8 : 0);
+    }
+}
+
+template <typename C>
+void raw_sha1_lanes(const u8 keys[][64], u64 count, u32 out[][5]) {
+    using V = typename C::V;
+    using L = Lanes<V>;
+
+    V state[5], block[16];
+    for (u64 idx = 0; idx < 5; idx++)
+        state[idx] = L::splat(SHA1_IV[idx]);
+
+    load_messages<C, true, false>(keys, count, block);
+    C::compress(state, block);
+    store_digests<C>(state, count, out);
+}
+
+// MD5 when `Ntlm` is false, otherwise MD4 of the UTF-16LE candidate. Both digests are little
+// endian words already, the fifth word is zeroed.
+template <typename C, bool Ntlm>
+void raw_md_lanes(const u8 keys[][64], u64 count, u32 out[][5]) {
+    using V = typename C::V;
+    using L = Lanes<V>;
+
+    V state[4], block[16];
+    for (u64 idx = 0; idx < 4; idx++)
+        state[idx] = L::splat(MD5_IV[idx]);
+
+    load_messages<C, false, Ntlm>(keys, count, block);
+    if constexpr (Ntlm)
+        md4_compress(state, block);
+    else
+        md5_compress(state, block);
+
+    for (u64 lane = 0; lane < count; lane++) {
+        for (u64 idx = 0; idx < 4; idx++)
+            out[lane][idx] = L::get(state[idx], lane);
+        out[lane][4] = 0;
+    }
+}
+
+// Splits `count` candidates into calls that fit the lanes of the kernel.
+template <typename C, typename F>
+inline void for_each_chunk(u64 count, F f) {
+    constexpr u64 width = Lanes<typename C::V>::COUNT;
+
+    for (u64 offset = 0; offset < count; offset += width)
+        f(offset, count - offset < width ? count - offset : width);
+}
+
+template <typename F>
+void dispatch(Kernel kernel, F f) {
+    switch (kernel) {
+        case Kernel::Sha1dc:
+            f(Sha1dc{});
+            return;
+        case Kernel::Scalar:
+            f(Scalar{});
+            return;
+        case Kernel::Simd:
+            f(Simd{});
+            return;
+        case Kernel::ShaNi:
+#if defined(__x86_64__)
+            if (available(Kernel::ShaNi)) {
+                f(ShaNi{});
+                return;
+            }
+#endif
+            break;
+    }
+
+    error("kernel '%s' is not supported on this cpu\n", name(kernel));
+}
+
+bool available(Kernel kernel) {
+    switch (kernel) {
+        case Kernel::Sha1dc:
+        case Kernel::Scalar:
+        case Kernel::Simd:
+            return true;
+        case Kernel::ShaNi:
+#if defined(__x86_64__)
+            return __builtin_cpu_supports("sha");
+#else
+            return false;
+#endif
+    }
+
+    return false;
+}
+
+const char* name(Kernel kernel) {
+    switch (kernel) {
+        case Kernel::Sha1dc:
+            return "sha1dc";
+        case Kernel::Scalar:
+            return "scalar";
+        case Kernel::Simd:
+            return "simd";
+        case Kernel::ShaNi:
+            return "sha-ni";
+    }
+
+    return "unknown";
+}
+
+bool parse(const char* str, Kernel* out) {
+    for (Kernel kernel : ALL) {
+        if (strcmp(str, name(kernel)) == 0) {
+            *out = kernel;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+Kernel best() {
+    // SHA-NI only beats eight lanes of AVX2 on cores with a fast SHA unit, `--benchmark` shows
+    // which one wins on a given machine.
+    return Kernel::Simd;
+}
+
+u64 lanes(Kernel kernel) {
+    return kernel == Kernel::Simd ? Lanes<u32x8>::COUNT : 1;
+}
+
+void compress(Kernel kernel, u32 states[][5], const u32 blocks[][16], u64 count) {
+    dispatch(kernel, [&](auto c) {
+        using C = decltype(c);
+        for_each_chunk<C>(count, [&](u64 offset, u64 n) {
+            compress_lanes<C>(&states[offset], &blocks[offset], n);
+        });
+    });
+}
+
+void pmkid(
+    Kernel kernel,
+    const u8 keys[][64],
+    u64 count,
+    const u8 msg[20],
+    u32 out[][5],
+    const u32* reject) {
+    dispatch(kernel, [&](auto c) {
+        using C = decltype(c);
+        for_each_chunk<C>(count, [&](u64 offset, u64 n) {
+            pmkid_lanes<C>(&keys[offset], n, msg, reject, &out[offset]);
+        });
+    });
+}
+
+void wpa_pmk(
+    Kernel kernel,
+    const u8 passphrases[][64],
+    u64 count,
+    const u8* essid,
+    u64 essid_len,
+    u32 out[][8]) {
+    if (essid_len > 32)
+        error("essid is longer than 32 bytes\n");
+
+    dispatch(kernel, [&](auto c) {
+        using C = decltype(c);
+        for_each_chunk<C>(count, [&](u64 offset, u64 n) {
+            wpa_pmk_lanes<C>(&passphrases[offset], n, essid, essid_len, &out[offset]);
+        });
+    });
+}
+
+void wpa_pmkid(
+    Kernel kernel,
+    const u32 pmks[][8],
+    u64 count,
+    const u8 msg[20],
+    u32 out[][5],
+    const u32* reject) {
+    dispatch(kernel, [&](auto c) {
+        using C = decltype(c);
+        for_each_chunk<C>(count, [&](u64 offset, u64 n) {
+            wpa_pmkid_lanes<C>(&pmks[offset], n, msg, reject, &out[offset]);
+        });
+    });
+}
+
+void wpa_pmkid_sha256(
+    Kernel kernel,
+    const u32 pmks[][8],
+    u64 count,
+    const u8 msg[20],
+    u32 out[][5]) {
+    dispatch(kernel, [&](auto c) {
+        using C = decltype(c);
+        for_each_chunk<C>(count, [&](u64 offset, u64 n) {
+            wpa_pmkid_sha256_lanes<C>(&pmks[offset], n, msg, &out[offset]);
+        });
+    });
+}
+
+void raw_sha1(Kernel kernel, const u8 keys[][64], u64 count, u32 out[][5]) {
+    dispatch(kernel, [&](auto c) {
+        using C = decltype(c);
+        for_each_chunk<C>(count, [&](u64 offset, u64 n) {
+            raw_sha1_lanes<C>(&keys[offset], n, &out[offset]);
+        });
+    });
+}
+
+void raw_md5(Kernel kernel, const u8 keys[][64], u64 count, u32 out[][5]) {
+    dispatch(kernel, [&](auto c) {
+        using C = decltype(c);
+        for_each_chunk<C>(count, [&](u64 offset, u64 n) {
+            raw_md_lanes<C, false>(&keys[offset], n, &out[offset]);
+        });
+    });
+}
+
+void ntlm(Kernel kernel, const u8 keys[][64], u64 count, u32 out[][5]) {
+    dispatch(kernel, [&](auto c) {
+        using C = decltype(c);
+        for_each_chunk<C>(count, [&](u64 offset, u64 n) {
+            raw_md_lanes<C, true>(&keys[offset], n, &out[offset]);
+        });
+    });
+}
+
+void eapol_init(
+    Eapol* out,
+    const u8 mac_ap[6],
+    const u8 mac_sta[6],
+    const u8 anonce[32],
+    const u8 snonce[32],
+    u32 key_version,
+    const u8* eapol,
+    u64 eapol_len) {
+    if (key_version != 1 && key_version != 2)
+        error("unsupported key descriptor version %d\n", key_version);
+    if (eapol_len > MAX_EAPOL_LEN || eapol_len < 99)
+        error("invalid EAPOL frame length %lld\n", eapol_len);
+
+    *out = Eapol{};
+    out->key_version = key_version;
+
+    // "Pairwise key expansion" 0x00 || min(AA, SPA) || max(AA, SPA) || min(ANonce, SNonce) ||
+    // max(ANonce, SNonce) || 0x00, padded for the inner hash of the HMAC.
+    u8 prf[128] = {0};
+    memcpy(prf, "Pairwise key expansion", 22);
+    bool ap_first = memcmp(mac_ap, mac_sta, 6) < 0;
+    memcpy(prf + 23, ap_first ? mac_ap : mac_sta, 6);
+    memcpy(prf + 29, ap_first ? mac_sta : mac_ap, 6);
+    bool anonce_first = memcmp(anonce, snonce, 32) < 0;
+    memcpy(prf + 35, anonce_first ? anonce : snonce, 32);
+    memcpy(prf + 67, anonce_first ? snonce : anonce, 32);
+    prf[100] = 0x80;
+
+    for (u64 block = 0; block < 2; block++)
+        for (u64 idx = 0; idx < 16; idx++)
+            out->prf_blocks[block][idx] = load_be32(&prf[block * 64 + idx * 4]);
+    out->prf_blocks[1][15] = HMAC_PREFIX_BITS + 100 * 8;
+
+    // The frame is MACed with its MIC field zeroed, followed by the padding of the inner hash.
+    u8 msg[sizeof(out->mic_blocks)] = {0};
+    memcpy(msg, eapol, eapol_len);
+    memset(msg + 81, 0, 16);
+    msg[eapol_len] = 0x80;
+
+    out->mic_block_count = (eapol_len + 9 + 63) / 64;
+    u64 bits = HMAC_PREFIX_BITS + eapol_len * 8;
+
+    for (u64 block = 0; block < out->mic_block_count; block++) {
+        for (u64 idx = 0; idx < 16; idx++) {
+            const u8* word = &msg[block * 64 + idx * 4];
+            out->mic_blocks[block][idx] = key_version == 2 ? load_be32(word) : load_le32(word);
+        }
+    }
+
+    // SHA-1 ends in the big endian bit count, MD5 in the little endian one.
+    u32* last = out->mic_blocks[out->mic_block_count - 1];
+    if (key_version == 2) {
+        last[14] = bits >> 32;
+        last[15] = bits;
+    } else {
+        last[14] = bits;
+        last[15] = bits >> 32;
+    }
+}
+
+void eapol_mic(Kernel kernel, const u32 pmks[][8], u64 count, const Eapol& eapol, u32 out[][5]) {
+    dispatch(kernel, [&](auto c) {
+        using C = decltype(c);
+        for_each_chunk<C>(count, [&](u64 offset, u64 n) {
+            eapol_mic_lanes<C>(&pmks[offset], n, eapol, &out[offset]);
+        });
+    });
+}
+
+} // namespace cpu::kernels
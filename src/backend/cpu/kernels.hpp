@@ -0,0 +1,122 @@
+#pragma once
+
+#include "src/common.hpp"
+
+namespace cpu::kernels {
+
+enum class Kernel {
+    // The SHA-1 implementation from sha1.cc, which keeps the intermediate states around.
+    Sha1dc,
+    // Plain SHA-1, one candidate at a time.
+    Scalar,
+    // Multi-buffer SHA-1, hashing MAX_LANES candidates in the lanes of a vector.
+    Simd,
+    // x86 SHA extensions, for SHA-1 and SHA-256.
+    ShaNi,
+};
+
+const Kernel ALL[] = {Kernel::Sha1dc, Kernel::Scalar, Kernel::Simd, Kernel::ShaNi};
+
+// Most candidates any kernel hashes per call.
+constexpr u64 MAX_LANES = 8;
+
+bool available(Kernel kernel);
+const char* name(Kernel kernel);
+bool parse(const char* str, Kernel* out);
+
+// Kernel that is fastest on most CPUs.
+Kernel best();
+
+// How many candidates a call needs to fill up every lane of the kernel.
+u64 lanes(Kernel kernel);
+
+// A single SHA-1 compression of `count` independent states, for measuring the kernels in
+// isolation. Blocks are the big endian words of the message.
+void compress(Kernel kernel, u32 states[][5], const u32 blocks[][16], u64 count);
+
+// Each of the functions below processes up to MAX_LANES candidates. Candidates are zero padded to
+// 64 bytes and digests have the byte order of `cpu::hash::pmkid`.
+
+// Same as `cpu::hash::pmkid`, the candidate is used as the PMK directly.
+//
+// `reject` is the fourth word of a single target's PMKID, in the byte order of the digests. With
+// it the scalar and SIMD kernels stop the last compression three steps short for candidates that
+// can't match, whose digests are then only exact in that word.
+void pmkid(
+    Kernel kernel,
+    const u8 keys[][64],
+    u64 count,
+    const u8 msg[20],
+    u32 out[][5],
+    const u32* reject = nullptr);
+
+// WPA PMK derivation, PBKDF2-HMAC-SHA1 with the ESSID as salt and 4096 iterations. The 32 byte
+// PMK is returned as big endian words.
+void wpa_pmk(
+    Kernel kernel,
+    const u8 passphrases[][64],
+    u64 count,
+    const u8* essid,
+    u64 essid_len,
+    u32 out[][8]);
+
+// HMAC-SHA1 PMKID of a PMK returned by `wpa_pmk`, `reject` is the same as for `pmkid`.
+void wpa_pmkid(
+    Kernel kernel,
+    const u32 pmks[][8],
+    u64 count,
+    const u8 msg[20],
+    u32 out[][5],
+    const u32* reject = nullptr);
+
+// HMAC-SHA256 PMKID of the SHA-256 AKMs (00-0F-AC:5 and 6), truncated to 128 bits like the SHA-1
+// one. The SHA-1 kernels without lanes use plain SHA-256 rounds, SHA-NI its SHA-256 instructions.
+void wpa_pmkid_sha256(
+    Kernel kernel,
+    const u32 pmks[][8],
+    u64 count,
+    const u8 msg[20],
+    u32 out[][5]);
+
+// Longest message of the unsalted hashes below, which fits a single block with its padding. NTLM
+// candidates are limited to half as many characters.
+constexpr u64 MAX_RAW_LEN = 55;
+
+// Unsalted hashes of the candidate itself, up to its first zero byte. SHA-1 digests fill all five
+// words, MD5 and NTLM (MD4 of the UTF-16LE candidate) leave the last one zero.
+void raw_sha1(Kernel kernel, const u8 keys[][64], u64 count, u32 out[][5]);
+void raw_md5(Kernel kernel, const u8 keys[][64], u64 count, u32 out[][5]);
+void ntlm(Kernel kernel, const u8 keys[][64], u64 count, u32 out[][5]);
+
+// Longest EAPOL-Key frame whose MIC can be checked.
+constexpr u64 MAX_EAPOL_LEN = 256;
+
+// The parts of a 4-way handshake that don't depend on the PMK, as ready to hash blocks.
+struct Eapol {
+    // Key descriptor version, 1 for HMAC-MD5 and 2 for HMAC-SHA1 MICs.
+    u32 key_version;
+
+    // "Pairwise key expansion", the sorted MACs and nonces, and the PRF counter.
+    u32 prf_blocks[2][16];
+
+    // The frame with its MIC zeroed, as SHA-1 or MD5 words depending on the key version.
+    u64 mic_block_count;
+    u32 mic_blocks[(MAX_EAPOL_LEN + 9 + 63) / 64][16];
+};
+
+// `eapol` is the EAPOL-Key frame of message 2, including the 4 byte EAPOL header.
+void eapol_init(
+    Eapol* out,
+    const u8 mac_ap[6],
+    const u8 mac_sta[6],
+    const u8 anonce[32],
+    const u8 snonce[32],
+    u32 key_version,
+    const u8* eapol,
+    u64 eapol_len);
+
+// MIC of a PMK returned by `wpa_pmk`: the KCK is derived with PRF-512 and the MIC is its HMAC-SHA1
+// or HMAC-MD5 of the frame. Only the first 128 bits of `out` are the MIC.
+void eapol_mic(Kernel kernel, const u32 pmks[][8], u64 count, const Eapol& eapol, u32 out[][5]);
+
+} // namespace cpu::kernels
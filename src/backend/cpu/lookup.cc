@@ -0,0 +1,15 @@
+#include "src/backend/cpu/lookup.hpp"
+#include "src/common.hpp"
+
+#include <algorithm>
+
+namespace cpu::lookup {
+
+void sort(Digest* digests, u64 count) {
+    // Stable, such that duplicates are reported for the target that came first.
+    std::stable_sort(digests, digests + count, [](const Digest& a, const Digest& b) {
+        return compare(a.hash, b.hash) < 0;
+    });
+}
+
+} // namespace cpu::lookup
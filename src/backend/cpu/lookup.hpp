@@ -0,0 +1,58 @@
+#pragma once
+
+#include "src/common.hpp"
+
+namespace cpu::lookup {
+
+// PMKIDs are HMACs truncated to 128 bits, so that's all that gets compared.
+constexpr u64 DIGEST_WORDS = 4;
+
+struct Digest {
+    u32 hash[DIGEST_WORDS];
+
+    // Index of the target in the job.
+    u64 target_idx;
+};
+
+// Below this many digests a linear scan beats the branches of the binary search.
+constexpr u64 LINEAR_SCAN_LIMIT = 8;
+
+inline i64 compare(const u32 a[DIGEST_WORDS], const u32 b[DIGEST_WORDS]) {
+    for (u64 idx = 0; idx < DIGEST_WORDS; idx++)
+        if (a[idx] != b[idx])
+            return a[idx] < b[idx] ? -1 : 1;
+
+    return 0;
+}
+
+// Orders digests such that `find` can search them.
+void sort(Digest* digests, u64 count);
+
+// Returns the first digest equal to `hash`, or nullptr if there is none.
+inline const Digest* find(const Digest* digests, u64 count, const u32 hash[DIGEST_WORDS]) {
+    if (count <= LINEAR_SCAN_LIMIT) {
+        for (u64 idx = 0; idx < count; idx++)
+            if (compare(digests[idx].hash, hash) == 0)
+                return &digests[idx];
+
+        return nullptr;
+    }
+
+    // Lower bound, nearly every probe is decided by the first word.
+    u64 lo = 0;
+    u64 hi = count;
+    while (lo < hi) {
+        u64 mid = lo + (hi - lo) / 2;
+        if (compare(digests[mid].hash, hash) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo < count && compare(digests[lo].hash, hash) == 0)
+        return &digests[lo];
+
+    return nullptr;
+}
+
+} // namespace cpu::lookup
@@ -0,0 +1,184 @@
+#include "src/backend/cpu/metrics.hpp"
+#include "src/backend/cpu/hash.hpp"
+#include "src/common.hpp"
+
+#include <cstdio>
+#include <ctime>
+
+namespace cpu::metrics {
+
+Exporter::Exporter(
+    const char* json_path,
+    const char* prometheus_path,
+    f64 interval,
+    const char* mode,
+    const char* kernel)
+    : prometheus_path(prometheus_path), interval(interval), last_elapsed(0.0), mode(mode),
+      kernel(kernel) {
+    if (json_path) {
+        json_file = fopen(json_path, "a");
+        if (!json_file)
+            error("failed to open metrics file '%s'\n", json_path);
+    }
+
+    labels = std::string("mode=\"") + mode + "\",kernel=\"" + kernel + "\"";
+}
+
+Exporter::~Exporter() {
+    if (json_file)
+        fclose(json_file);
+}
+
+void Exporter::sample(const telemetry::Snapshot& snapshot, const Progress& progress) {
+    if (written && !progress.finished && snapshot.elapsed - last_elapsed < interval)
+        return;
+
+    written = true;
+    last_elapsed = snapshot.elapsed;
+
+    if (json_file)
+        write_json(snapshot, progress);
+    if (prometheus_path)
+        write_prometheus(snapshot, progress);
+}
+
+u128 remaining(const telemetry::Snapshot& snapshot, const Progress& progress) {
+    if (snapshot.total_hashes >= progress.keyspace)
+        return 0;
+    return progress.keyspace - snapshot.total_hashes;
+}
+
+// Seconds the remaining candidates take at the current rate, negative if unknown.
+f64 eta(const telemetry::Snapshot& snapshot, const Progress& progress) {
+    if (progress.finished)
+        return 0.0;
+    if (snapshot.rate <= 0.0)
+        return -1.0;
+    return (f64)remaining(snapshot, progress) / snapshot.rate;
+}
+
+void Exporter::write_json(const telemetry::Snapshot& snapshot, const Progress& progress) {
+    f64 eta_seconds = eta(snapshot, progress);
+    fprintf(
+        json_file,
+        "{\"time\": %lld, \"elapsed\": %.3f, \"mode\": \"%s\", \"kernel\": \"%s\", "
+        "\"hashes\": %lld, \"hashes_per_second\": %.1f, \"avg_hashes_per_second\": %.1f, "
+        "\"keyspace\": %s, \"remaining\": %s, \"done\": %.6f, ",
+        (u64)time(nullptr),
+        snapshot.elapsed,
+        mode,
+        kernel,
+        snapshot.total_hashes,
+        snapshot.rate,
+        snapshot.avg_rate,
+        hash::to_string(progress.keyspace).c_str(),
+        hash::to_string(remaining(snapshot, progress)).c_str(),
+        progress.keyspace ? (f64)snapshot.total_hashes / (f64)progress.keyspace : 1.0);
+
+    if (eta_seconds >= 0.0)
+        fprintf(json_file, "\"eta_seconds\": %.1f, ", eta_seconds);
+    else
+        fprintf(json_file, "\"eta_seconds\": null, ");
+
+    fprintf(
+        json_file,
+        "\"hits\": %lld, \"targets\": %lld, \"remaining_targets\": %lld, "
+        "\"hit_queue_depth\": %lld, \"finished\": %s, \"threads\": [",
+        progress.targets - progress.remaining_targets,
+        progress.targets,
+        progress.remaining_targets,
+        progress.hit_queue_depth,
+        progress.finished ? "true" : "false");
+
+    for (u64 idx = 0; idx < snapshot.thread_hashes.size(); idx++)
+        fprintf(
+            json_file,
+            "%s{\"hashes\": %lld, \"hashes_per_second\": %.1f}",
+            idx ? ", " : "",
+            snapshot.thread_hashes[idx],
+            snapshot.thread_rates[idx]);
+
+    fprintf(json_file, "]}\n");
+    fflush(json_file);
+}
+
+void write_metric(FILE* file, const char* name, const char* type, const char* help) {
+    fprintf(file, "# HELP metaling_%s %s\n# TYPE metaling_%s %s\n", name, help, name, type);
+}
+
+void Exporter::write_prometheus(const telemetry::Snapshot& snapshot, const Progress& progress) {
+    // The collector may read at any time, so the file is only ever swapped in whole.
+    std::string tmp_path = std::string(prometheus_path) + ".tmp";
+    FILE* file = fopen(tmp_path.c_str(), "w");
+    if (!file)
+        error("failed to open metrics file '%s'\n", tmp_path.c_str());
+
+    const char* l = labels.c_str();
+
+    write_metric(file, "elapsed_seconds", "gauge", "Seconds since the search started.");
+    fprintf(file, "metaling_elapsed_seconds{%s} %.3f\n", l, snapshot.elapsed);
+
+    write_metric(file, "hashes_total", "counter", "Candidates checked.");
+    fprintf(file, "metaling_hashes_total{%s} %lld\n", l, snapshot.total_hashes);
+
+    write_metric(file, "hashes_per_second", "gauge", "Candidates checked per second.");
+    fprintf(file, "metaling_hashes_per_second{%s} %.1f\n", l, snapshot.rate);
+
+    write_metric(file, "thread_hashes_total", "counter", "Candidates checked by each worker.");
+    for (u64 idx = 0; idx < snapshot.thread_hashes.size(); idx++)
+        fprintf(
+            file,
+            "metaling_thread_hashes_total{%s,thread=\"%lld\"} %lld\n",
+            l,
+            idx,
+            snapshot.thread_hashes[idx]);
+
+    write_metric(
+        file, "thread_hashes_per_second", "gauge", "Candidates checked per second by each worker.");
+    for (u64 idx = 0; idx < snapshot.thread_rates.size(); idx++)
+        fprintf(
+            file,
+            "metaling_thread_hashes_per_second{%s,thread=\"%lld\"} %.1f\n",
+            l,
+            idx,
+            snapshot.thread_rates[idx]);
+
+    write_metric(file, "keyspace", "gauge", "Candidates in the pattern's keyspace.");
+    fprintf(file, "metaling_keyspace{%s} %s\n", l, hash::to_string(progress.keyspace).c_str());
+
+    write_metric(file, "keyspace_remaining", "gauge", "Candidates left to check.");
+    fprintf(
+        file,
+        "metaling_keyspace_remaining{%s} %s\n",
+        l,
+        hash::to_string(remaining(snapshot, progress)).c_str());
+
+    write_metric(file, "eta_seconds", "gauge", "Seconds left at the current rate.");
+    f64 eta_seconds = eta(snapshot, progress);
+    if (eta_seconds >= 0.0)
+        fprintf(file, "metaling_eta_seconds{%s} %.1f\n", l, eta_seconds);
+    else
+        fprintf(file, "metaling_eta_seconds{%s} NaN\n", l);
+
+    write_metric(file, "hits_total", "counter", "Targets cracked.");
+    fprintf(
+        file,
+        "metaling_hits_total{%s} %lld\n",
+        l,
+        progress.targets - progress.remaining_targets);
+
+    write_metric(file, "targets_remaining", "gauge", "Targets not cracked yet.");
+    fprintf(file, "metaling_targets_remaining{%s} %lld\n", l, progress.remaining_targets);
+
+    write_metric(file, "hit_queue_depth", "gauge", "Hits waiting for the reporter.");
+    fprintf(file, "metaling_hit_queue_depth{%s} %lld\n", l, progress.hit_queue_depth);
+
+    write_metric(file, "running", "gauge", "Whether the search is still running.");
+    fprintf(file, "metaling_running{%s} %d\n", l, progress.finished ? 0 : 1);
+
+    fclose(file);
+    if (rename(tmp_path.c_str(), prometheus_path) != 0)
+        error("failed to replace metrics file '%s'\n", prometheus_path);
+}
+
+} // namespace cpu::metrics
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+#include "src/common.hpp"
+#include "src/backend/cpu/telemetry.hpp"
+
+namespace cpu::metrics {
+
+// What the reporter knows about a run besides the hash counters.
+struct Progress {
+    u128 keyspace;
+
+    u64 targets;
+    u64 remaining_targets;
+
+    // Hits the workers found that the reporter hasn't written out yet.
+    u64 hit_queue_depth;
+
+    bool finished;
+};
+
+// Periodically exports the telemetry snapshots of a run for job runners and monitoring, as JSON
+// lines appended to one file and/or a Prometheus textfile-collector file that is replaced
+// atomically. Fed from the telemetry thread, the workers never see it.
+struct Exporter {
+    Exporter(
+        const char* json_path,
+        const char* prometheus_path,
+        f64 interval,
+        const char* mode,
+        const char* kernel);
+    ~Exporter();
+
+    // Writes at most once per interval, unless the run is finished.
+    void sample(const telemetry::Snapshot& snapshot, const Progress& progress);
+
+  private:
+    void write_json(const telemetry::Snapshot& snapshot, const Progress& progress);
+    void write_prometheus(const telemetry::Snapshot& snapshot, const Progress& progress);
+
+    FILE* json_file = nullptr;
+    const char* prometheus_path;
+    f64 interval;
+    f64 last_elapsed;
+    bool written = false;
+    std::string labels;
+    const char* mode;
+    const char* kernel;
+};
+
+} // namespace cpu::metrics
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <cstring>
+
+#include "src/common.hpp"
+#include "src/backend/cpu/cpu.hpp"
+#include "src/backend/cpu/kernels.hpp"
+#include "src/backend/cpu/targets.hpp"
+
+namespace cpu::modes {
+
+// Hash modes plug into `targets::check` and the workers as template parameters, such that the hot
+// loop is specialised for each of them. A mode declares:
+//
+// - `MODE` and `NAME`, its `cpu::Mode` and the name `--mode` takes.
+// - `DIGEST_BYTES`, the bytes of `Target::hash` it fills. Only the first
+//   `lookup::DIGEST_WORDS` words are compared.
+// - `MAX_CANDIDATE_LEN`, the longest candidate the kernel's message layout fits.
+// - `compare(a, b)`, which orders targets into groups that a single kernel call covers.
+// - `hash(kernel, table, group, batch, count, keys, out)`, the batch kernel. `keys` holds up to
+//   eight words per candidate that carry over from one group to the next.
+
+// Orders WPA targets by ESSID (only relevant for PMK derivation), kind and then by MAC pair. Each
+// handshake is its own group.
+inline i64 compare_wpa(const Target& a, const Target& b, bool essid) {
+    if (essid) {
+        if (a.essid_len != b.essid_len)
+            return a.essid_len < b.essid_len ? -1 : 1;
+        if (i64 cmp = memcmp(a.essid, b.essid, a.essid_len))
+            return cmp;
+    }
+
+    if (a.kind != b.kind)
+        return a.kind < b.kind ? -1 : 1;
+    if (i64 cmp = memcmp(a.mac_ap, b.mac_ap, sizeof(a.mac_ap)))
+        return cmp;
+    if (i64 cmp = memcmp(a.mac_sta, b.mac_sta, sizeof(a.mac_sta)))
+        return cmp;
+
+    if (a.kind == TargetKind::Eapol && a.handshake_idx != b.handshake_idx)
+        return a.handshake_idx < b.handshake_idx ? -1 : 1;
+    return 0;
+}
+
+struct Pmk {
+    static constexpr Mode MODE = Mode::Pmk;
+    static constexpr const char* NAME = "pmk";
+    static constexpr u64 DIGEST_BYTES = 16;
+    static constexpr u64 MAX_CANDIDATE_LEN = 63;
+
+    static i64 compare(const Target& a, const Target& b) {
+        return compare_wpa(a, b, false);
+    }
+
+    static void hash(
+        kernels::Kernel kernel,
+        targets::Table*,
+        const targets::Group& group,
+        const u8 batch[][64],
+        u64 count,
+        u32[][8],
+        u32 out[][5]) {
+        const u32* reject = group.single ? &group.reject_word : nullptr;
+        kernels::pmkid(kernel, batch, count, group.msg, out, reject);
+    }
+};
+
+struct Passphrase {
+    static constexpr Mode MODE = Mode::Passphrase;
+    static constexpr const char* NAME = "passphrase";
+    static constexpr u64 DIGEST_BYTES = 16;
+    static constexpr u64 MAX_CANDIDATE_LEN = 63;
+
+    static i64 compare(const Target& a, const Target& b) {
+        return compare_wpa(a, b, true);
+    }
+
+    // Groups of the same ESSID are adjacent, so the PMKs in `keys` are only derived for the first.
+    static void hash(
+        kernels::Kernel kernel,
+        targets::Table* table,
+        const targets::Group& group,
+        const u8 batch[][64],
+        u64 count,
+        u32 keys[][8],
+        u32 out[][5]) {
+        if (group.new_essid)
+            kernels::wpa_pmk(kernel, batch, count, group.essid, group.essid_len, keys);
+
+        if (group.kind == TargetKind::Pmkid) {
+            const u32* reject = group.single ? &group.reject_word : nullptr;
+            kernels::wpa_pmkid(kernel, keys, count, group.msg, out, reject);
+        } else if (group.kind == TargetKind::PmkidSha256) {
+            kernels::wpa_pmkid_sha256(kernel, keys, count, group.msg, out);
+        } else {
+            const kernels::Eapol& eapol = table->eapols()[group.eapol_idx];
+            kernels::eapol_mic(kernel, keys, count, eapol, out);
+        }
+    }
+};
+
+// Unsalted digests of the candidate itself, every target lands in a single group.
+template <Mode M, u64 Bytes, u64 MaxLen, auto Kernel>
+struct Raw {
+    static constexpr Mode MODE = M;
+    static constexpr u64 DIGEST_BYTES = Bytes;
+    static constexpr u64 MAX_CANDIDATE_LEN = MaxLen;
+
+    static i64 compare(const Target&, const Target&) {
+        return 0;
+    }
+
+    static void hash(
+        kernels::Kernel kernel,
+        targets::Table*,
+        const targets::Group&,
+        const u8 batch[][64],
+        u64 count,
+        u32[][8],
+        u32 out[][5]) {
+        Kernel(kernel, batch, count, out);
+    }
+};
+
+struct RawSha1 : Raw<Mode::RawSha1, 20, kernels::MAX_RAW_LEN, kernels::raw_sha1> {
+    static constexpr const char* NAME = "sha1";
+};
+
+struct RawMd5 : Raw<Mode::RawMd5, 16, kernels::MAX_RAW_LEN, kernels::raw_md5> {
+    static constexpr const char* NAME = "md5";
+};
+
+// MD4 of the candidate as UTF-16LE, only ASCII candidates give the Windows hash.
+struct Ntlm : Raw<Mode::Ntlm, 16, kernels::MAX_RAW_LEN / 2, kernels::ntlm> {
+    static constexpr const char* NAME = "ntlm";
+};
+
+// Calls `f` with the mode struct of `mode`, such that everything below it gets specialised.
+template <typename F>
+void dispatch(Mode mode, F f) {
+    switch (mode) {
+        case Mode::Pmk:
+            f(Pmk{});
+            return;
+        case Mode::Passphrase:
+            f(Passphrase{});
+            return;
+        case Mode::RawSha1:
+            f(RawSha1{});
+            return;
+        case Mode::RawMd5:
+            f(RawMd5{});
+            return;
+        case Mode::Ntlm:
+            f(Ntlm{});
+            return;
+    }
+
+    error("unknown hash mode %d\n", (int)mode);
+}
+
+const Mode ALL[] = {Mode::Pmk, Mode::Passphrase, Mode::RawSha1, Mode::RawMd5, Mode::Ntlm};
+
+inline const char* name(Mode mode) {
+    const char* out = "unknown";
+    dispatch(mode, [&](auto m) { out = decltype(m)::NAME; });
+    return out;
+}
+
+inline bool parse(const char* str, Mode* out) {
+    for (Mode mode : ALL) {
+        if (strcmp(str, name(mode)) == 0) {
+            *out = mode;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Whether targets of the mode are WPA PMKIDs or handshakes, rather than plain digests.
+inline bool is_wpa(Mode mode) {
+    return mode == Mode::Pmk || mode == Mode::Passphrase;
+}
+
+} // namespace cpu::modes
@@ -0,0 +1,204 @@
+#include "src/backend/cpu/perf.hpp"
+#include "src/common.hpp"
+
+#include <cstring>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace cpu::perf {
+
+const char* event_name(Event event) {
+    switch (event) {
+        case Cycles:
+            return "cycles";
+        case Instructions:
+            return "instructions";
+        case L1dMisses:
+            return "l1d_misses";
+        case LlcMisses:
+            return "llc_misses";
+        case BranchMisses:
+            return "branch_misses";
+        case StalledCycles:
+            return "stalled_cycles";
+        case EVENT_COUNT:
+            break;
+    }
+
+    return "unknown";
+}
+
+#if defined(__linux__)
+
+void init_attr(Event event, perf_event_attr* attr) {
+    memset(attr, 0, sizeof(*attr));
+    attr->size = sizeof(*attr);
+    attr->type = PERF_TYPE_HARDWARE;
+    attr->disabled = 1;
+    attr->exclude_kernel = 1;
+    attr->exclude_hv = 1;
+    attr->read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    switch (event) {
+        case Cycles:
+            attr->config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case Instructions:
+            attr->config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case L1dMisses:
+            attr->type = PERF_TYPE_HW_CACHE;
+            attr->config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                           (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+        case LlcMisses:
+            attr->config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+        case BranchMisses:
+            attr->config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        case StalledCycles:
+            attr->config = PERF_COUNT_HW_STALLED_CYCLES_BACKEND;
+            break;
+        case EVENT_COUNT:
+            break;
+    }
+}
+
+bool start(Counters* counters) {
+    bool any = false;
+
+    for (u64 idx = 0; idx < EVENT_COUNT; idx++) {
+        perf_event_attr attr;
+        init_attr((Event)idx, &attr);
+
+        // This thread on any CPU.
+        counters->fds[idx] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        any |= counters->fds[idx] >= 0;
+    }
+
+    for (u64 idx = 0; idx < EVENT_COUNT; idx++)
+        if (counters->fds[idx] >= 0)
+            ioctl(counters->fds[idx], PERF_EVENT_IOC_ENABLE, 0);
+
+    return any;
+}
+
+void stop(Counters* counters, u64 hashes, Counts* out) {
+    for (u64 idx = 0; idx < EVENT_COUNT; idx++)
+        if (counters->fds[idx] >= 0)
+            ioctl(counters->fds[idx], PERF_EVENT_IOC_DISABLE, 0);
+
+    for (u64 idx = 0; idx < EVENT_COUNT; idx++) {
+        int fd = counters->fds[idx];
+        if (fd < 0)
+            continue;
+
+        // Value, time enabled and time running.
+        u64 values[3];
+        if (read(fd, values, sizeof(values)) == sizeof(values) && values[2]) {
+            out->values[idx] += (u64)((f64)values[0] * (f64)values[1] / (f64)values[2]);
+            out->available[idx] = true;
+        }
+
+        close(fd);
+        counters->fds[idx] = -1;
+    }
+
+    out->hashes += hashes;
+}
+
+#else
+
+bool start(Counters* counters) {
+    for (u64 idx = 0; idx < EVENT_COUNT; idx++)
+        counters->fds[idx] = -1;
+    return false;
+}
+
+void stop(Counters* counters, u64 hashes, Counts* out) {
+    out->hashes += hashes;
+}
+
+#endif
+
+void add(const Counts& counts, Counts* out) {
+    for (u64 idx = 0; idx < EVENT_COUNT; idx++) {
+        out->values[idx] += counts.values[idx];
+        out->available[idx] |= counts.available[idx];
+    }
+
+    out->hashes += counts.hashes;
+}
+
+// Per candidate, or negative if unknown.
+f64 per_hash(const Counts& counts, Event event) {
+    if (!counts.available[event] || !counts.hashes)
+        return -1.0;
+    return (f64)counts.values[event] / (f64)counts.hashes;
+}
+
+f64 ipc(const Counts& counts) {
+    if (!counts.available[Cycles] || !counts.available[Instructions] || !counts.values[Cycles])
+        return -1.0;
+    return (f64)counts.values[Instructions] / (f64)counts.values[Cycles];
+}
+
+void print(const Counts& counts) {
+    bool any = false;
+    for (u64 idx = 0; idx < EVENT_COUNT; idx++)
+        any |= counts.available[idx];
+
+    if (!any) {
+        int paranoid = -1;
+        if (FILE* file = fopen("/proc/sys/kernel/perf_event_paranoid", "r")) {
+            if (fscanf(file, "%d", &paranoid) != 1)
+                paranoid = -1;
+            fclose(file);
+        }
+
+        printf("perf: hardware counters are unavailable");
+        if (paranoid > 2)
+            printf(" (perf_event_paranoid is %d, at most 2 allows them)", paranoid);
+        printf("\n");
+        return;
+    }
+
+    printf("perf:");
+    if (ipc(counts) >= 0.0)
+        printf(" %.2f IPC,", ipc(counts));
+
+    for (u64 idx = 0; idx < EVENT_COUNT; idx++) {
+        f64 value = per_hash(counts, (Event)idx);
+        if (value >= 0.0)
+            printf(" %.2f %s/hash,", value, event_name((Event)idx));
+        else
+            printf(" no %s,", event_name((Event)idx));
+    }
+
+    printf(" over %lld hashes\n", counts.hashes);
+}
+
+void write_json(FILE* file, const Counts& counts) {
+    if (ipc(counts) >= 0.0)
+        fprintf(file, "{\"ipc\": %.3f", ipc(counts));
+    else
+        fprintf(file, "{\"ipc\": null");
+
+    for (u64 idx = 0; idx < EVENT_COUNT; idx++) {
+        f64 value = per_hash(counts, (Event)idx);
+        if (value >= 0.0)
+            fprintf(file, ", \"%s_per_hash\": %.3f", event_name((Event)idx), value);
+        else
+            fprintf(file, ", \"%s_per_hash\": null", event_name((Event)idx));
+    }
+
+    fprintf(file, "}");
+}
+
+} // namespace cpu::perf
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdio>
+
+#include "src/common.hpp"
+
+namespace cpu::perf {
+
+enum Event {
+    Cycles,
+    Instructions,
+    L1dMisses,
+    LlcMisses,
+    BranchMisses,
+    StalledCycles,
+    EVENT_COUNT,
+};
+
+const char* event_name(Event event);
+
+// Hardware counters of the hashing loop, of one thread or summed over all of them. Events that the
+// kernel, CPU or hypervisor doesn't offer stay unavailable, which is common in VMs and containers.
+struct Counts {
+    u64 values[EVENT_COUNT];
+    bool available[EVENT_COUNT];
+
+    // Candidates checked while the counters ran.
+    u64 hashes;
+};
+
+// perf_event_open counters of the calling thread, each event opened on its own such that a
+// missing one doesn't take the others down.
+struct Counters {
+    int fds[EVENT_COUNT];
+};
+
+// Opens and enables the counters, returns false if none of the events could be opened.
+bool start(Counters* counters);
+
+// Disables and closes the counters and adds their values, scaled up if the kernel had to
+// multiplex them, to `out`.
+void stop(Counters* counters, u64 hashes, Counts* out);
+
+// Sums the counts of several threads, an event is available if any of them had it.
+void add(const Counts& counts, Counts* out);
+
+// Prints IPC and the per-candidate counts, or why there are none.
+void print(const Counts& counts);
+
+// The same as a JSON object, with null for unavailable events.
+void write_json(FILE* file, const Counts& counts);
+
+} // namespace cpu::perf
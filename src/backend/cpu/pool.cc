@@ -0,0 +1,70 @@
+#include "src/backend/cpu/pool.hpp"
+#include "src/backend/cpu/topology.hpp"
+#include "src/common.hpp"
+
+namespace cpu::pool {
+
+Pool::Pool(const std::vector<i64>& cpu_ids) : pinned_threads(cpu_ids.size(), 0) {
+    for (u64 idx = 0; idx < cpu_ids.size(); idx++)
+        threads.emplace_back(&Pool::loop, this, idx, cpu_ids[idx]);
+
+    // Pinning happens on the threads themselves, wait for it such that `pinned` is settled.
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cv.wait(lock, [&] { return started == threads.size(); });
+}
+
+Pool::~Pool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    work_cv.notify_all();
+
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+void Pool::run(u64 count, const std::function<void(u64)>& task) {
+    if (count > threads.size())
+        error("pool of %lld threads can't run %lld tasks\n", (u64)threads.size(), count);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    this->task = &task;
+    this->count = count;
+    running = count;
+    generation++;
+    work_cv.notify_all();
+
+    done_cv.wait(lock, [&] { return running == 0; });
+    this->task = nullptr;
+}
+
+void Pool::loop(u64 idx, i64 cpu_id) {
+    bool pinned = cpu_id >= 0 && topology::pin_current_thread(cpu_id);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    pinned_threads[idx] = pinned;
+    started++;
+    done_cv.notify_all();
+
+    u64 seen = generation;
+    while (true) {
+        work_cv.wait(lock, [&] { return stopping || generation != seen; });
+        if (stopping)
+            return;
+
+        seen = generation;
+        if (idx >= count)
+            continue;
+
+        const std::function<void(u64)>* current = task;
+        lock.unlock();
+        (*current)(idx);
+        lock.lock();
+
+        if (--running == 0)
+            done_cv.notify_all();
+    }
+}
+
+} // namespace cpu::pool
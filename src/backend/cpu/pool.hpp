@@ -0,0 +1,51 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "src/common.hpp"
+
+namespace cpu::pool {
+
+// Worker threads that outlive a single search, such that a long-lived process doesn't spawn and
+// pin a thread per worker for each of its jobs. Each thread pins itself once when it starts.
+struct Pool {
+    // One thread per entry, pinned to that logical CPU or left to the OS for -1.
+    explicit Pool(const std::vector<i64>& cpu_ids);
+    ~Pool();
+
+    u64 size() const {
+        return threads.size();
+    }
+
+    // Whether the thread got pinned to its CPU.
+    bool pinned(u64 idx) const {
+        return pinned_threads[idx];
+    }
+
+    // Calls `task(idx)` on the first `count` threads and returns once every call returned.
+    void run(u64 count, const std::function<void(u64)>& task);
+
+  private:
+    void loop(u64 idx, i64 cpu_id);
+
+    std::vector<std::thread> threads;
+    std::vector<u8> pinned_threads;
+
+    std::mutex mutex;
+    std::condition_variable work_cv;
+    std::condition_variable done_cv;
+
+    // Bumped for every `run`, threads below `count` take part in it.
+    u64 generation = 0;
+    u64 count = 0;
+    u64 running = 0;
+    u64 started = 0;
+    const std::function<void(u64)>* task = nullptr;
+    bool stopping = false;
+};
+
+} // namespace cpu::pool
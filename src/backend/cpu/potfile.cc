@@ -0,0 +1,369 @@
+#include "src/backend/cpu/potfile.hpp"
+#include "src/hash.hpp"
+#include "src/backend/cpu/modes.hpp"
+#include "src/backend/cpu/targets.hpp"
+#include "src/backend/cpu/topology.hpp"
+#include "src/common.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_set>
+
+namespace cpu::potfile {
+
+// Fewer passphrases than this per thread aren't worth starting a thread for.
+constexpr u64 MIN_PASSPHRASES_PER_THREAD = 64;
+
+std::string target_key(Mode mode, const Target& target) {
+    u64 digest_bytes = 0;
+    modes::dispatch(mode, [&](auto m) { digest_bytes = decltype(m)::DIGEST_BYTES; });
+
+    std::string key = std::string(modes::name(mode)) + "*" +
+                      ::hash::bytes_to_digest((const u8*)target.hash, digest_bytes);
+    if (!modes::is_wpa(mode))
+        return key;
+
+    // The kind tells handshakes and the two PMKID variants apart, their hashes never collide but
+    // the key should say what it is.
+    const char* kind = target.kind == TargetKind::Eapol         ? "eapol"
+                       : target.kind == TargetKind::PmkidSha256 ? "pmkid-sha256"
+                                                                : "pmkid";
+    return key + "*" + ::hash::bytes_to_digest(target.mac_ap, sizeof(target.mac_ap)) + "*" +
+           ::hash::bytes_to_digest(target.mac_sta, sizeof(target.mac_sta)) + "*" +
+           ::hash::bytes_to_digest(target.essid, target.essid_len) + "*" + kind;
+}
+
+// Slots per record stay above this, such that probe sequences stay short.
+constexpr u64 MIN_SLOTS_PER_RECORD = 2;
+
+// FNV-1a, keys are short and only hashed once each.
+u64 hash_key(std::string_view key) {
+    u64 hash = 0xcbf29ce484222325;
+    for (char c : key)
+        hash = (hash ^ (u8)c) * 0x100000001b3;
+    return hash;
+}
+
+struct Line {
+    std::string_view key;
+    std::string_view passphrase;
+};
+
+// The line at `offset`, which is known to be complete.
+Line read_line(const Index& index, u64 offset) {
+    const char* data = reinterpret_cast<const char*>(index.mapping.data) + offset;
+    const char* end = static_cast<const char*>(memchr(data, '\n', index.mapping.size - offset));
+    const char* colon = static_cast<const char*>(memchr(data, ':', end - data));
+
+    return Line{
+        .key = std::string_view(data, colon - data),
+        .passphrase = std::string_view(colon + 1, end - colon - 1),
+    };
+}
+
+i32 hex_value(char c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+std::string decode(std::string_view passphrase) {
+    if (passphrase.size() < 6 || passphrase.substr(0, 5) != "$HEX[" || passphrase.back() != ']')
+        return std::string(passphrase);
+
+    std::string_view hex = passphrase.substr(5, passphrase.size() - 6);
+    std::string out;
+    for (u64 idx = 0; idx + 1 < hex.size(); idx += 2) {
+        i32 hi = hex_value(hex[idx]);
+        i32 lo = hex_value(hex[idx + 1]);
+        if (hi < 0 || lo < 0)
+            return std::string(passphrase);
+        out.push_back((char)(hi << 4 | lo));
+    }
+
+    return out;
+}
+
+std::string encode(const u8* passphrase, u64 len) {
+    bool printable = !(len >= 5 && memcmp(passphrase, "$HEX[", 5) == 0);
+    for (u64 idx = 0; idx < len; idx++)
+        printable &= passphrase[idx] >= 0x20 && passphrase[idx] < 0x7f;
+
+    if (printable)
+        return std::string((const char*)passphrase, len);
+    return "$HEX[" + ::hash::bytes_to_digest(passphrase, len) + "]";
+}
+
+void grow(Index* index) {
+    std::vector<Slot> slots(index->slots.size() * 2, Slot{.hash = 0, .line = 0});
+    u64 mask = slots.size() - 1;
+
+    for (const Slot& entry : index->slots) {
+        if (!entry.line)
+            continue;
+
+        u64 slot = entry.hash & mask;
+        while (slots[slot].line)
+            slot = (slot + 1) & mask;
+        slots[slot] = entry;
+    }
+
+    index->slots = std::move(slots);
+}
+
+void load(const char* path, Index* index) {
+    *index = Index{.mapping = {.data = nullptr, .size = 0}, .slots = {}, .count = 0};
+    if (access(path, F_OK) != 0)
+        return;
+
+    index->mapping = file::map(path);
+    const char* data = reinterpret_cast<const char*>(index->mapping.data);
+    u64 size = index->mapping.size;
+
+    // Records are around 100 bytes, sizing the table for one per 32 bytes avoids growing it.
+    u64 capacity = 16;
+    while (capacity < size / 32 * MIN_SLOTS_PER_RECORD)
+        capacity *= 2;
+    index->slots.assign(capacity, Slot{.hash = 0, .line = 0});
+    u64 mask = capacity - 1;
+
+    for (u64 offset = 0; offset < size;) {
+        if ((index->count + 1) * MIN_SLOTS_PER_RECORD > index->slots.size()) {
+            grow(index);
+            mask = index->slots.size() - 1;
+        }
+
+        const char* newline = static_cast<const char*>(memchr(data + offset, '\n', size - offset));
+        if (!newline)
+            break;
+
+        u64 line_end = newline - data;
+        const char* colon = static_cast<const char*>(memchr(data + offset, ':', line_end - offset));
+        if (colon) {
+            std::string_view key(data + offset, colon - (data + offset));
+            u64 hash = hash_key(key);
+
+            for (u64 slot = hash & mask;; slot = (slot + 1) & mask) {
+                Slot& entry = index->slots[slot];
+                if (!entry.line) {
+                    entry = Slot{.hash = hash, .line = offset + 1};
+                    index->count++;
+                    break;
+                }
+
+                if (entry.hash == hash && read_line(*index, entry.line - 1).key == key)
+                    break;
+            }
+        }
+
+        offset = line_end + 1;
+    }
+}
+
+void unload(Index* index) {
+    file::unmap(index->mapping);
+    *index = Index{.mapping = {.data = nullptr, .size = 0}, .slots = {}, .count = 0};
+}
+
+bool find(const Index& index, std::string_view key, std::string* passphrase) {
+    if (index.slots.empty())
+        return false;
+
+    u64 hash = hash_key(key);
+    u64 mask = index.slots.size() - 1;
+    for (u64 slot = hash & mask;; slot = (slot + 1) & mask) {
+        const Slot& entry = index.slots[slot];
+        if (!entry.line)
+            return false;
+
+        if (entry.hash != hash)
+            continue;
+
+        Line line = read_line(index, entry.line - 1);
+        if (line.key == key) {
+            *passphrase = decode(line.passphrase);
+            return true;
+        }
+    }
+}
+
+std::vector<std::string> passphrases(const Index& index) {
+    std::vector<u64> lines;
+    lines.reserve(index.count);
+    for (const Slot& entry : index.slots)
+        if (entry.line)
+            lines.push_back(entry.line - 1);
+    std::sort(lines.begin(), lines.end());
+
+    std::vector<std::string> out;
+    std::unordered_set<std::string> seen;
+    for (u64 line : lines) {
+        std::string passphrase = decode(read_line(index, line).passphrase);
+        if (seen.insert(passphrase).second)
+            out.push_back(std::move(passphrase));
+    }
+
+    return out;
+}
+
+void append(const char* path, std::string_view key, const u8* passphrase, u64 len) {
+    int fd = open(path, O_RDWR | O_APPEND | O_CREAT, 0600);
+    if (fd < 0)
+        error("failed to open potfile '%s'\n", path);
+
+    std::string record = std::string(key) + ":" + encode(passphrase, len) + "\n";
+
+    // Other runs appending to the same potfile wait, such that the tail can be repaired.
+    if (flock(fd, LOCK_EX) != 0)
+        error("failed to lock potfile '%s'\n", path);
+
+    // A record without its newline was cut short and may hold a partial passphrase, it is cut off
+    // rather than completed. The search for the previous newline goes back as far as it takes, a
+    // file without any is never truncated but has the record start on a new line instead.
+    struct stat st;
+    char last;
+    if (fstat(fd, &st) == 0 && st.st_size > 0 && pread(fd, &last, 1, st.st_size - 1) == 1 &&
+        last != '\n') {
+        char window[4096];
+        u64 end = st.st_size;
+        while (end > 0) {
+            u64 window_len = std::min<u64>(end, sizeof(window));
+            if (pread(fd, window, window_len, end - window_len) != (i64)window_len)
+                error("failed to read potfile '%s'\n", path);
+
+            end -= window_len;
+            if (const char* newline =
+                    static_cast<const char*>(memrchr(window, '\n', window_len))) {
+                if (ftruncate(fd, end + (newline - window) + 1) != 0)
+                    error("failed to repair potfile '%s'\n", path);
+                break;
+            }
+
+            if (end == 0)
+                record = "\n" + record;
+        }
+    }
+
+    // O_APPEND makes the single write land at the end even with concurrent writers.
+    if (write(fd, record.data(), record.size()) != (i64)record.size() || fsync(fd) != 0)
+        error("failed to write potfile '%s'\n", path);
+    close(fd);
+}
+
+// Removes the targets at `indices` (ascending) from `job`.
+void remove_targets(Job* job, const std::vector<u64>& indices) {
+    u64 next = 0;
+    u64 out = 0;
+    for (u64 idx = 0; idx < job->targets.size(); idx++) {
+        if (next < indices.size() && indices[next] == idx) {
+            next++;
+            continue;
+        }
+        job->targets[out++] = job->targets[idx];
+    }
+    job->targets.resize(out);
+}
+
+std::vector<Cracked> drop_cracked(const Index& index, Job* job) {
+    std::vector<Cracked> cracked;
+    std::vector<u64> indices;
+
+    for (u64 idx = 0; idx < job->targets.size(); idx++) {
+        std::string passphrase;
+        if (find(index, target_key(job->mode, job->targets[idx]), &passphrase)) {
+            cracked.push_back(Cracked{.target = job->targets[idx], .passphrase = passphrase});
+            indices.push_back(idx);
+        }
+    }
+
+    remove_targets(job, indices);
+    return cracked;
+}
+
+std::vector<Cracked> recheck(
+    const Index& index,
+    Job* job,
+    kernels::Kernel kernel,
+    u64 thread_count) {
+    if (job->targets.empty())
+        return {};
+
+    u64 max_len = 0;
+    modes::dispatch(job->mode, [&](auto m) { max_len = decltype(m)::MAX_CANDIDATE_LEN; });
+
+    // Zero padded candidates, like the generator produces them.
+    std::vector<std::string> words = passphrases(index);
+    std::vector<u8> candidates;
+    for (const std::string& word : words) {
+        if (word.empty() || word.size() > max_len || memchr(word.data(), 0, word.size()))
+            continue;
+
+        candidates.resize(candidates.size() + 64, 0);
+        memcpy(&candidates[candidates.size() - 64], word.data(), word.size());
+    }
+
+    u64 count = candidates.size() / 64;
+    if (!count)
+        return {};
+
+    if (thread_count == 0)
+        thread_count = topology::default_thread_count(topology::discover(), true);
+    thread_count = std::max<u64>(1, std::min(thread_count, count / MIN_PASSPHRASES_PER_THREAD));
+
+    // Every thread checks a slice of the passphrases against its own table.
+    auto* batch = reinterpret_cast<const u8(*)[64]>(candidates.data());
+    std::mutex mutex;
+    std::vector<std::pair<u64, std::string>> hits;
+    std::vector<std::thread> threads;
+
+    for (u64 tdx = 0; tdx < thread_count; tdx++) {
+        u64 start = count * tdx / thread_count;
+        u64 end = count * (tdx + 1) / thread_count;
+
+        threads.emplace_back([&, start, end]() {
+            targets::Table* table = targets::new_table(*job);
+            modes::dispatch(job->mode, [&](auto m) {
+                targets::check<decltype(m)>(
+                    kernel, table, &batch[start], end - start, [&](u64 idx, u64 target_idx) {
+                        const char* word = (const char*)batch[start + idx];
+                        std::lock_guard<std::mutex> lock(mutex);
+                        hits.emplace_back(target_idx, std::string(word, strnlen(word, 64)));
+                        return true;
+                    });
+            });
+            targets::free_table(table);
+        });
+    }
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    // Only the first passphrase that hits a target is kept, which one that is only matters for
+    // unsalted digests with colliding preimages.
+    std::sort(hits.begin(), hits.end());
+
+    std::vector<Cracked> cracked;
+    std::vector<u64> indices;
+    for (const auto& [target_idx, passphrase] : hits) {
+        if (!indices.empty() && indices.back() == target_idx)
+            continue;
+
+        cracked.push_back(Cracked{.target = job->targets[target_idx], .passphrase = passphrase});
+        indices.push_back(target_idx);
+    }
+    remove_targets(job, indices);
+
+    return cracked;
+}
+
+} // namespace cpu::potfile
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "src/common.hpp"
+#include "src/backend/cpu/cpu.hpp"
+#include "src/backend/cpu/file.hpp"
+
+namespace cpu::potfile {
+
+// Append-only record of cracked targets, one `KEY:PASSPHRASE` line each. The key names the mode
+// and everything the hash depends on (see `target_key`), so it never contains a `:`. Passphrases
+// with bytes outside of printable ASCII are written as `$HEX[...]`, like hashcat does.
+
+// `MODE*HASH*MAC_AP*MAC_STA*ESSID` in the WPA modes, `MODE*DIGEST` in the unsalted ones, in hex.
+std::string target_key(Mode mode, const Target& target);
+
+struct Slot {
+    u64 hash;
+
+    // Offset of the line in the mapping plus one, 0 marks an empty slot.
+    u64 line;
+};
+
+// Open addressing hash table over the lines of the mapped potfile, only the key hashes and line
+// offsets are kept in memory.
+struct Index {
+    file::Mapping mapping;
+    std::vector<Slot> slots;
+    u64 count;
+};
+
+// A missing potfile is an empty one. A trailing line without a newline is a record that a crash
+// cut short, it is ignored. The first record of a key wins.
+void load(const char* path, Index* index);
+void unload(Index* index);
+
+// A passphrase the way records store it, `$HEX[...]` unless it's printable ASCII.
+std::string encode(const u8* passphrase, u64 len);
+
+// Looks up the passphrase of a key.
+bool find(const Index& index, std::string_view key, std::string* passphrase);
+
+// Every distinct passphrase in the potfile, in file order.
+std::vector<std::string> passphrases(const Index& index);
+
+// Appends a record with a single write and syncs it to disk before returning. A record left
+// unfinished by an earlier crash is cut off first, such that it can't swallow this one.
+void append(const char* path, std::string_view key, const u8* passphrase, u64 len);
+
+struct Cracked {
+    Target target;
+    std::string passphrase;
+};
+
+// Drops the targets of `job` that the potfile has a record for and returns them.
+std::vector<Cracked> drop_cracked(const Index& index, Job* job);
+
+// Checks every passphrase of the potfile against the targets of `job` before the keyspace gets
+// searched, since passphrases tend to be reused across networks and audits. Matching targets are
+// dropped and returned like in `drop_cracked`. Uses `thread_count` threads, 0 picks one per usable
+// CPU.
+std::vector<Cracked> recheck(
+    const Index& index,
+    Job* job,
+    kernels::Kernel kernel,
+    u64 thread_count);
+
+} // namespace cpu::potfile
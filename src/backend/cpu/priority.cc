@@ -0,0 +1,124 @@
+#include "src/backend/cpu/priority.hpp"
+#include "src/common.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#include <pthread.h>
+#endif
+
+using namespace std::chrono;
+
+namespace cpu::priority {
+
+bool lower_current_thread() {
+#if defined(__linux__)
+    sched_param param = {.sched_priority = 0};
+    if (pthread_setschedparam(pthread_self(), SCHED_IDLE, &param) == 0)
+        return true;
+
+    // Linux applies nice values per thread.
+    return setpriority(PRIO_PROCESS, syscall(SYS_gettid), 19) == 0;
+#elif defined(__APPLE__)
+    return pthread_set_qos_class_self_np(QOS_CLASS_BACKGROUND, 0) == 0;
+#else
+    return setpriority(PRIO_PROCESS, 0, 19) == 0;
+#endif
+}
+
+LoadMonitor::LoadMonitor() {
+    cpu_count = std::max<u64>(1, sysconf(_SC_NPROCESSORS_ONLN));
+    last_time = steady_clock::now();
+
+    if (!sample(&last_busy, &last_own)) {
+        last_busy = 0.0;
+        last_own = 0.0;
+    }
+}
+
+// Returns the CPU time spent by the whole machine and by this process, in seconds.
+bool LoadMonitor::sample(f64* busy, f64* own) {
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return false;
+
+    *own = (f64)usage.ru_utime.tv_sec + (f64)usage.ru_utime.tv_usec / 1e6 +
+           (f64)usage.ru_stime.tv_sec + (f64)usage.ru_stime.tv_usec / 1e6;
+
+#if defined(__linux__)
+    FILE* file = fopen("/proc/stat", "r");
+    if (!file)
+        return false;
+
+    unsigned long long user, nice, system, idle, iowait, irq, softirq, steal;
+    int count = fscanf(
+        file,
+        "cpu %llu %llu %llu %llu %llu %llu %llu %llu",
+        &user,
+        &nice,
+        &system,
+        &idle,
+        &iowait,
+        &irq,
+        &softirq,
+        &steal);
+    fclose(file);
+
+    if (count != 8)
+        return false;
+
+    *busy = (f64)(user + nice + system + irq + softirq + steal) / (f64)sysconf(_SC_CLK_TCK);
+    return true;
+#elif defined(__APPLE__)
+    host_cpu_load_info_data_t info;
+    mach_msg_type_number_t count = HOST_CPU_LOAD_INFO_COUNT;
+    if (host_statistics(mach_host_self(), HOST_CPU_LOAD_INFO, (host_info_t)&info, &count) !=
+        KERN_SUCCESS)
+        return false;
+
+    u64 ticks = (u64)info.cpu_ticks[CPU_STATE_USER] + info.cpu_ticks[CPU_STATE_SYSTEM] +
+                info.cpu_ticks[CPU_STATE_NICE];
+    *busy = (f64)ticks / (f64)sysconf(_SC_CLK_TCK);
+    return true;
+#else
+    return false;
+#endif
+}
+
+u64 LoadMonitor::allowed_threads(u64 thread_count) {
+    f64 busy, own;
+    if (!sample(&busy, &own))
+        return thread_count;
+
+    auto now = steady_clock::now();
+    f64 dt = duration<f64>(now - last_time).count();
+    if (dt <= 0.0)
+        return thread_count;
+
+    // CPUs worth of work done by everybody else since the last sample.
+    f64 foreign = std::max(0.0, (busy - last_busy) - (own - last_own)) / dt;
+
+    last_busy = busy;
+    last_own = own;
+    last_time = now;
+
+    // A CPU counts as taken once other processes use more than half of it.
+    f64 free = (f64)cpu_count - foreign;
+    if (free < 0.5)
+        return 0;
+
+    return std::min<u64>(thread_count, (u64)std::floor(free + 0.5));
+}
+
+} // namespace cpu::priority
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <chrono>
+
+#include "src/common.hpp"
+
+namespace cpu::priority {
+
+// Moves the calling thread into the lowest scheduling class available (SCHED_IDLE on Linux,
+// the background QoS class on macOS), falling back to the highest nice value.
+bool lower_current_thread();
+
+// Tracks how much CPU time other processes use, such that background runs can back off when
+// somebody else needs the machine.
+struct LoadMonitor {
+    LoadMonitor();
+
+    // Returns how many of the `thread_count` workers may run right now, based on the CPU time
+    // used by everything but this process since the last call.
+    u64 allowed_threads(u64 thread_count);
+
+  private:
+    bool sample(f64* busy, f64* own);
+
+    u64 cpu_count;
+    f64 last_busy;
+    f64 last_own;
+    std::chrono::steady_clock::time_point last_time;
+};
+
+} // namespace cpu::priority
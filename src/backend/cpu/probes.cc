@@ -0,0 +1,12 @@
+#include "src/backend/cpu/probes.hpp"
+
+#if defined(METALING_PROBES)
+
+// Tracers find the semaphores through the probe notes and increment them in place while attached.
+#define PROBE_SEMAPHORE(name)                 \
+    __attribute__((section(".probes"), used)) \
+    volatile unsigned short metaling_##name##_semaphore = 0;
+METALING_PROBE_LIST(PROBE_SEMAPHORE)
+#undef PROBE_SEMAPHORE
+
+#endif
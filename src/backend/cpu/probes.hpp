@@ -0,0 +1,51 @@
+#pragma once
+
+// Static USDT probes of the `metaling` provider, for attaching bpftrace, perf or SystemTap to a
+// running search without rebuilding it, e.g.
+//
+//   bpftrace -p PID -e 'usdt:metaling:stride_done { @ns = hist(arg2); }'
+//
+// A probe is a single nop plus a note in `.note.stapsdt`. Arguments that cost something to
+// compute, like timings, are guarded by `PROBE_ENABLED`, which reads the semaphore that tracers
+// bump while attached. Without <sys/sdt.h> everything compiles to nothing.
+//
+// run_start(threads, targets)               run_done(hashes, ns)
+// stride_start(thread, hashes)              stride_done(thread, candidates, ns)
+// batch_done(candidates, ns)                hit(target, duplicate)
+// retire(target, remaining)                 compact(digests, ns)
+// park(running_threads, ns)
+
+#if defined(__linux__) && __has_include(<sys/sdt.h>)
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+#define METALING_PROBES 1
+#endif
+
+#define METALING_PROBE_LIST(X) \
+    X(run_start)               \
+    X(run_done)                \
+    X(stride_start)            \
+    X(stride_done)             \
+    X(batch_done)              \
+    X(hit)                     \
+    X(retire)                  \
+    X(compact)                 \
+    X(park)
+
+#if defined(METALING_PROBES)
+
+#define PROBE_SEMAPHORE(name) extern "C" volatile unsigned short metaling_##name##_semaphore;
+METALING_PROBE_LIST(PROBE_SEMAPHORE)
+#undef PROBE_SEMAPHORE
+
+#define PROBE_ENABLED(name) __builtin_expect(metaling_##name##_semaphore != 0, 0)
+#define PROBE(name, ...) STAP_PROBEV(metaling, name, ##__VA_ARGS__)
+
+#else
+
+#define PROBE_ENABLED(name) false
+#define PROBE(name, ...) \
+    do {                 \
+    } while (0)
+
+#endif
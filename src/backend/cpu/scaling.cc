@@ -0,0 +1,294 @@
+#include "src/backend/cpu/scaling.hpp"
+#include "src/backend/cpu/benchmark.hpp"
+#include "src/backend/cpu/cpu.hpp"
+#include "src/backend/cpu/hash.hpp"
+#include "src/backend/cpu/topology.hpp"
+#include "src/common.hpp"
+#include "src/hash.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace cpu::scaling {
+
+const topology::Pinning PINNINGS[] = {
+    topology::Pinning::None,
+    topology::Pinning::Compact,
+    topology::Pinning::Scatter,
+};
+
+struct Entry {
+    topology::Pinning pinning;
+    bool weak;
+
+    // Keyspace index of the planted passphrase.
+    u128 position;
+    Result result;
+
+    // Relative to the single threaded run with the same pinning. For strong scaling that's the
+    // speedup divided by the thread count, for weak scaling the ratio of the times to hit.
+    f64 efficiency;
+};
+
+// `hash::generate_example` takes a C string, so candidates with a NUL before their last
+// character can't be planted.
+bool representable(const u8 candidate[64], u64 len) {
+    bool ended = false;
+    for (u64 idx = 0; idx < len; idx++) {
+        if (candidate[idx] == '\0')
+            ended = true;
+        else if (ended)
+            return false;
+    }
+
+    return true;
+}
+
+// Candidate at `position` in the enumeration order, or the first representable one after it.
+// Returns the position that was used.
+u128 candidate_at(const char* pattern, u128 position, u8 out[64]) {
+    u64 len = strlen(pattern);
+    const char* char_sets[64];
+    u32 set_sizes[64];
+    hash::init_char_sets((const u8*)pattern, len, char_sets, set_sizes);
+    u128 keyspace = hash::keyspace((const u8*)pattern, len);
+
+    hash::Decoder decoder;
+    hash::init_decoder(set_sizes, len, &decoder);
+    u32 indices[64];
+    hash::initialize_indices(decoder, position, indices);
+
+    for (;; position++) {
+        if (position >= keyspace)
+            error("no passphrase can be planted past the requested keyspace position\n");
+
+        memset(out, 0, 64);
+        hash::pack_candidate(indices, char_sets, len, out);
+        if (representable(out, len))
+            return position;
+
+        hash::next_indices(indices, set_sizes, len);
+    }
+}
+
+// Decoys are as long as a candidate can be, such that they are practically never in the keyspace.
+void decoy_passphrase(u64 idx, char out[64]) {
+    memset(out, '#', 63);
+    out[63] = '\0';
+
+    int len = snprintf(out, 64, "metaling-decoy-%lld-", idx);
+    out[len] = '#';
+}
+
+// Targets with random MACs, all but `planted_idx` using passphrases outside of the keyspace.
+Job make_job(const char* pattern, u64 target_count, const u8 passphrase[64], u64* planted_idx) {
+    Job job = Job{
+        .pattern = pattern,
+        .mode = Mode::Pmk,
+        .targets = std::vector<Target>(target_count),
+    };
+
+    std::mt19937_64 rng(target_count);
+    *planted_idx = rng() % target_count;
+
+    for (u64 idx = 0; idx < target_count; idx++) {
+        Target& target = job.targets[idx];
+        target.essid_len = 0;
+
+        for (u64 byte = 0; byte < 6; byte++) {
+            target.mac_ap[byte] = rng();
+            target.mac_sta[byte] = rng();
+        }
+
+        char decoy[64];
+        decoy_passphrase(idx, decoy);
+
+        const char* pmk = idx == *planted_idx ? (const char*)passphrase : decoy;
+        ::hash::generate_example(pmk, target.mac_ap, target.mac_sta, target.hash);
+    }
+
+    return job;
+}
+
+Entry measure(
+    const char* pattern,
+    const Config& config,
+    const Options& options,
+    topology::Pinning pinning,
+    bool weak,
+    u64 thread_count,
+    u64 max_threads) {
+    u128 keyspace = hash::keyspace((const u8*)pattern, strlen(pattern));
+
+    // Weak scaling keeps the candidates each thread checks before the hit constant.
+    f64 fraction = options.position;
+    if (weak)
+        fraction *= (f64)thread_count / (f64)max_threads;
+
+    // Keyspaces can exceed 2^64. Converting to f64 rounds them, so the result is clamped.
+    f64 planted = fraction * (f64)keyspace;
+    u128 position = keyspace - 1;
+    if (planted < (f64)keyspace && (u128)planted < position)
+        position = (u128)planted;
+
+    u8 passphrase[64];
+    position = candidate_at(pattern, position, passphrase);
+
+    u64 planted_idx;
+    Job job = make_job(pattern, options.target_count, passphrase, &planted_idx);
+
+    Config run_config = config;
+    run_config.thread_count = thread_count;
+    run_config.pinning = pinning;
+    run_config.time_limit = 0.0;
+    run_config.warmup = 0.0;
+    run_config.verbose = false;
+
+    Entry entry = Entry{
+        .pinning = pinning,
+        .weak = weak,
+        .position = position,
+        .result = run(job, run_config),
+        .efficiency = 0.0,
+    };
+
+    if (!entry.result.found || entry.result.target_idx != planted_idx)
+        error("the planted passphrase '%s' wasn't found\n", passphrase);
+
+    return entry;
+}
+
+void print_header() {
+    printf(
+        "  %-8s %-7s %7s %14s %12s %14s %11s\n",
+        "pinning",
+        "scaling",
+        "threads",
+        "position",
+        "time to hit",
+        "H/s",
+        "efficiency");
+}
+
+void print_row(const Entry& entry, u128 keyspace) {
+    printf(
+        "  %-8s %-7s %7lld %13.1f%% %11.3fs %14.1f %10.1f%%\n",
+        topology::pinning_name(entry.pinning),
+        entry.weak ? "weak" : "strong",
+        entry.result.thread_count,
+        (f64)entry.position * 100.0 / (f64)keyspace,
+        entry.result.seconds,
+        entry.result.rate,
+        entry.efficiency * 100.0);
+}
+
+void write_json(
+    const char* path,
+    const char* pattern,
+    const Options& options,
+    u128 keyspace,
+    const std::vector<Entry>& entries) {
+    FILE* file = fopen(path, "w");
+    if (!file)
+        error("failed to open '%s' for writing\n", path);
+
+    fprintf(file, "{\n");
+    benchmark::write_json_header(file, topology::discover());
+    fprintf(file, "  \"pattern\": %s,\n", benchmark::json_string(pattern).c_str());
+    fprintf(file, "  \"keyspace\": %s,\n", hash::to_string(keyspace).c_str());
+    fprintf(file, "  \"targets\": %lld,\n", options.target_count);
+
+    fprintf(file, "  \"runs\": [\n");
+    for (u64 idx = 0; idx < entries.size(); idx++) {
+        const Entry& entry = entries[idx];
+        fprintf(
+            file,
+            "    {\"pinning\": \"%s\", \"scaling\": \"%s\", \"threads\": %lld, "
+            "\"position\": %s, \"seconds_to_hit\": %.4f, \"hashes\": %lld, "
+            "\"hashes_per_second\": %.1f, \"efficiency\": %.4f, \"unpinned_threads\": %lld}%s\n",
+            topology::pinning_name(entry.pinning),
+            entry.weak ? "weak" : "strong",
+            entry.result.thread_count,
+            hash::to_string(entry.position).c_str(),
+            entry.result.seconds,
+            entry.result.hashes,
+            entry.result.rate,
+            entry.efficiency,
+            entry.result.unpinned_threads,
+            idx + 1 == entries.size() ? "" : ",");
+    }
+    fprintf(file, "  ]\n");
+
+    fprintf(file, "}\n");
+    fclose(file);
+}
+
+void main(const char* pattern, const Config& config, const Options& options) {
+    u64 len = strlen(pattern);
+    if (len == 0 || len > 63)
+        error("input patterns must be between 1 and 63 characters\n");
+
+    if (options.target_count == 0)
+        error("at least one target is needed\n");
+
+    if (options.position < 0.0 || options.position > 1.0)
+        error("the position must be a fraction of the keyspace between 0 and 1\n");
+
+    u128 keyspace = hash::keyspace((const u8*)pattern, len);
+    u64 max_threads = config.thread_count;
+    if (!max_threads)
+        max_threads = topology::default_thread_count(topology::discover(), config.smt);
+
+    std::vector<u64> thread_counts;
+    for (u64 threads = 1; threads < max_threads; threads *= 2)
+        thread_counts.push_back(threads);
+    thread_counts.push_back(max_threads);
+
+    printf(
+        "pattern '%s' (%s candidates), %lld targets, planted at %.1f%% of the keyspace\n\n",
+        pattern,
+        hash::to_string(keyspace).c_str(),
+        options.target_count,
+        options.position * 100.0);
+    print_header();
+
+    std::vector<Entry> entries;
+    u64 unpinned = 0;
+
+    for (topology::Pinning pinning : PINNINGS) {
+        for (bool weak : {false, true}) {
+            f64 base_seconds = 0.0;
+
+            for (u64 threads : thread_counts) {
+                Entry entry =
+                    measure(pattern, config, options, pinning, weak, threads, max_threads);
+
+                if (threads == 1)
+                    base_seconds = entry.result.seconds;
+
+                f64 seconds = entry.result.seconds;
+                if (seconds > 0.0)
+                    entry.efficiency = weak ? base_seconds / seconds
+                                            : base_seconds / (seconds * (f64)threads);
+
+                unpinned += entry.result.unpinned_threads;
+                entries.push_back(entry);
+                print_row(entry, keyspace);
+                fflush(stdout);
+            }
+        }
+    }
+
+    if (unpinned)
+        printf("\nsome threads couldn't be pinned, their runs used the OS scheduler instead\n");
+
+    if (options.json_path) {
+        write_json(options.json_path, pattern, options, keyspace, entries);
+        printf("\nwrote results to %s\n", options.json_path);
+    }
+}
+
+} // namespace cpu::scaling
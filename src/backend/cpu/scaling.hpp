@@ -0,0 +1,26 @@
+#pragma once
+
+#include "src/common.hpp"
+#include "src/backend/cpu/cpu.hpp"
+
+namespace cpu::scaling {
+
+struct Options {
+    // Targets per run, one of them has a passphrase that's in the keyspace.
+    u64 target_count = 1;
+
+    // Where the planted passphrase sits in the keyspace, as a fraction of it. With weak scaling
+    // this is the position at the largest thread count.
+    f64 position = 0.5;
+
+    // Where to write the results as JSON, nullptr to skip.
+    const char* json_path = nullptr;
+};
+
+// Plants a passphrase in a synthetic target set and measures how long the search for it takes
+// across thread counts and pinning policies, both for a fixed keyspace position (strong scaling)
+// and for one that grows with the thread count (weak scaling). The thread count of `config` is
+// used as the upper bound.
+void main(const char* pattern, const Config& config, const Options& options);
+
+} // namespace cpu::scaling
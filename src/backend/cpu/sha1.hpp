@@ -5,6 +5,7 @@
 * https://opensource.org/licenses/MIT
 ***/
 
+#include <stddef.h>
 #include <stdint.h>
 
 /* sha-1 compression function that takes an already expanded message, and additionally store intermediate states */
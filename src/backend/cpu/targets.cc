@@ -0,0 +1,167 @@
+#include "src/backend/cpu/targets.hpp"
+#include "src/backend/cpu/modes.hpp"
+#include "src/backend/cpu/topology.hpp"
+#include "src/common.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace cpu::targets {
+
+void pmkid_msg_init(u8 msg[20], const u8 mac_ap[6], const u8 mac_sta[6]) {
+    memcpy(msg, "PMK Name", 8);
+    memcpy(msg + 8, mac_ap, 6);
+    memcpy(msg + 14, mac_sta, 6);
+}
+
+void set_reject_word(Group* group, const lookup::Digest* digests) {
+    group->single = group->digest_count == 1;
+    group->reject_word = group->single ? digests[group->digest_offset].hash[3] : 0;
+}
+
+Table* new_table(const Job& job) {
+    Mode mode = job.mode;
+    i64 (*compare_targets)(const Target&, const Target&) = nullptr;
+    modes::dispatch(mode, [&](auto m) { compare_targets = decltype(m)::compare; });
+
+    // Visit targets grouped by ESSID, such that each PMK only gets derived once per candidate.
+    std::vector<u64> order(job.targets.size());
+    for (u64 idx = 0; idx < order.size(); idx++)
+        order[idx] = idx;
+
+    std::stable_sort(order.begin(), order.end(), [&](u64 a, u64 b) {
+        return compare_targets(job.targets[a], job.targets[b]) < 0;
+    });
+
+    u64 group_count = 0;
+    u64 eapol_count = 0;
+    for (u64 idx = 0; idx < order.size(); idx++) {
+        const Target& target = job.targets[order[idx]];
+        if (idx == 0 || compare_targets(job.targets[order[idx - 1]], target) != 0) {
+            group_count++;
+            eapol_count += target.kind == TargetKind::Eapol;
+        }
+
+        if (target.kind == TargetKind::Eapol &&
+            (mode != Mode::Passphrase || target.handshake_idx >= job.handshakes.size()))
+            error("EAPOL targets need passphrase mode and a handshake\n");
+        if (target.kind == TargetKind::PmkidSha256 && mode != Mode::Passphrase)
+            error("SHA-256 PMKID targets need passphrase mode\n");
+    }
+
+    auto* table = static_cast<Table*>(
+        topology::alloc_local(Table::size(group_count, order.size(), eapol_count)));
+    table->mode = mode;
+    table->group_count = group_count;
+    table->digest_count = order.size();
+    table->group_capacity = group_count;
+    table->digest_capacity = order.size();
+    table->eapol_count = eapol_count;
+
+    Group* groups = table->groups();
+    lookup::Digest* digests = table->digests();
+    kernels::Eapol* eapols = table->eapols();
+    Group* group = nullptr;
+    u64 eapol_idx = 0;
+
+    for (u64 idx = 0; idx < order.size(); idx++) {
+        const Target& target = job.targets[order[idx]];
+
+        if (idx == 0 || compare_targets(job.targets[order[idx - 1]], target) != 0) {
+            Group* prev = group;
+            group = group ? group + 1 : groups;
+
+            memcpy(group->essid, target.essid, sizeof(group->essid));
+            group->essid_len = target.essid_len;
+            group->new_essid = !prev || group->essid_len != prev->essid_len ||
+                               memcmp(group->essid, prev->essid, group->essid_len) != 0;
+
+            group->kind = target.kind;
+            pmkid_msg_init(group->msg, target.mac_ap, target.mac_sta);
+
+            if (target.kind == TargetKind::Eapol) {
+                const Handshake& handshake = job.handshakes[target.handshake_idx];
+                kernels::eapol_init(
+                    &eapols[eapol_idx],
+                    target.mac_ap,
+                    target.mac_sta,
+                    handshake.anonce,
+                    handshake.snonce,
+                    handshake.key_version,
+                    handshake.eapol,
+                    handshake.eapol_len);
+                group->eapol_idx = eapol_idx++;
+            }
+
+            group->digest_offset = idx;
+            group->digest_count = 0;
+        }
+
+        memcpy(digests[idx].hash, target.hash, sizeof(digests[idx].hash));
+        digests[idx].target_idx = order[idx];
+        group->digest_count++;
+    }
+
+    for (u64 idx = 0; idx < group_count; idx++) {
+        lookup::sort(&digests[groups[idx].digest_offset], groups[idx].digest_count);
+        set_reject_word(&groups[idx], digests);
+    }
+
+    return table;
+}
+
+void free_table(Table* table) {
+    topology::free_local(
+        table, Table::size(table->group_capacity, table->digest_capacity, table->eapol_count));
+}
+
+Retired::Retired(u64 target_count)
+    : flags(std::make_unique<std::atomic<bool>[]>(target_count)),
+      epoch(0),
+      remaining(target_count) {}
+
+bool retire(Retired* retired, u64 target_idx) {
+    if (retired->flags[target_idx].exchange(true))
+        return false;
+
+    // The flag is visible to every worker that sees the new epoch.
+    retired->remaining.fetch_sub(1);
+    retired->epoch.fetch_add(1, std::memory_order_release);
+    return true;
+}
+
+void compact(Table* table, const Retired& retired) {
+    Group* groups = table->groups();
+    lookup::Digest* digests = table->digests();
+    u64 group_count = 0;
+    u64 digest_count = 0;
+
+    // Digests stay sorted and only ever move towards the front, as do the groups.
+    for (u64 gdx = 0; gdx < table->group_count; gdx++) {
+        Group group = groups[gdx];
+        u64 offset = digest_count;
+
+        for (u64 idx = 0; idx < group.digest_count; idx++) {
+            const lookup::Digest& digest = digests[group.digest_offset + idx];
+            if (!retired.flags[digest.target_idx].load(std::memory_order_relaxed))
+                digests[digest_count++] = digest;
+        }
+
+        if (digest_count == offset)
+            continue;
+
+        const Group* prev = group_count ? &groups[group_count - 1] : nullptr;
+        group.new_essid = !prev || group.essid_len != prev->essid_len ||
+                          memcmp(group.essid, prev->essid, group.essid_len) != 0;
+        group.digest_offset = offset;
+        group.digest_count = digest_count - offset;
+        set_reject_word(&group, digests);
+        groups[group_count++] = group;
+    }
+
+    table->group_count = group_count;
+    table->digest_count = digest_count;
+}
+
+} // namespace cpu::targets
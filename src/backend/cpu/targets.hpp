@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+#include "src/common.hpp"
+#include "src/backend/cpu/cpu.hpp"
+#include "src/backend/cpu/kernels.hpp"
+#include "src/backend/cpu/lookup.hpp"
+
+namespace cpu::targets {
+
+// = "PMK Name" + mac_ap + mac_sta
+void pmkid_msg_init(u8 msg[20], const u8 mac_ap[6], const u8 mac_sta[6]);
+
+// PMKID targets that share the ESSID and MAC pair, so a single HMAC per candidate covers all of
+// them, or a single handshake. Groups of the same ESSID are adjacent, such that every kind of
+// target reuses the PMKs derived for the first one. Unsalted modes put every target in one group.
+struct Group {
+    u8 essid[32];
+    u64 essid_len;
+
+    // Whether the previous group used a different ESSID, so the PMKs need to be re-derived.
+    bool new_essid;
+
+    TargetKind kind;
+
+    // PMKID message, or the index of the handshake in the table's EAPOL array.
+    u8 msg[20];
+    u64 eapol_idx;
+
+    // Sorted range of the digests array.
+    u64 digest_offset;
+    u64 digest_count;
+
+    // Fourth digest word of a group's only target, which lets the SHA-1 PMKID kernels reject
+    // candidates before the last steps of the compression, see `kernels::pmkid`.
+    bool single;
+    u32 reject_word;
+};
+
+// The targets of a job, in the order the hot loop visits them. The groups follow right after it
+// in the same allocation, then the digests of every target and the handshakes of EAPOL targets.
+struct Table {
+    Mode mode;
+
+    // Groups and digests still searched, `compact` moves them to the front of their arrays.
+    u64 group_count;
+    u64 digest_count;
+
+    u64 group_capacity;
+    u64 digest_capacity;
+    u64 eapol_count;
+
+    Group* groups() {
+        return reinterpret_cast<Group*>(this + 1);
+    }
+
+    lookup::Digest* digests() {
+        return reinterpret_cast<lookup::Digest*>(groups() + group_capacity);
+    }
+
+    kernels::Eapol* eapols() {
+        return reinterpret_cast<kernels::Eapol*>(digests() + digest_capacity);
+    }
+
+    static u64 size(u64 group_count, u64 digest_count, u64 eapol_count) {
+        return sizeof(Table) + group_count * sizeof(Group) + digest_count * sizeof(lookup::Digest) +
+               eapol_count * sizeof(kernels::Eapol);
+    }
+};
+
+// Allocated with `topology::alloc_local`, so it should be called on the thread using the table.
+Table* new_table(const Job& job);
+void free_table(Table* table);
+
+// Targets cracked during a run, shared by every worker. Retiring a target is a flag and an epoch
+// bump, workers never lock or wait for each other: each keeps reading its own table and compacts
+// it once it sees a new epoch at a batch boundary, such that per-candidate work drops as targets
+// fall.
+struct Retired {
+    explicit Retired(u64 target_count);
+
+    std::unique_ptr<std::atomic<bool>[]> flags;
+    std::atomic<u64> epoch;
+    std::atomic<u64> remaining;
+};
+
+// Returns false if the target was retired already, e.g. by another worker hitting it in the same
+// batch.
+bool retire(Retired* retired, u64 target_idx);
+
+// Drops retired targets from a table. Groups without digests left cost nothing anymore, and PMKs
+// of an ESSID without groups left are no longer derived. Groups down to one target switch to the
+// early rejecting kernels.
+void compact(Table* table, const Retired& retired);
+
+// Hashes a batch of candidates against every target with the batch kernel of mode `M`, one of
+// `cpu::modes`, and calls `on_hit(candidate_idx, target_idx)` for each match. Returns false as
+// soon as `on_hit` does.
+template <typename M, typename F>
+bool check(kernels::Kernel kernel, Table* table, const u8 batch[][64], u64 count, F on_hit) {
+    u32 keys[kernels::MAX_LANES][8];
+    u32 hashes[kernels::MAX_LANES][5];
+
+    Group* groups = table->groups();
+    lookup::Digest* digests = table->digests();
+
+    for (u64 offset = 0; offset < count; offset += kernels::MAX_LANES) {
+        u64 n = count - offset < kernels::MAX_LANES ? count - offset : kernels::MAX_LANES;
+
+        for (u64 gdx = 0; gdx < table->group_count; gdx++) {
+            Group* group = &groups[gdx];
+            M::hash(kernel, table, *group, &batch[offset], n, keys, hashes);
+
+            for (u64 idx = 0; idx < n; idx++) {
+                const lookup::Digest* hit =
+                    lookup::find(&digests[group->digest_offset], group->digest_count, hashes[idx]);
+                if (hit && !on_hit(offset + idx, hit->target_idx))
+                    return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+} // namespace cpu::targets
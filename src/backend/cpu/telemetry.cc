@@ -0,0 +1,106 @@
+#include "src/backend/cpu/telemetry.hpp"
+#include "src/common.hpp"
+
+using namespace std::chrono;
+
+namespace cpu::telemetry {
+
+Reporter::Reporter(Counter* counters, u64 thread_count)
+    : counters(counters), thread_count(thread_count), last_hashes(thread_count, 0) {
+    start_time = steady_clock::now();
+    last_time = start_time;
+}
+
+Reporter::~Reporter() {
+    if (thread.joinable())
+        stop();
+}
+
+void Reporter::start(milliseconds interval, Callback on_sample) {
+    this->interval = interval;
+    this->on_sample = std::move(on_sample);
+
+    start_time = steady_clock::now();
+    last_time = start_time;
+    for (u64 idx = 0; idx < thread_count; idx++)
+        last_hashes[idx] = counters[idx].hashes.load(std::memory_order_relaxed);
+
+    thread = std::thread(&Reporter::run, this);
+}
+
+Snapshot Reporter::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_one();
+
+    if (thread.joinable())
+        thread.join();
+
+    // The interval rates of the final snapshot only cover the tail end of the run.
+    Snapshot snapshot = sample();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    last_snapshot = snapshot;
+    return snapshot;
+}
+
+Snapshot Reporter::latest() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return last_snapshot;
+}
+
+void Reporter::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (!cv.wait_for(lock, interval, [&] { return stopping; })) {
+        lock.unlock();
+
+        Snapshot snapshot = sample();
+        if (on_sample)
+            on_sample(snapshot);
+
+        lock.lock();
+        last_snapshot = std::move(snapshot);
+    }
+}
+
+Snapshot Reporter::sample() {
+    auto now = steady_clock::now();
+    f64 dt = duration<f64>(now - last_time).count();
+    f64 elapsed = duration<f64>(now - start_time).count();
+
+    Snapshot snapshot = Snapshot{
+        .elapsed = elapsed,
+        .total_hashes = 0,
+        .rate = 0.0,
+        .avg_rate = 0.0,
+        .thread_hashes = std::vector<u64>(thread_count, 0),
+        .thread_rates = std::vector<f64>(thread_count, 0.0),
+        .thread_avg_rates = std::vector<f64>(thread_count, 0.0),
+    };
+
+    for (u64 idx = 0; idx < thread_count; idx++) {
+        u64 hashes = counters[idx].hashes.load(std::memory_order_relaxed);
+        u64 delta = hashes - last_hashes[idx];
+        last_hashes[idx] = hashes;
+
+        snapshot.total_hashes += hashes;
+        snapshot.thread_hashes[idx] = hashes;
+        if (dt > 0.0)
+            snapshot.thread_rates[idx] = (f64)delta / dt;
+        if (elapsed > 0.0)
+            snapshot.thread_avg_rates[idx] = (f64)hashes / elapsed;
+
+        snapshot.rate += snapshot.thread_rates[idx];
+    }
+
+    if (elapsed > 0.0)
+        snapshot.avg_rate = (f64)snapshot.total_hashes / elapsed;
+
+    last_time = now;
+    return snapshot;
+}
+
+} // namespace cpu::telemetry
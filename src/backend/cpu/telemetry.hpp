@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "src/common.hpp"
+
+namespace cpu::telemetry {
+
+// Large enough for the 128-byte lines on Apple silicon and for the adjacent-line prefetcher on
+// x86, which pulls cache lines in pairs.
+constexpr u64 CACHE_LINE_SIZE = 128;
+
+// Each worker owns exactly one counter and is the only one writing to it, so it can publish with
+// a plain relaxed store instead of a read-modify-write on a shared line.
+struct alignas(CACHE_LINE_SIZE) Counter {
+    std::atomic<u64> hashes = 0;
+};
+
+struct Snapshot {
+    // Seconds since the reporter was started.
+    f64 elapsed;
+    u64 total_hashes;
+
+    // Hashes per second over the last interval and since the start.
+    f64 rate;
+    f64 avg_rate;
+
+    std::vector<u64> thread_hashes;
+    std::vector<f64> thread_rates;
+    std::vector<f64> thread_avg_rates;
+};
+
+// Reference cycles from the time stamp counter, or 0 on architectures without a usable one.
+inline u64 read_cycle_counter() {
+#if defined(__x86_64__)
+    return __builtin_ia32_rdtsc();
+#else
+    return 0;
+#endif
+}
+
+using Callback = std::function<void(const Snapshot&)>;
+
+// Periodically aggregates the per-thread counters on its own thread, such that workers never
+// have to do any synchronization or terminal I/O beyond publishing their own counter.
+struct Reporter {
+    Reporter(Counter* counters, u64 thread_count);
+    ~Reporter();
+
+    void start(std::chrono::milliseconds interval, Callback on_sample);
+
+    // Stops the reporter thread and returns a snapshot taken after all workers were joined.
+    Snapshot stop();
+
+    Snapshot latest();
+
+  private:
+    void run();
+    Snapshot sample();
+
+    Counter* counters;
+    u64 thread_count;
+
+    std::chrono::steady_clock::time_point start_time;
+    std::chrono::steady_clock::time_point last_time;
+    std::vector<u64> last_hashes;
+
+    std::chrono::milliseconds interval;
+    Callback on_sample;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopping = false;
+    Snapshot last_snapshot;
+    std::thread thread;
+};
+
+} // namespace cpu::telemetry
@@ -0,0 +1,470 @@
+#include "src/backend/cpu/topology.hpp"
+#include "src/common.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+#include <utility>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(__APPLE__)
+#include <sys/sysctl.h>
+#endif
+
+namespace cpu::topology {
+
+#if defined(__linux__)
+
+bool read_u32(const std::string& path, u32* out) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (!file)
+        return false;
+
+    bool ok = fscanf(file, "%u", out) == 1;
+    fclose(file);
+    return ok;
+}
+
+// Parses lists in the kernel's cpulist format, e.g. "0-3,8,10-11".
+std::vector<u32> read_cpulist(const std::string& path) {
+    std::vector<u32> cpus;
+
+    FILE* file = fopen(path.c_str(), "r");
+    if (!file)
+        return cpus;
+
+    char buf[4096];
+    if (!fgets(buf, sizeof(buf), file)) {
+        fclose(file);
+        return cpus;
+    }
+    fclose(file);
+
+    char* ptr = buf;
+    while (*ptr && *ptr != '\n') {
+        char* end;
+        u32 lo = strtoul(ptr, &end, 10);
+        if (end == ptr)
+            break;
+
+        u32 hi = lo;
+        if (*end == '-')
+            hi = strtoul(end + 1, &end, 10);
+
+        for (u32 cpu = lo; cpu <= hi; cpu++)
+            cpus.push_back(cpu);
+
+        ptr = (*end == ',') ? end + 1 : end;
+    }
+
+    return cpus;
+}
+
+std::string cpu_model() {
+    FILE* file = fopen("/proc/cpuinfo", "r");
+    if (!file)
+        return "unknown";
+
+    std::string model = "unknown";
+    char line[512];
+    while (fgets(line, sizeof(line), file)) {
+        if (strncmp(line, "model name", 10) != 0 && strncmp(line, "Model", 5) != 0)
+            continue;
+
+        char* value = strchr(line, ':');
+        if (!value)
+            continue;
+
+        value += strspn(value + 1, " \t") + 1;
+        value[strcspn(value, "\n")] = '\0';
+        model = value;
+        break;
+    }
+
+    fclose(file);
+    return model;
+}
+
+Topology discover() {
+    Topology topo = {};
+    topo.model = cpu_model();
+
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    bool have_mask = sched_getaffinity(0, sizeof(mask), &mask) == 0;
+
+    std::vector<u32> online = read_cpulist("/sys/devices/system/cpu/online");
+    if (online.empty())
+        for (u32 idx = 0; idx < std::thread::hardware_concurrency(); idx++)
+            online.push_back(idx);
+
+    // Map CPU ids to NUMA nodes.
+    std::map<u32, u32> cpu_node;
+    for (u32 node = 0; node < 1024; node++) {
+        std::string path = "/sys/devices/system/node/node" + std::to_string(node) + "/cpulist";
+        std::vector<u32> cpus = read_cpulist(path);
+        if (cpus.empty() && access(path.c_str(), F_OK) != 0)
+            break;
+
+        for (u32 cpu : cpus)
+            cpu_node[cpu] = node;
+    }
+
+    // Intel hybrid parts expose the core types as separate PMUs, other architectures (big.LITTLE)
+    // expose a relative capacity per CPU instead.
+    std::vector<u32> p_cores = read_cpulist("/sys/devices/cpu_core/cpus");
+    std::vector<u32> e_cores = read_cpulist("/sys/devices/cpu_atom/cpus");
+
+    u32 max_capacity = 0;
+    std::map<u32, u32> capacities;
+    for (u32 cpu : online) {
+        u32 capacity;
+        std::string path =
+            "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cpu_capacity";
+        if (read_u32(path, &capacity)) {
+            capacities[cpu] = capacity;
+            max_capacity = std::max(max_capacity, capacity);
+        }
+    }
+
+    std::map<std::pair<u32, u32>, u32> core_ids;
+    std::map<std::pair<u32, u32>, u32> core_threads;
+    std::map<u32, bool> packages;
+    std::map<u32, bool> nodes;
+
+    for (u32 id : online) {
+        if (have_mask && !CPU_ISSET(id, &mask))
+            continue;
+
+        std::string base = "/sys/devices/system/cpu/cpu" + std::to_string(id) + "/topology/";
+
+        u32 package = 0;
+        u32 core_id = id;
+        read_u32(base + "physical_package_id", &package);
+        read_u32(base + "core_id", &core_id);
+
+        auto key = std::make_pair(package, core_id);
+        if (core_ids.find(key) == core_ids.end()) {
+            u32 dense = core_ids.size();
+            core_ids[key] = dense;
+        }
+
+        CoreType type = CoreType::Unknown;
+        if (!p_cores.empty() || !e_cores.empty()) {
+            if (std::find(p_cores.begin(), p_cores.end(), id) != p_cores.end())
+                type = CoreType::Performance;
+            else if (std::find(e_cores.begin(), e_cores.end(), id) != e_cores.end())
+                type = CoreType::Efficiency;
+        } else if (capacities.size() == online.size()) {
+            bool uniform = std::all_of(capacities.begin(), capacities.end(), [&](auto& kv) {
+                return kv.second == max_capacity;
+            });
+            if (!uniform)
+                type = capacities[id] == max_capacity ? CoreType::Performance
+                                                      : CoreType::Efficiency;
+        }
+
+        Cpu cpu = Cpu{
+            .id = id,
+            .package = package,
+            .node = cpu_node.count(id) ? cpu_node[id] : 0,
+            .core = core_ids[key],
+            .smt_idx = core_threads[key]++,
+            .type = type,
+        };
+
+        packages[cpu.package] = true;
+        nodes[cpu.node] = true;
+        topo.cpus.push_back(cpu);
+    }
+
+    topo.packages = packages.size();
+    topo.nodes = nodes.size();
+    topo.cores = core_ids.size();
+
+    for (const Cpu& cpu : topo.cpus) {
+        if (cpu.type == CoreType::Performance)
+            topo.performance_cpus++;
+        else if (cpu.type == CoreType::Efficiency)
+            topo.efficiency_cpus++;
+    }
+
+    return topo;
+}
+
+// Returns the quota of the given cgroup directory in CPUs, or 0 if it isn't limited.
+f64 read_cgroup_quota(const std::string& dir) {
+    // cgroup v2: "<quota> <period>" or "max <period>".
+    FILE* file = fopen((dir + "/cpu.max").c_str(), "r");
+    if (file) {
+        char quota[32];
+        u64 period = 0;
+        bool ok = fscanf(file, "%31s %llu", quota, (unsigned long long*)&period) == 2;
+        fclose(file);
+
+        if (!ok || strcmp(quota, "max") == 0 || period == 0)
+            return 0.0;
+        return (f64)strtoull(quota, nullptr, 10) / (f64)period;
+    }
+
+    // cgroup v1: a quota of -1 means unlimited.
+    long long quota = -1;
+    u32 period = 0;
+    file = fopen((dir + "/cpu.cfs_quota_us").c_str(), "r");
+    if (file) {
+        if (fscanf(file, "%lld", &quota) != 1)
+            quota = -1;
+        fclose(file);
+    }
+
+    if (quota <= 0 || !read_u32(dir + "/cpu.cfs_period_us", &period) || period == 0)
+        return 0.0;
+
+    return (f64)quota / (f64)period;
+}
+
+u32 cpu_quota() {
+    FILE* file = fopen("/proc/self/cgroup", "r");
+    if (!file)
+        return 0;
+
+    // Lines look like "0::/some/path" for v2 and "4:cpu,cpuacct:/some/path" for v1.
+    std::vector<std::string> dirs;
+    char line[4096];
+    while (fgets(line, sizeof(line), file)) {
+        char* controllers = strchr(line, ':');
+        char* path = controllers ? strchr(controllers + 1, ':') : nullptr;
+        if (!path)
+            continue;
+
+        *path++ = '\0';
+        controllers++;
+        path[strcspn(path, "\n")] = '\0';
+
+        if (controllers[0] == '\0') {
+            dirs.push_back(std::string("/sys/fs/cgroup") + path);
+        } else if (strstr(controllers, "cpu") && !strstr(controllers, "cpuset")) {
+            dirs.push_back(std::string("/sys/fs/cgroup/") + controllers + path);
+            dirs.push_back(std::string("/sys/fs/cgroup/cpu") + path);
+        }
+    }
+    fclose(file);
+
+    // Any ancestor can impose a tighter limit. Inside a cgroup namespace the path is relative to
+    // the namespace root, so walking up eventually ends at the mount point.
+    f64 quota = 0.0;
+    for (std::string dir : dirs) {
+        while (true) {
+            f64 limit = read_cgroup_quota(dir);
+            if (limit > 0.0 && (quota == 0.0 || limit < quota))
+                quota = limit;
+
+            u64 slash = dir.find_last_of('/');
+            if (slash == std::string::npos || dir.size() <= strlen("/sys/fs/cgroup/"))
+                break;
+            dir.resize(slash);
+        }
+    }
+
+    if (quota == 0.0)
+        return 0;
+
+    return std::max<u32>(1, (u32)std::ceil(quota));
+}
+
+bool pin_current_thread(u32 cpu_id) {
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(cpu_id, &mask);
+    return pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask) == 0;
+}
+
+#elif defined(__APPLE__)
+
+u32 sysctl_u32(const char* name, u32 fallback) {
+    u32 value;
+    size_t size = sizeof(value);
+    if (sysctlbyname(name, &value, &size, nullptr, 0) != 0)
+        return fallback;
+    return value;
+}
+
+// macOS doesn't expose which logical CPU belongs to which core, nor does it allow pinning, so we
+// only reconstruct the counts.
+Topology discover() {
+    Topology topo = {};
+
+    char model[256];
+    size_t model_size = sizeof(model);
+    if (sysctlbyname("machdep.cpu.brand_string", model, &model_size, nullptr, 0) == 0)
+        topo.model = model;
+    else
+        topo.model = "unknown";
+
+    u32 logical = sysctl_u32("hw.logicalcpu", std::thread::hardware_concurrency());
+    u32 physical = sysctl_u32("hw.physicalcpu", logical);
+    u32 perf_levels = sysctl_u32("hw.nperflevels", 1);
+    u32 performance = sysctl_u32("hw.perflevel0.logicalcpu", logical);
+
+    for (u32 id = 0; id < logical; id++) {
+        CoreType type = CoreType::Unknown;
+        if (perf_levels > 1)
+            type = id < performance ? CoreType::Performance : CoreType::Efficiency;
+
+        topo.cpus.push_back(Cpu{
+            .id = id,
+            .package = 0,
+            .node = 0,
+            .core = id % physical,
+            .smt_idx = id / physical,
+            .type = type,
+        });
+    }
+
+    topo.packages = sysctl_u32("hw.packages", 1);
+    topo.nodes = 1;
+    topo.cores = physical;
+    if (perf_levels > 1) {
+        topo.performance_cpus = performance;
+        topo.efficiency_cpus = logical - performance;
+    }
+
+    return topo;
+}
+
+u32 cpu_quota() {
+    return 0;
+}
+
+bool pin_current_thread(u32 cpu_id) {
+    return false;
+}
+
+#else
+
+Topology discover() {
+    Topology topo = {};
+    topo.model = "unknown";
+
+    u32 logical = std::thread::hardware_concurrency();
+    for (u32 id = 0; id < logical; id++)
+        topo.cpus.push_back(Cpu{.id = id, .core = id, .type = CoreType::Unknown});
+
+    topo.packages = 1;
+    topo.nodes = 1;
+    topo.cores = logical;
+    return topo;
+}
+
+u32 cpu_quota() {
+    return 0;
+}
+
+bool pin_current_thread(u32 cpu_id) {
+    return false;
+}
+
+#endif
+
+bool parse_pinning(const char* str, Pinning* out) {
+    if (strcmp(str, "none") == 0)
+        *out = Pinning::None;
+    else if (strcmp(str, "compact") == 0)
+        *out = Pinning::Compact;
+    else if (strcmp(str, "scatter") == 0)
+        *out = Pinning::Scatter;
+    else
+        return false;
+
+    return true;
+}
+
+const char* pinning_name(Pinning pinning) {
+    switch (pinning) {
+        case Pinning::None:
+            return "none";
+        case Pinning::Compact:
+            return "compact";
+        case Pinning::Scatter:
+            return "scatter";
+    }
+
+    return "unknown";
+}
+
+std::vector<Cpu> placement(const Topology& topo, Pinning pinning, bool smt) {
+    std::vector<Cpu> cpus;
+    for (const Cpu& cpu : topo.cpus)
+        if (smt || cpu.smt_idx == 0)
+            cpus.push_back(cpu);
+
+    // Rank each core within its node, such that scatter can interleave nodes core by core.
+    std::map<u32, u32> node_rank;
+    std::map<u32, u32> core_rank;
+    for (const Cpu& cpu : cpus)
+        if (core_rank.find(cpu.core) == core_rank.end())
+            core_rank[cpu.core] = node_rank[cpu.node]++;
+
+    auto type_rank = [](CoreType type) { return type == CoreType::Efficiency ? 1 : 0; };
+
+    std::stable_sort(cpus.begin(), cpus.end(), [&](const Cpu& a, const Cpu& b) {
+        if (type_rank(a.type) != type_rank(b.type))
+            return type_rank(a.type) < type_rank(b.type);
+
+        if (pinning == Pinning::Compact) {
+            if (a.node != b.node)
+                return a.node < b.node;
+            if (a.core != b.core)
+                return a.core < b.core;
+            return a.smt_idx < b.smt_idx;
+        }
+
+        if (a.smt_idx != b.smt_idx)
+            return a.smt_idx < b.smt_idx;
+        if (core_rank.at(a.core) != core_rank.at(b.core))
+            return core_rank.at(a.core) < core_rank.at(b.core);
+        return a.node < b.node;
+    });
+
+    return cpus;
+}
+
+u64 default_thread_count(const Topology& topo, bool smt) {
+    u64 count = placement(topo, Pinning::None, smt).size();
+
+    // Inside containers the affinity mask usually still covers the whole host, only the quota
+    // tells us how much CPU time we'll actually get.
+    u32 quota = cpu_quota();
+    if (quota && quota < count)
+        count = quota;
+
+    return count ? count : 1;
+}
+
+void* alloc_local(u64 size) {
+    void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED)
+        error("failed to allocate %lld bytes of thread local memory\n", size);
+
+    // Fresh anonymous pages get placed on the node of the thread that first writes to them.
+    u64 page_size = sysconf(_SC_PAGESIZE);
+    for (u64 offset = 0; offset < size; offset += page_size)
+        static_cast<volatile u8*>(ptr)[offset] = 0;
+
+    return ptr;
+}
+
+void free_local(void* ptr, u64 size) {
+    munmap(ptr, size);
+}
+
+} // namespace cpu::topology
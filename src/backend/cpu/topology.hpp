@@ -0,0 +1,77 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "src/common.hpp"
+
+namespace cpu::topology {
+
+enum class CoreType {
+    Unknown,
+    Performance,
+    Efficiency,
+};
+
+struct Cpu {
+    // Logical CPU id as used by the OS.
+    u32 id;
+    u32 package;
+    u32 node;
+
+    // Dense physical core index, unique across packages.
+    u32 core;
+
+    // Position among the SMT siblings of the core, 0 for the first hardware thread.
+    u32 smt_idx;
+
+    CoreType type;
+};
+
+struct Topology {
+    std::string model;
+
+    // Only the CPUs this process is allowed to run on.
+    std::vector<Cpu> cpus;
+
+    u32 packages;
+    u32 nodes;
+    u32 cores;
+    u32 performance_cpus;
+    u32 efficiency_cpus;
+};
+
+enum class Pinning {
+    // Leave placement to the OS scheduler.
+    None,
+    // Fill one NUMA node (including SMT siblings) before moving to the next.
+    Compact,
+    // Round robin over NUMA nodes and physical cores, SMT siblings last.
+    Scatter,
+};
+
+Topology discover();
+
+// Returns the CPU quota of the cgroup this process runs in, rounded up to whole CPUs, or 0 if
+// there is no quota. Both cgroup v2 `cpu.max` and the v1 CFS quota are supported.
+u32 cpu_quota();
+
+bool parse_pinning(const char* str, Pinning* out);
+const char* pinning_name(Pinning pinning);
+
+// Returns the CPU each thread should run on, in thread order. Performance cores are always
+// preferred over efficiency cores. Without `smt`, only the first hardware thread of each
+// physical core is used.
+std::vector<Cpu> placement(const Topology& topo, Pinning pinning, bool smt);
+
+// Threads to run when none were requested: one per placed CPU, bounded by the CPU quota.
+u64 default_thread_count(const Topology& topo, bool smt);
+
+bool pin_current_thread(u32 cpu_id);
+
+// Allocates zeroed, page-aligned memory whose pages are first touched by the calling thread, such
+// that a pinned thread gets memory from its own NUMA node.
+void* alloc_local(u64 size);
+void free_local(void* ptr, u64 size);
+
+} // namespace cpu::topology
@@ -0,0 +1,146 @@
+#include "src/backend/cpu/trace.hpp"
+#include "src/common.hpp"
+
+using namespace std::chrono;
+
+namespace cpu::trace {
+
+const milliseconds FLUSH_INTERVAL = 20ms;
+
+const char* span_name(Span span) {
+    switch (span) {
+        case Span::Stride:
+            return "stride";
+        case Span::Generate:
+            return "generate";
+        case Span::Check:
+            return "check";
+        case Span::Compact:
+            return "compact";
+        case Span::Park:
+            return "park";
+        case Span::Hit:
+            return "hit";
+    }
+
+    return "unknown";
+}
+
+const char* arg_name(Span span) {
+    switch (span) {
+        case Span::Stride:
+        case Span::Generate:
+        case Span::Check:
+            return "candidates";
+        case Span::Compact:
+            return "remaining_targets";
+        case Span::Park:
+            return "running_threads";
+        case Span::Hit:
+            return "target";
+    }
+
+    return "arg";
+}
+
+Tracer::Tracer(const char* path, const std::vector<std::string>& thread_names) {
+    file = fopen(path, "w");
+    if (!file)
+        error("failed to open trace file '%s'\n", path);
+
+    origin = now();
+    for (const std::string& name : thread_names) {
+        buffers.push_back(std::make_unique<Buffer>());
+        buffers.back()->name = name;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+    for (u64 idx = 0; idx < buffers.size(); idx++) {
+        fprintf(
+            file,
+            "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %lld, "
+            "\"args\": {\"name\": \"%s\"}}",
+            written++ ? ",\n" : "",
+            idx,
+            buffers[idx]->name.c_str());
+    }
+}
+
+Tracer::~Tracer() {
+    if (file)
+        stop();
+}
+
+void Tracer::start() {
+    thread = std::thread(&Tracer::run, this);
+}
+
+void Tracer::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_one();
+
+    if (thread.joinable())
+        thread.join();
+
+    flush();
+
+    // Threads that recorded faster than we flushed lost events, the trace says how many.
+    for (u64 idx = 0; idx < buffers.size(); idx++) {
+        u64 dropped = buffers[idx]->dropped.load(std::memory_order_relaxed);
+        if (dropped)
+            fprintf(
+                file,
+                ",\n{\"name\": \"dropped\", \"ph\": \"i\", \"s\": \"t\", \"pid\": 1, "
+                "\"tid\": %lld, \"ts\": 0, \"args\": {\"events\": %lld}}",
+                idx,
+                dropped);
+    }
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    file = nullptr;
+}
+
+void Tracer::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (!cv.wait_for(lock, FLUSH_INTERVAL, [&] { return stopping; })) {
+        lock.unlock();
+        flush();
+        lock.lock();
+    }
+}
+
+void Tracer::flush() {
+    for (u64 idx = 0; idx < buffers.size(); idx++) {
+        Buffer* buffer = buffers[idx].get();
+        u64 head = buffer->head.load(std::memory_order_acquire);
+        u64 tail = buffer->tail.load(std::memory_order_relaxed);
+
+        for (; tail < head; tail++) {
+            const Event& event = buffer->events[tail % Buffer::CAPACITY];
+
+            // Complete events, timestamps in microseconds.
+            fprintf(
+                file,
+                "%s{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %lld, \"ts\": %.3f, "
+                "\"dur\": %.3f, \"args\": {\"%s\": %lld}}",
+                written++ ? ",\n" : "",
+                span_name(event.span),
+                idx,
+                (f64)(event.start - origin) / 1000.0,
+                (f64)(event.end - event.start) / 1000.0,
+                arg_name(event.span),
+                event.arg);
+        }
+
+        buffer->tail.store(tail, std::memory_order_release);
+    }
+
+    fflush(file);
+}
+
+} // namespace cpu::trace
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/common.hpp"
+#include "src/backend/cpu/telemetry.hpp"
+
+namespace cpu::trace {
+
+// What a thread spent its time on, the names end up in the trace.
+enum class Span : u32 {
+    // A worker's run through one stride of candidates, see `Config::stride`.
+    Stride,
+    // Enumerating a batch of candidates.
+    Generate,
+    // Hashing a batch and looking up the digests, the kernels interleave both per target group.
+    Check,
+    // Dropping cracked targets from a worker's table.
+    Compact,
+    // A background worker waiting for a slot.
+    Park,
+    // The reporter appending a hit to the potfile and printing it.
+    Hit,
+};
+
+struct Event {
+    // Nanoseconds on the steady clock.
+    u64 start;
+    u64 end;
+
+    // Candidates, targets or the target index, depending on the span.
+    u64 arg;
+    Span span;
+};
+
+inline u64 now() {
+    return (u64)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Single-producer single-consumer ring of a single thread's events. Recording is a store of the
+// event and a release store of `head`; when the flusher falls behind, events are dropped rather
+// than making the thread wait.
+struct Buffer {
+    static constexpr u64 CAPACITY = 1 << 14;
+
+    void record(Span span, u64 start, u64 end, u64 arg) {
+        u64 pos = head.load(std::memory_order_relaxed);
+        if (pos - tail.load(std::memory_order_acquire) >= CAPACITY) {
+            dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return;
+        }
+
+        events[pos % CAPACITY] = Event{.start = start, .end = end, .arg = arg, .span = span};
+        head.store(pos + 1, std::memory_order_release);
+    }
+
+    // Only the owning thread writes `head` and `dropped`, only the flusher writes `tail`.
+    alignas(telemetry::CACHE_LINE_SIZE) std::atomic<u64> head = 0;
+    std::atomic<u64> dropped = 0;
+    alignas(telemetry::CACHE_LINE_SIZE) std::atomic<u64> tail = 0;
+
+    std::string name;
+    Event events[CAPACITY];
+};
+
+// Writes the events of every buffer to a Chrome/Perfetto trace-event JSON file from a background
+// thread, load it in chrome://tracing or ui.perfetto.dev. Each buffer is a thread of the trace.
+struct Tracer {
+    Tracer(const char* path, const std::vector<std::string>& thread_names);
+    ~Tracer();
+
+    Buffer* buffer(u64 idx) {
+        return buffers[idx].get();
+    }
+
+    void start();
+
+    // Writes the remaining events and closes the file, the recording threads must be done.
+    void stop();
+
+  private:
+    void run();
+    void flush();
+
+    FILE* file;
+    u64 origin;
+    u64 written = 0;
+    std::vector<std::unique_ptr<Buffer>> buffers;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopping = false;
+    std::thread thread;
+};
+
+} // namespace cpu::trace
@@ -0,0 +1,329 @@
+#include "src/backend/cpu/tuning.hpp"
+#include "src/backend/cpu/benchmark.hpp"
+#include "src/backend/cpu/hash.hpp"
+#include "src/backend/cpu/modes.hpp"
+#include "src/common.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace cpu::tuning {
+
+// Per configuration, a calibration measures about a dozen.
+const f64 WARMUP = 0.1;
+const f64 DURATION = 0.4;
+
+// A configuration has to beat the current one by this much to replace it, the rest is noise.
+const f64 MIN_GAIN = 1.02;
+
+const u64 STRIDES[] = {1 << 12, 1 << 14, 1 << 16, 1 << 18, 1 << 20};
+
+std::string default_path() {
+    std::string dir;
+    if (const char* cache = getenv("XDG_CACHE_HOME"); cache && *cache)
+        dir = cache;
+    else if (const char* home = getenv("HOME"); home && *home)
+        dir = std::string(home) + "/.cache";
+    else
+        return "metaling-tuning.tsv";
+
+    return dir + "/metaling/tuning.tsv";
+}
+
+std::string hostname() {
+    char name[256] = {0};
+    gethostname(name, sizeof(name) - 1);
+    return name;
+}
+
+std::vector<std::string> split_tabs(const std::string& line) {
+    std::vector<std::string> fields;
+    u64 start = 0;
+    while (true) {
+        u64 end = line.find('\t', start);
+        fields.push_back(line.substr(start, end == std::string::npos ? end : end - start));
+        if (end == std::string::npos)
+            return fields;
+        start = end + 1;
+    }
+}
+
+// Host name, CPU model and CPU count, tabs in the model are replaced.
+std::string host_key(const topology::Topology& topo) {
+    std::string model = topo.model;
+    for (char& chr : model)
+        if (chr == '\t' || chr == '\n')
+            chr = ' ';
+
+    return hostname() + "\t" + model + "\t" + std::to_string(topo.cpus.size());
+}
+
+std::vector<std::string> read_lines(const std::string& path) {
+    std::vector<std::string> lines;
+    FILE* file = fopen(path.c_str(), "r");
+    if (!file)
+        return lines;
+
+    char buffer[1024];
+    while (fgets(buffer, sizeof(buffer), file)) {
+        std::string line = buffer;
+        if (!line.empty() && line.back() == '\n')
+            line.pop_back();
+        lines.push_back(line);
+    }
+
+    fclose(file);
+    return lines;
+}
+
+bool load(const std::string& path, const topology::Topology& topo, Mode mode, Tuning* out) {
+    std::string prefix = host_key(topo) + "\t" + modes::name(mode) + "\t";
+
+    for (const std::string& line : read_lines(path)) {
+        if (line.compare(0, prefix.size(), prefix) != 0)
+            continue;
+
+        // Kernel, SMT, threads, stride, rate and cancellation latency follow the key.
+        std::vector<std::string> fields = split_tabs(line.substr(prefix.size()));
+        if (fields.size() != 6)
+            continue;
+
+        Tuning tuning;
+        if (!kernels::parse(fields[0].c_str(), &tuning.kernel) ||
+            !kernels::available(tuning.kernel))
+            continue;
+
+        tuning.smt = fields[1] == "smt";
+        tuning.thread_count = strtoull(fields[2].c_str(), nullptr, 10);
+        tuning.stride = strtoull(fields[3].c_str(), nullptr, 10);
+        tuning.rate = strtod(fields[4].c_str(), nullptr);
+        tuning.cancel_latency = strtod(fields[5].c_str(), nullptr);
+        if (!tuning.thread_count || !hash::valid_stride(tuning.stride))
+            continue;
+
+        *out = tuning;
+        return true;
+    }
+
+    return false;
+}
+
+bool store(
+    const std::string& path,
+    const topology::Topology& topo,
+    Mode mode,
+    const Tuning& tuning) {
+    // The cache directory and its parent, e.g. `~/.cache/metaling`.
+    u64 slash = path.rfind('/');
+    if (slash != std::string::npos && slash > 0) {
+        std::string dir = path.substr(0, slash);
+        u64 parent = dir.rfind('/');
+        if (parent != std::string::npos && parent > 0)
+            mkdir(dir.substr(0, parent).c_str(), 0755);
+        mkdir(dir.c_str(), 0755);
+    }
+
+    std::string prefix = host_key(topo) + "\t" + modes::name(mode) + "\t";
+    std::vector<std::string> lines;
+    for (const std::string& line : read_lines(path))
+        if (line.compare(0, prefix.size(), prefix) != 0)
+            lines.push_back(line);
+
+    char settings[256];
+    snprintf(
+        settings,
+        sizeof(settings),
+        "%s\t%s\t%lld\t%lld\t%.1f\t%.4f",
+        kernels::name(tuning.kernel),
+        tuning.smt ? "smt" : "no-smt",
+        tuning.thread_count,
+        tuning.stride,
+        tuning.rate,
+        tuning.cancel_latency);
+    lines.push_back(prefix + settings);
+
+    // Unique in the same directory, such that concurrent calibrations don't write the same file
+    // and the rename stays atomic.
+    std::string tmp_path = path + ".XXXXXX";
+    int fd = mkstemp(tmp_path.data());
+    if (fd < 0)
+        return false;
+
+    FILE* file = fdopen(fd, "w");
+    if (!file) {
+        close(fd);
+        unlink(tmp_path.c_str());
+        return false;
+    }
+
+    fchmod(fd, 0644);
+    for (const std::string& line : lines)
+        fprintf(file, "%s\n", line.c_str());
+
+    bool written = !ferror(file);
+    if (fclose(file) != 0 || !written || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        unlink(tmp_path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+void print(const Tuning& tuning) {
+    printf(
+        "%s, %lld threads, smt %s, stride %lld: %.1f KH/s, stops in %.1f ms\n",
+        kernels::name(tuning.kernel),
+        tuning.thread_count,
+        tuning.smt ? "on" : "off",
+        tuning.stride,
+        tuning.rate / 1000.0,
+        tuning.cancel_latency * 1000.0);
+}
+
+void measure(const Job& job, const Config& base, Tuning* tuning) {
+    Config config = base;
+    config.kernel = tuning->kernel;
+    config.smt = tuning->smt;
+    config.thread_count = tuning->thread_count;
+    config.stride = tuning->stride;
+    config.time_limit = WARMUP + DURATION;
+    config.warmup = WARMUP;
+    config.verbose = false;
+
+    // Nothing of the real run is touched.
+    config.potfile_path = nullptr;
+    config.on_hit = nullptr;
+    config.on_progress = nullptr;
+    config.cancel = nullptr;
+    config.metrics_path = nullptr;
+    config.prometheus_path = nullptr;
+    config.trace_path = nullptr;
+    config.perf_report = false;
+    config.pool = nullptr;
+
+    Result result = run(job, config);
+    tuning->rate = result.rate;
+    tuning->cancel_latency = result.cancel_latency;
+
+    if (base.verbose) {
+        printf("  ");
+        print(*tuning);
+    }
+}
+
+bool better(const Tuning& a, const Tuning& b) {
+    bool a_stops = a.cancel_latency <= MAX_CANCEL_LATENCY;
+    bool b_stops = b.cancel_latency <= MAX_CANCEL_LATENCY;
+    if (a_stops != b_stops)
+        return a_stops;
+    return a.rate > b.rate * MIN_GAIN;
+}
+
+Tuning calibrate(Mode mode, const Config& config, const topology::Topology& topo) {
+    Job job = benchmark::make_job(mode, 1);
+
+    auto thread_count = [&](bool smt) {
+        Config placed = config;
+        placed.smt = smt;
+        placed.verbose = false;
+        return (u64)worker_cpus(placed, topo).size();
+    };
+
+    Tuning best = Tuning{
+        .kernel = config.kernel,
+        .smt = config.smt,
+        .thread_count = thread_count(config.smt),
+        .stride = config.stride ? config.stride : hash::STRIDE,
+        .rate = 0.0,
+        .cancel_latency = 0.0,
+    };
+    measure(job, config, &best);
+
+    auto consider = [&](Tuning candidate) {
+        measure(job, config, &candidate);
+        if (better(candidate, best))
+            best = candidate;
+    };
+
+    for (kernels::Kernel kernel : kernels::ALL) {
+        if (kernels::available(kernel) && kernel != best.kernel) {
+            Tuning candidate = best;
+            candidate.kernel = kernel;
+            consider(candidate);
+        }
+    }
+
+    // Without SMT siblings both settings place the same threads.
+    bool has_smt = topo.cores && topo.cores < topo.cpus.size();
+    for (bool smt : {true, false}) {
+        if (!has_smt && smt != best.smt)
+            continue;
+
+        // One thread fewer leaves a core to the reporter and the OS.
+        u64 threads = thread_count(smt);
+        for (u64 count : {threads, threads - 1}) {
+            if (!count || (count != threads && (config.thread_count || threads <= 2)))
+                continue;
+            if (smt == best.smt && count == best.thread_count)
+                continue;
+
+            Tuning candidate = best;
+            candidate.smt = smt;
+            candidate.thread_count = count;
+            consider(candidate);
+        }
+    }
+
+    for (u64 stride : STRIDES) {
+        if (!config.stride && stride != best.stride) {
+            Tuning candidate = best;
+            candidate.stride = stride;
+            consider(candidate);
+        }
+    }
+
+    return best;
+}
+
+void apply(Mode mode, const char* path, Config* config) {
+    std::string file = path ? path : default_path();
+    topology::Topology topo = topology::discover();
+
+    Tuning tuning;
+    if (load(file, topo, mode, &tuning)) {
+        if (config->verbose) {
+            printf("tuning of %s mode from %s: ", modes::name(mode), file.c_str());
+            print(tuning);
+        }
+    } else {
+        if (config->verbose)
+            printf(
+                "calibrating %s mode, the result is cached in %s\n",
+                modes::name(mode),
+                file.c_str());
+
+        tuning = calibrate(mode, *config, topo);
+        if (!store(file, topo, mode, tuning))
+            printf(
+                "failed to cache the tuning in %s, the next run calibrates again\n",
+                file.c_str());
+
+        if (config->verbose) {
+            printf("picked ");
+            print(tuning);
+        }
+    }
+
+    config->kernel = tuning.kernel;
+    config->smt = tuning.smt;
+    if (!config->thread_count)
+        config->thread_count = tuning.thread_count;
+    if (!config->stride)
+        config->stride = tuning.stride;
+}
+
+} // namespace cpu::tuning
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+
+#include "src/common.hpp"
+#include "src/backend/cpu/cpu.hpp"
+#include "src/backend/cpu/kernels.hpp"
+#include "src/backend/cpu/topology.hpp"
+
+namespace cpu::tuning {
+
+// The settings a calibration picked for one mode on one host.
+struct Tuning {
+    kernels::Kernel kernel;
+    bool smt;
+    u64 thread_count;
+    u64 stride;
+
+    // Measured with these settings, hashes per second and seconds from a stop to the return.
+    f64 rate;
+    f64 cancel_latency;
+};
+
+// Configurations that take longer than this to stop are only picked if all of them do.
+constexpr f64 MAX_CANCEL_LATENCY = 0.1;
+
+// `$XDG_CACHE_HOME/metaling/tuning.tsv`, or the same under `~/.cache`.
+std::string default_path();
+
+// Tab separated lines of host name, CPU model, CPU count, mode and the settings. Entries of other
+// hosts or with kernels this build doesn't have are ignored.
+bool load(const std::string& path, const topology::Topology& topo, Mode mode, Tuning* out);
+
+// Replaces the entry of the host and mode, the file is swapped in whole. Returns false if it
+// can't be written.
+bool store(
+    const std::string& path,
+    const topology::Topology& topo,
+    Mode mode,
+    const Tuning& tuning);
+
+// Measures short runs of `mode` on never-matching targets, first every kernel, then SMT and thread
+// counts on the fastest one and then strides, keeping the fastest configuration that stops within
+// `MAX_CANCEL_LATENCY`. Thread counts and strides are only varied if `config` doesn't fix them.
+Tuning calibrate(Mode mode, const Config& config, const topology::Topology& topo);
+
+// Applies the cached tuning of `mode` to `config`, calibrating and caching it first if there is
+// none. A thread count or stride that `config` fixes is kept. `path` may be null for
+// `default_path`.
+void apply(Mode mode, const char* path, Config* config);
+
+} // namespace cpu::tuning
@@ -0,0 +1,174 @@
+#include "src/metaling.h"
+#include "src/backend/cpu/cpu.hpp"
+#include "src/backend/cpu/kernels.hpp"
+#include "src/backend/cpu/modes.hpp"
+#include "src/backend/cpu/targets.hpp"
+#include "src/backend/cpu/topology.hpp"
+#include "src/common.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+// Fewer candidates than this per thread aren't worth starting a thread for.
+const u64 MIN_CANDIDATES_PER_THREAD = 4096;
+
+struct metaling_engine {
+    cpu::kernels::Kernel kernel;
+    u64 thread_count;
+    cpu::targets::Table* table;
+};
+
+thread_local char last_error[256] = "";
+
+void set_last_error(const char* fmt, const char* arg = "") {
+    snprintf(last_error, sizeof(last_error), fmt, arg);
+}
+
+uint32_t metaling_abi_version(void) {
+    return METALING_ABI_VERSION;
+}
+
+metaling_engine* metaling_create(
+    metaling_mode mode,
+    const metaling_target* targets,
+    uint64_t target_count,
+    const char* kernel,
+    uint32_t thread_count) {
+    // The engine calls `error` on invalid input, which exits, so everything is checked up front.
+    if (mode != METALING_MODE_PMK && mode != METALING_MODE_PASSPHRASE) {
+        set_last_error("unknown mode");
+        return nullptr;
+    }
+
+    if (!targets || target_count == 0) {
+        set_last_error("no targets to check");
+        return nullptr;
+    }
+
+    cpu::kernels::Kernel selected = cpu::kernels::best();
+    if (kernel && !cpu::kernels::parse(kernel, &selected)) {
+        set_last_error("unknown kernel '%s'", kernel);
+        return nullptr;
+    }
+
+    if (!cpu::kernels::available(selected)) {
+        set_last_error("kernel '%s' is not supported on this cpu", cpu::kernels::name(selected));
+        return nullptr;
+    }
+
+    cpu::Job job = cpu::Job{
+        .pattern = "",
+        .mode = mode == METALING_MODE_PMK ? cpu::Mode::Pmk : cpu::Mode::Passphrase,
+        .targets = std::vector<cpu::Target>(target_count),
+    };
+
+    for (u64 idx = 0; idx < target_count; idx++) {
+        const metaling_target& src = targets[idx];
+        cpu::Target& dst = job.targets[idx];
+
+        if (src.essid_len > sizeof(src.essid)) {
+            set_last_error("essid is longer than 32 bytes");
+            return nullptr;
+        }
+
+        memcpy(dst.essid, src.essid, sizeof(dst.essid));
+        dst.essid_len = src.essid_len;
+        memcpy(dst.mac_ap, src.mac_ap, sizeof(dst.mac_ap));
+        memcpy(dst.mac_sta, src.mac_sta, sizeof(dst.mac_sta));
+        memcpy(dst.hash, src.hash, sizeof(dst.hash));
+    }
+
+    auto* engine = new metaling_engine;
+    engine->kernel = selected;
+    engine->thread_count = thread_count;
+    if (!engine->thread_count)
+        engine->thread_count =
+            cpu::topology::default_thread_count(cpu::topology::discover(), true);
+    engine->table = cpu::targets::new_table(job);
+
+    return engine;
+}
+
+void metaling_destroy(metaling_engine* engine) {
+    if (!engine)
+        return;
+
+    cpu::targets::free_table(engine->table);
+    delete engine;
+}
+
+uint64_t metaling_check(
+    metaling_engine* engine,
+    const uint8_t* candidates,
+    uint64_t count,
+    metaling_hit* hits,
+    uint64_t max_hits) {
+    auto* batch = reinterpret_cast<const u8(*)[METALING_CANDIDATE_SIZE]>(candidates);
+
+    u64 thread_count = count / MIN_CANDIDATES_PER_THREAD;
+    if (thread_count > engine->thread_count)
+        thread_count = engine->thread_count;
+
+    // The mode is resolved once per call, the batch is hashed by its specialised loop.
+    auto check = [&](const u8(*slice)[METALING_CANDIDATE_SIZE], u64 len, auto on_hit) {
+        cpu::modes::dispatch(engine->table->mode, [&](auto m) {
+            cpu::targets::check<decltype(m)>(engine->kernel, engine->table, slice, len, on_hit);
+        });
+    };
+
+    // Small batches are hashed on the calling thread, writing hits straight to the caller.
+    if (thread_count <= 1) {
+        u64 hit_count = 0;
+        check(batch, count, [&](u64 idx, u64 target) {
+            if (hit_count < max_hits)
+                hits[hit_count] = metaling_hit{.candidate_idx = idx, .target_idx = target};
+            hit_count++;
+            return true;
+        });
+
+        return hit_count;
+    }
+
+    // Slices are multiples of the widest kernel, such that no call gets partially filled lanes.
+    const u64 lanes = cpu::kernels::MAX_LANES;
+    u64 slice = (count + thread_count - 1) / thread_count;
+    slice = (slice + lanes - 1) / lanes * lanes;
+
+    std::vector<std::vector<metaling_hit>> thread_hits(thread_count);
+    std::vector<std::thread> threads;
+
+    for (u64 tdx = 0; tdx < thread_count; tdx++) {
+        u64 start = tdx * slice;
+        if (start >= count)
+            break;
+        u64 len = count - start < slice ? count - start : slice;
+
+        threads.emplace_back([=, &thread_hits]() {
+            std::vector<metaling_hit>& out = thread_hits[tdx];
+            check(&batch[start], len, [&](u64 idx, u64 target) {
+                out.push_back(metaling_hit{.candidate_idx = start + idx, .target_idx = target});
+                return true;
+            });
+        });
+    }
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    u64 hit_count = 0;
+    for (const std::vector<metaling_hit>& out : thread_hits) {
+        for (const metaling_hit& hit : out) {
+            if (hit_count < max_hits)
+                hits[hit_count] = hit;
+            hit_count++;
+        }
+    }
+
+    return hit_count;
+}
+
+const char* metaling_last_error(void) {
+    return last_error;
+}
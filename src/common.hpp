@@ -1,20 +1,21 @@
 #pragma once
 
-#include <Metal/Metal.hpp>
 #include <cstdint>
 
 typedef uint8_t u8;
 typedef uint16_t u16;
 typedef uint32_t u32;
-typedef uint64_t u64;
+// `long long` on every platform, such that `%lld` can print it.
+typedef unsigned long long u64;
+// Keyspace indices, which outgrow 64 bits at around ten printable characters.
+typedef unsigned __int128 u128;
 
 typedef int8_t i8;
 typedef int16_t i16;
 typedef int32_t i32;
-typedef int64_t i64;
+typedef long long i64;
 
 typedef float f32;
 typedef double f64;
 
 void error(const char* fmt, ...);
-void error_metal(NS::Error* err, const char* fmt, ...);
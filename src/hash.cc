@@ -1,3 +1,4 @@
+#include <cstring>
 #include <iomanip>
 #include <string_view>
 #include <sstream>
@@ -1,9 +1,18 @@
 #include <cassert>
+#include <cstdlib>
 #include <cstring>
 
 #include "common.hpp"
+#include "backend/cpu/benchmark.hpp"
 #include "backend/cpu/cpu.hpp"
+#include "backend/cpu/daemon.hpp"
+#include "backend/cpu/hash.hpp"
+#include "backend/cpu/modes.hpp"
+#include "backend/cpu/scaling.hpp"
+
+#if defined(METALING_METAL)
 #include "backend/metal/metal.hpp"
+#endif
 
 namespace tests {
     void run();
@@ -13,8 +22,34 @@ const char* HELP = "failed to provide pattern, usage:\n"
                    "./metaling --test\n"
                    "           --help\n"
                    "           --backend cpu | metal\n"
+                   "           --threads <count>\n"
+                   "           --pin none | compact | scatter\n"
+                   "           --no-smt\n"
+                   "           --background\n"
+                   "           --kernel sha1dc | scalar | simd | sha-ni\n"
+                   "           --mode wpa | sha1 | md5 | ntlm\n"
+                   "           --hashes <22000/16800 file, pcap/pcapng capture or hex digests>\n"
+                   "           --potfile <path>\n"
+                   "           --all\n"
+                   "           --shuffle <seed>\n"
+                   "           --stride <n>\n"
+                   "           --autotune [--tuning-file <path>]\n"
+                   "           --perf-report\n"
+                   "           --trace <path> [--trace-sample <n>]\n"
+                   "           --metrics <path> | --prometheus <path> [--metrics-interval <s>]\n"
+                   "           --serve <socket>\n"
+                   "           --benchmark [--duration <seconds>] [--json <path>]\n"
+                   "           --scaling [--targets <n>] [--position <0-1>] [--json <path>]\n"
                    "           {d|l|u|a|?}*";
 
+const char* next_arg(int argc, const char* argv[], int* idx) {
+    if (*idx + 1 >= argc)
+        error("missing value for option '%s'\n%s\n", argv[*idx], HELP);
+
+    *idx += 1;
+    return argv[*idx];
+}
+
 int main(int argc, const char* argv[]) {
     if (argc < 2 || strcmp(argv[1], "--help") == 0)
         error("%s\n", HELP);
@@ -24,25 +59,149 @@ int main(int argc, const char* argv[]) {
         return 0;
     }
 
-    if (strcmp(argv[1], "--backend") == 0) {
-        if (argc < 4)
-            error("%s\n", HELP);
+    // By default run the cpu backend.
+    const char* backend = "cpu";
+    const char* pattern = nullptr;
+    const char* hashes_path = nullptr;
+    const char* socket_path = nullptr;
+    cpu::Mode mode = cpu::Mode::Pmk;
+    cpu::Config config;
+    cpu::benchmark::Options bench_options;
+    bool benchmark = false;
+    cpu::scaling::Options scaling_options;
+    bool scaling = false;
+
+    for (int idx = 1; idx < argc; idx++) {
+        const char* arg = argv[idx];
+
+        if (strcmp(arg, "--backend") == 0) {
+            backend = next_arg(argc, argv, &idx);
+        } else if (strcmp(arg, "--threads") == 0) {
+            const char* count = next_arg(argc, argv, &idx);
+            char* end;
+            config.thread_count = strtoull(count, &end, 10);
+            if (*end != '\0' || config.thread_count == 0)
+                error("invalid thread count '%s'\n", count);
+        } else if (strcmp(arg, "--pin") == 0) {
+            const char* policy = next_arg(argc, argv, &idx);
+            if (!cpu::topology::parse_pinning(policy, &config.pinning))
+                error("unknown pinning policy '%s'\n", policy);
+        } else if (strcmp(arg, "--no-smt") == 0) {
+            config.smt = false;
+        } else if (strcmp(arg, "--background") == 0) {
+            config.background = true;
+        } else if (strcmp(arg, "--kernel") == 0) {
+            const char* kernel = next_arg(argc, argv, &idx);
+            if (!cpu::kernels::parse(kernel, &config.kernel))
+                error("unknown kernel '%s'\n", kernel);
+        } else if (strcmp(arg, "--mode") == 0) {
+            const char* name = next_arg(argc, argv, &idx);
+            if (strcmp(name, "wpa") == 0)
+                mode = cpu::Mode::Pmk;
+            else if (!cpu::modes::parse(name, &mode) || cpu::modes::is_wpa(mode))
+                error("unknown mode '%s'\n", name);
+        } else if (strcmp(arg, "--hashes") == 0) {
+            hashes_path = next_arg(argc, argv, &idx);
+        } else if (strcmp(arg, "--potfile") == 0) {
+            config.potfile_path = next_arg(argc, argv, &idx);
+        } else if (strcmp(arg, "--all") == 0) {
+            config.all_hits = true;
+        } else if (strcmp(arg, "--shuffle") == 0) {
+            const char* seed = next_arg(argc, argv, &idx);
+            char* end;
+            config.shuffle_seed = strtoull(seed, &end, 10);
+            if (*end != '\0' || config.shuffle_seed == 0)
+                error("invalid shuffle seed '%s'\n", seed);
+        } else if (strcmp(arg, "--stride") == 0) {
+            const char* stride = next_arg(argc, argv, &idx);
+            char* end;
+            config.stride = strtoull(stride, &end, 10);
+            if (*end != '\0' || !cpu::hash::valid_stride(config.stride))
+                error("invalid stride '%s', must be a power of two\n", stride);
+        } else if (strcmp(arg, "--autotune") == 0) {
+            config.autotune = true;
+        } else if (strcmp(arg, "--tuning-file") == 0) {
+            config.tuning_path = next_arg(argc, argv, &idx);
+        } else if (strcmp(arg, "--perf-report") == 0) {
+            config.perf_report = true;
+        } else if (strcmp(arg, "--trace") == 0) {
+            config.trace_path = next_arg(argc, argv, &idx);
+        } else if (strcmp(arg, "--trace-sample") == 0) {
+            const char* sample = next_arg(argc, argv, &idx);
+            char* end;
+            config.trace_sample = strtoull(sample, &end, 10);
+            if (*end != '\0' || config.trace_sample == 0)
+                error("invalid trace sample '%s'\n", sample);
+        } else if (strcmp(arg, "--metrics") == 0) {
+            config.metrics_path = next_arg(argc, argv, &idx);
+        } else if (strcmp(arg, "--prometheus") == 0) {
+            config.prometheus_path = next_arg(argc, argv, &idx);
+        } else if (strcmp(arg, "--metrics-interval") == 0) {
+            const char* interval = next_arg(argc, argv, &idx);
+            char* end;
+            config.metrics_interval = strtod(interval, &end);
+            if (*end != '\0' || config.metrics_interval <= 0.0)
+                error("invalid metrics interval '%s'\n", interval);
+        } else if (strcmp(arg, "--serve") == 0) {
+            socket_path = next_arg(argc, argv, &idx);
+        } else if (strcmp(arg, "--benchmark") == 0) {
+            benchmark = true;
+        } else if (strcmp(arg, "--duration") == 0) {
+            const char* duration = next_arg(argc, argv, &idx);
+            char* end;
+            bench_options.duration = strtod(duration, &end);
+            if (*end != '\0' || bench_options.duration <= 0.0)
+                error("invalid duration '%s'\n", duration);
+        } else if (strcmp(arg, "--json") == 0) {
+            bench_options.json_path = next_arg(argc, argv, &idx);
+            scaling_options.json_path = bench_options.json_path;
+        } else if (strcmp(arg, "--scaling") == 0) {
+            scaling = true;
+        } else if (strcmp(arg, "--targets") == 0) {
+            const char* count = next_arg(argc, argv, &idx);
+            char* end;
+            scaling_options.target_count = strtoull(count, &end, 10);
+            if (*end != '\0' || scaling_options.target_count == 0)
+                error("invalid target count '%s'\n", count);
+        } else if (strcmp(arg, "--position") == 0) {
+            const char* position = next_arg(argc, argv, &idx);
+            char* end;
+            scaling_options.position = strtod(position, &end);
+            if (*end != '\0' || scaling_options.position < 0.0 || scaling_options.position > 1.0)
+                error("invalid keyspace position '%s'\n", position);
+        } else if (strncmp(arg, "--", 2) == 0) {
+            error("unknown option '%s'\n%s\n", arg, HELP);
+        } else {
+            pattern = arg;
+        }
+    }
 
-        const char* pattern = argv[3];
+    if (benchmark) {
+        cpu::benchmark::main(config, bench_options);
+        return 0;
+    }
 
-        if (strcmp(argv[2], "cpu") == 0)
-            cpu::main(pattern);
-        else if (strcmp(argv[2], "metal") == 0)
-            metal::main(pattern);
-        else
-            error("unknown backend option '%s'\n", argv[2]);
+    if (socket_path) {
+        cpu::daemon::serve(socket_path, config);
+        return 0;
+    }
 
-    } else {
-        const char* pattern = argv[1];
+    if (!pattern)
+        error("%s\n", HELP);
 
-        // By default run the cpu backend.
-        cpu::main(pattern);
+    if (scaling) {
+        cpu::scaling::main(pattern, config, scaling_options);
+        return 0;
     }
 
+    if (strcmp(backend, "cpu") == 0)
+        cpu::main(pattern, hashes_path, mode, config);
+#if defined(METALING_METAL)
+    else if (strcmp(backend, "metal") == 0)
+        metal::main(pattern);
+#endif
+    else
+        error("unknown backend option '%s'\n", backend);
+
     return 0;
 }
@@ -1,6 +1,9 @@
+#include <cstdarg>
+#include <cstdio>
 #include <filesystem>
 #include <fstream>
 #include <sstream>
+#include <unistd.h>
 
 #define NS_PRIVATE_IMPLEMENTATION
 #define CA_PRIVATE_IMPLEMENTATION
@@ -11,6 +14,21 @@
 
 namespace fs = std::filesystem;
 
+[[noreturn]] void error_metal(NS::Error* err, const char * fmt, ...) {
+    va_list arglist;
+
+    va_start(arglist, fmt);
+    fprintf(stderr, "\033[1;31m" "error: " "\033[0m");
+    vfprintf(stderr, fmt, arglist);
+    if (err)
+        fprintf(stderr, ":\n%s\n", err->localizedDescription()->utf8String());
+    else
+        fprintf(stderr, "\n");
+    va_end(arglist);
+
+    _exit(1);
+}
+
 namespace metal {
 
 constexpr auto get_metal_version() {
@@ -4,6 +4,8 @@
 #include <string_view>
 #include "common.hpp"
 
+void error_metal(NS::Error* err, const char* fmt, ...);
+
 namespace metal {
 
 std::unique_ptr<void, std::function<void(void*)>> new_scoped_memory_pool();
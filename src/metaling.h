@@ -0,0 +1,88 @@
+#ifndef METALING_H
+#define METALING_H
+
+/*
+ * C API of the CPU engine, for driving it in-process from other languages.
+ *
+ * Candidates are handed over as consecutive, zero padded records of METALING_CANDIDATE_SIZE bytes
+ * and hashed in place. Hits are written straight into a buffer owned by the caller.
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define METALING_API __attribute__((visibility("default")))
+#else
+#define METALING_API
+#endif
+
+/* Bumped whenever a struct layout or function signature below changes. */
+#define METALING_ABI_VERSION 1
+
+#define METALING_CANDIDATE_SIZE 64
+
+typedef enum metaling_mode {
+    /* The candidate is used as the PMK directly, like `generate_pmkid` in impl_pmkid.py. */
+    METALING_MODE_PMK = 0,
+    /* The candidate is a WPA passphrase, the PMK is derived from it and the ESSID. */
+    METALING_MODE_PASSPHRASE = 1,
+} metaling_mode;
+
+typedef struct metaling_target {
+    uint8_t essid[32];
+    uint32_t essid_len;
+    uint8_t mac_ap[6];
+    uint8_t mac_sta[6];
+
+    /* Digest bytes in the order hashlib returns them, only the first 16 bytes are compared. */
+    uint8_t hash[20];
+} metaling_target;
+
+typedef struct metaling_hit {
+    /* Index of the candidate in the submitted batch. */
+    uint64_t candidate_idx;
+    /* Index of the target it matched, in the order they were passed to metaling_create. */
+    uint64_t target_idx;
+} metaling_hit;
+
+typedef struct metaling_engine metaling_engine;
+
+METALING_API uint32_t metaling_abi_version(void);
+
+/*
+ * Copies the targets into a new engine. `kernel` is one of the names `metaling --kernel` accepts,
+ * or NULL for the default, and a `thread_count` of 0 uses every available CPU. Returns NULL on
+ * invalid arguments, see metaling_last_error.
+ */
+METALING_API metaling_engine* metaling_create(
+    metaling_mode mode,
+    const metaling_target* targets,
+    uint64_t target_count,
+    const char* kernel,
+    uint32_t thread_count);
+
+METALING_API void metaling_destroy(metaling_engine* engine);
+
+/*
+ * Hashes `count` candidates against every target, spreading large batches over the engine's
+ * threads. Writes up to `max_hits` hits to `hits` and returns the total number of hits.
+ */
+METALING_API uint64_t metaling_check(
+    metaling_engine* engine,
+    const uint8_t* candidates,
+    uint64_t count,
+    metaling_hit* hits,
+    uint64_t max_hits);
+
+/* Describes why the last call on this thread failed. */
+METALING_API const char* metaling_last_error(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
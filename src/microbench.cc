@@ -0,0 +1,411 @@
+#include "src/backend/cpu/hash.hpp"
+#include "src/backend/cpu/kernels.hpp"
+#include "src/backend/cpu/lookup.hpp"
+#include "src/backend/cpu/sha1.hpp"
+#include "src/backend/cpu/telemetry.hpp"
+#include "src/common.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+// Measures the stages of the CPU engine one at a time, such that a change in end-to-end throughput
+// can be traced back to the stage that caused it.
+
+const char* HELP = R"(usage: metaling_microbench [options] [filter]
+
+Runs every benchmark whose name contains `filter`.
+
+options:
+  --time <seconds>   Measured time per benchmark (default: 0.5).
+  --list             Print the benchmark names and exit.
+  --help             Shows this help message.
+)";
+
+// Pattern used by the enumeration benchmarks.
+const char* PATTERN = "????????";
+
+// Target set sizes for the lookup benchmarks.
+const u64 LOOKUP_SIZES[] = {1, 8, 64, 1024, 65536, 1048576};
+
+// Probes are cycled through, so they stay in cache while the digests of the large sets don't.
+const u64 PROBE_COUNT = 4096;
+
+struct Options {
+    const char* filter = "";
+    f64 time = 0.5;
+    bool list = false;
+};
+
+// Keeps the compiler from optimizing out a result, or hoisting a computation out of the loop.
+template <typename T>
+inline void keep(T& value) {
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+struct Bench {
+    const Options& options;
+
+    // Calls `f` repeatedly for `options.time` seconds, each call handles `items` items.
+    template <typename F>
+    void run(const std::string& name, u64 items, F f) {
+        if (!strstr(name.c_str(), options.filter))
+            return;
+
+        if (options.list) {
+            printf("%s\n", name.c_str());
+            return;
+        }
+
+        using clock = std::chrono::steady_clock;
+
+        // Find an iteration count that takes about a tenth of the measured time.
+        u64 iterations = 1;
+        while (true) {
+            auto start = clock::now();
+            for (u64 idx = 0; idx < iterations; idx++)
+                f();
+            f64 elapsed = std::chrono::duration<f64>(clock::now() - start).count();
+
+            if (elapsed >= options.time / 10.0)
+                break;
+            iterations *= 2;
+        }
+
+        u64 calls = 0;
+        auto start = clock::now();
+        u64 start_cycles = cpu::telemetry::read_cycle_counter();
+        f64 elapsed = 0.0;
+
+        while (elapsed < options.time) {
+            for (u64 idx = 0; idx < iterations; idx++)
+                f();
+            calls += iterations;
+            elapsed = std::chrono::duration<f64>(clock::now() - start).count();
+        }
+
+        u64 cycles = cpu::telemetry::read_cycle_counter() - start_cycles;
+        f64 count = (f64)(calls * items);
+
+        printf("  %-32s %12.2f %14.2f", name.c_str(), elapsed * 1e9 / count, count / elapsed / 1e6);
+        if (cycles)
+            printf(" %12.1f\n", (f64)cycles / count);
+        else
+            printf(" %12s\n", "-");
+
+        fflush(stdout);
+    }
+};
+
+void bench_compress(Bench& bench) {
+    using namespace cpu;
+
+    for (kernels::Kernel kernel : kernels::ALL) {
+        if (!kernels::available(kernel))
+            continue;
+
+        u64 lanes = kernels::lanes(kernel);
+        u32 states[kernels::MAX_LANES][5] = {{0}};
+        u32 blocks[kernels::MAX_LANES][16] = {{0}};
+        for (u64 lane = 0; lane < lanes; lane++)
+            for (u64 idx = 0; idx < 16; idx++)
+                blocks[lane][idx] = lane * 16 + idx;
+
+        // Each call continues from the previous states, like the blocks of a long message.
+        bench.run(std::string("compress/") + kernels::name(kernel), lanes, [&] {
+            kernels::compress(kernel, states, blocks, lanes);
+            keep(states);
+        });
+    }
+}
+
+void bench_sha1(Bench& bench) {
+    using namespace cpu;
+
+    // A 64 byte message takes two compressions, the second one is only padding.
+    u8 msg[64];
+    for (u64 idx = 0; idx < sizeof(msg); idx++)
+        msg[idx] = idx;
+
+    SHA1_CTX ctx;
+    u8 digest[20];
+    bench.run("sha1-64B/sha1dc", 1, [&] {
+        SHA1DCInit(&ctx);
+        SHA1DCUpdate(&ctx, reinterpret_cast<const char*>(msg), sizeof(msg));
+        SHA1DCFinal(digest, &ctx);
+        keep(digest);
+    });
+
+    u32 block[16];
+    for (u64 idx = 0; idx < 16; idx++)
+        block[idx] = ((u32)msg[idx * 4] << 24) | ((u32)msg[idx * 4 + 1] << 16) |
+                     ((u32)msg[idx * 4 + 2] << 8) | (u32)msg[idx * 4 + 3];
+
+    u32 padding[16] = {0x80000000};
+    padding[15] = sizeof(msg) * 8;
+
+    u32 state[1][5];
+    bench.run("sha1-64B/scalar", 1, [&] {
+        const u32 iv[5] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0};
+        memcpy(state[0], iv, sizeof(iv));
+        kernels::compress(kernels::Kernel::Scalar, state, &block, 1);
+        kernels::compress(kernels::Kernel::Scalar, state, &padding, 1);
+        keep(state);
+    });
+}
+
+void bench_pmkid(Bench& bench) {
+    using namespace cpu;
+
+    u8 keys[kernels::MAX_LANES][64] = {{0}};
+    for (u64 lane = 0; lane < kernels::MAX_LANES; lane++)
+        snprintf((char*)keys[lane], sizeof(keys[lane]), "candidate%lld", lane);
+
+    const u8 mac_ap[6] = {0x00, 0x11, 0x22, 0x33, 0x44, 0x55};
+    const u8 mac_sta[6] = {0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb};
+
+    u8 msg[20];
+    memcpy(msg, "PMK Name", 8);
+    memcpy(msg + 8, mac_ap, 6);
+    memcpy(msg + 14, mac_sta, 6);
+
+    u32 hash[5];
+    bench.run("pmkid/reference", 1, [&] {
+        hash::pmkid(keys[0], mac_ap, mac_sta, hash);
+        keep(hash);
+    });
+
+    u32 hashes[kernels::MAX_LANES][5];
+    for (kernels::Kernel kernel : kernels::ALL) {
+        if (!kernels::available(kernel))
+            continue;
+
+        bench.run(std::string("pmkid/") + kernels::name(kernel), kernels::MAX_LANES, [&] {
+            kernels::pmkid(kernel, keys, kernels::MAX_LANES, msg, hashes);
+            keep(hashes);
+        });
+    }
+
+    // A single target that no candidate matches, which stops the last compression early.
+    const u32 reject = 0x12345678;
+    for (kernels::Kernel kernel : kernels::ALL) {
+        if (!kernels::available(kernel))
+            continue;
+
+        bench.run(std::string("pmkid-reject/") + kernels::name(kernel), kernels::MAX_LANES, [&] {
+            kernels::pmkid(kernel, keys, kernels::MAX_LANES, msg, hashes, &reject);
+            keep(hashes);
+        });
+    }
+
+    // What each SHA-256 PMKID and handshake target costs on top of the shared PMK, the latter for
+    // a typical 121 byte message 2.
+    u32 pmks[kernels::MAX_LANES][8] = {{0}};
+    for (kernels::Kernel kernel : kernels::ALL) {
+        if (!kernels::available(kernel))
+            continue;
+
+        bench.run(std::string("pmkid-sha256/") + kernels::name(kernel), kernels::MAX_LANES, [&] {
+            kernels::wpa_pmkid_sha256(kernel, pmks, kernels::MAX_LANES, msg, hashes);
+            keep(hashes);
+        });
+    }
+
+    u8 frame[121] = {1, 3, 0, 117, 2};
+    u8 anonce[32] = {0};
+    u8 snonce[32] = {1};
+
+    for (u32 key_version : {1, 2}) {
+        kernels::Eapol eapol;
+        kernels::eapol_init(
+            &eapol, mac_ap, mac_sta, anonce, snonce, key_version, frame, sizeof(frame));
+
+        for (kernels::Kernel kernel : kernels::ALL) {
+            if (!kernels::available(kernel))
+                continue;
+
+            std::string name = std::string("eapol-mic/") + (key_version == 1 ? "md5/" : "sha1/") +
+                               kernels::name(kernel);
+            bench.run(name, kernels::MAX_LANES, [&] {
+                kernels::eapol_mic(kernel, pmks, kernels::MAX_LANES, eapol, hashes);
+                keep(hashes);
+            });
+        }
+    }
+}
+
+void bench_raw(Bench& bench) {
+    using namespace cpu;
+
+    u8 keys[kernels::MAX_LANES][64] = {{0}};
+    for (u64 lane = 0; lane < kernels::MAX_LANES; lane++)
+        snprintf((char*)keys[lane], sizeof(keys[lane]), "candidate%lld", lane);
+
+    struct Mode {
+        const char* name;
+        void (*hash)(kernels::Kernel, const u8[][64], u64, u32[][5]);
+    };
+
+    u32 hashes[kernels::MAX_LANES][5];
+    for (Mode mode : {Mode{"sha1", kernels::raw_sha1}, Mode{"md5", kernels::raw_md5},
+                      Mode{"ntlm", kernels::ntlm}}) {
+        for (kernels::Kernel kernel : kernels::ALL) {
+            if (!kernels::available(kernel))
+                continue;
+
+            std::string name = std::string("raw/") + mode.name + "/" + kernels::name(kernel);
+            bench.run(name, kernels::MAX_LANES, [&] {
+                mode.hash(kernel, keys, kernels::MAX_LANES, hashes);
+                keep(hashes);
+            });
+        }
+    }
+}
+
+void bench_enumeration(Bench& bench) {
+    using namespace cpu;
+
+    u64 len = strlen(PATTERN);
+    const char* char_sets[64];
+    u32 set_sizes[64];
+    hash::init_char_sets((const u8*)PATTERN, len, char_sets, set_sizes);
+    u64 keyspace = (u64)hash::keyspace((const u8*)PATTERN, len);
+    hash::Decoder decoder;
+    hash::init_decoder(set_sizes, len, &decoder);
+
+    u32 indices[64] = {0};
+
+    // Jumping around the keyspace, like a worker does at the start of every stride.
+    u64 current_idx = 0;
+    bench.run("initialize_indices", 1, [&] {
+        current_idx = (current_idx + 0x9e3779b97f4a7c15) % keyspace;
+        hash::initialize_indices(decoder, current_idx, indices);
+        keep(indices);
+    });
+
+    // The same past 2^64, where the first digits need 128-bit divisions.
+    u128 wide_idx = (u128)1 << 64;
+    bench.run("initialize_indices/128", 1, [&] {
+        wide_idx += 0x9e3779b97f4a7c15;
+        hash::initialize_indices(decoder, wide_idx, indices);
+        keep(indices);
+    });
+
+    // What `--shuffle` adds on top of decoding every candidate.
+    hash::Permutation permutation;
+    hash::init_permutation(keyspace, 1, &permutation);
+    u64 shuffle_idx = 0;
+    bench.run("permute", 1, [&] {
+        u128 idx = hash::permute(permutation, shuffle_idx++);
+        keep(idx);
+    });
+
+    u8 batch[kernels::MAX_LANES][64];
+    bench.run("decode_batch", kernels::MAX_LANES, [&] {
+        current_idx = (current_idx + 0x9e3779b97f4a7c15) % keyspace;
+        hash::decode_batch(decoder, char_sets, current_idx, kernels::MAX_LANES, batch);
+        keep(batch);
+    });
+
+    hash::initialize_indices(decoder, 0, indices);
+    bench.run("next_indices", 1, [&] {
+        hash::next_indices(indices, set_sizes, len);
+        keep(indices);
+    });
+
+    // Includes a step, otherwise the same candidate would be packed over and over.
+    u8 candidate[64] = {0};
+    bench.run("pack_candidate", 1, [&] {
+        hash::next_indices(indices, set_sizes, len);
+        hash::pack_candidate(indices, char_sets, len, candidate);
+        keep(candidate);
+    });
+
+    // The whole generator including the callback, runs through a fixed number of candidates.
+    const u64 candidates = 1 << 16;
+    bench.run("generate_permutations", candidates, [&] {
+        u64 count = 0;
+        hash::generate_permutations((const u8*)PATTERN, len, 0, 1, [&](const u8 tc[64]) {
+            memcpy(candidate, tc, sizeof(candidate));
+            keep(candidate);
+            return ++count < candidates;
+        });
+    });
+
+    bench.run("generate_batches", candidates, [&] {
+        u64 count = 0;
+        hash::generate_batches((const u8*)PATTERN, len, 0, 1, [&](const u8 batch[][64], u64 n) {
+            keep(batch);
+            count += n;
+            return count < candidates;
+        });
+    });
+}
+
+void bench_lookup(Bench& bench) {
+    using namespace cpu;
+
+    std::mt19937 rng(1);
+
+    // Random digests never match, which is what nearly every lookup during a run looks like.
+    std::vector<lookup::Digest> probes(PROBE_COUNT);
+    for (u64 idx = 0; idx < PROBE_COUNT; idx++)
+        for (u64 word = 0; word < lookup::DIGEST_WORDS; word++)
+            probes[idx].hash[word] = rng();
+
+    for (u64 size : LOOKUP_SIZES) {
+        std::vector<lookup::Digest> digests(size);
+        for (u64 idx = 0; idx < size; idx++) {
+            for (u64 word = 0; word < lookup::DIGEST_WORDS; word++)
+                digests[idx].hash[word] = rng();
+            digests[idx].target_idx = idx;
+        }
+        lookup::sort(digests.data(), size);
+
+        u64 probe = 0;
+        bench.run("lookup/" + std::to_string(size), 1, [&] {
+            const lookup::Digest* hit = lookup::find(digests.data(), size, probes[probe].hash);
+            probe = (probe + 1) % PROBE_COUNT;
+            keep(hit);
+        });
+    }
+}
+
+int main(int argc, char** argv) {
+    Options options;
+
+    for (int idx = 1; idx < argc; idx++) {
+        if (strcmp(argv[idx], "--help") == 0) {
+            printf("%s", HELP);
+            return 0;
+        } else if (strcmp(argv[idx], "--list") == 0) {
+            options.list = true;
+        } else if (strcmp(argv[idx], "--time") == 0) {
+            if (idx + 1 >= argc)
+                error("--time needs a value\n");
+            options.time = atof(argv[++idx]);
+            if (options.time <= 0.0)
+                error("--time must be positive\n");
+        } else if (argv[idx][0] == '-') {
+            error("unknown option '%s'\n%s", argv[idx], HELP);
+        } else {
+            options.filter = argv[idx];
+        }
+    }
+
+    if (!options.list)
+        printf("  %-32s %12s %14s %12s\n", "benchmark", "ns/item", "M items/s", "cycles/item");
+
+    Bench bench = Bench{.options = options};
+    bench_compress(bench);
+    bench_sha1(bench);
+    bench_pmkid(bench);
+    bench_raw(bench);
+    bench_enumeration(bench);
+    bench_lookup(bench);
+
+    return 0;
+}
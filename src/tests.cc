@@ -1,9 +1,1144 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
 #include "common.hpp"
 #include "hash.hpp"
+#include "backend/cpu/capture.hpp"
+#include "backend/cpu/cpu.hpp"
+#include "backend/cpu/daemon.hpp"
+#include "backend/cpu/hash.hpp"
+#include "backend/cpu/hashfile.hpp"
+#include "backend/cpu/hits.hpp"
+#include "backend/cpu/kernels.hpp"
+#include "backend/cpu/modes.hpp"
+#include "backend/cpu/potfile.hpp"
+#include "backend/cpu/targets.hpp"
+#include "backend/cpu/topology.hpp"
+#include "backend/cpu/tuning.hpp"
+
+#if defined(METALING_METAL)
 #include "metal.hpp"
+#endif
 
 namespace tests {
 
+void cpu_kernels() {
+    u8 keys[cpu::kernels::MAX_LANES][64] = {{0}};
+    for (u64 idx = 0; idx < cpu::kernels::MAX_LANES; idx++)
+        snprintf((char*)keys[idx], sizeof(keys[idx]), "key%lld", idx * 31);
+
+    u8 mac_ap[6], mac_sta[6];
+    hash::mac_to_bytes("00:11:22:33:44:55", mac_ap);
+    hash::mac_to_bytes("66:77:88:99:AA:BB", mac_sta);
+
+    u8 msg[20];
+    memcpy(msg, "PMK Name", 8);
+    memcpy(msg + 8, mac_ap, 6);
+    memcpy(msg + 14, mac_sta, 6);
+
+    for (cpu::kernels::Kernel kernel : cpu::kernels::ALL) {
+        if (!cpu::kernels::available(kernel))
+            continue;
+
+        u32 hashes[cpu::kernels::MAX_LANES][5];
+        cpu::kernels::pmkid(kernel, keys, cpu::kernels::MAX_LANES, msg, hashes);
+
+        for (u64 idx = 0; idx < cpu::kernels::MAX_LANES; idx++) {
+            u32 exp[5];
+            cpu::hash::pmkid(keys[idx], mac_ap, mac_sta, exp);
+
+            if (memcmp(exp, hashes[idx], sizeof(exp)) != 0)
+                error("kernel '%s' mismatches in lane %lld\n", cpu::kernels::name(kernel), idx);
+        }
+
+        // Early rejection finishes the lane of the target, other lanes only need an exact fourth
+        // word.
+        u32 target[5];
+        cpu::hash::pmkid(keys[5], mac_ap, mac_sta, target);
+        for (u32 reject : {target[3], ~target[3]}) {
+            cpu::kernels::pmkid(kernel, keys, cpu::kernels::MAX_LANES, msg, hashes, &reject);
+
+            for (u64 idx = 0; idx < cpu::kernels::MAX_LANES; idx++) {
+                u32 exp[5];
+                cpu::hash::pmkid(keys[idx], mac_ap, mac_sta, exp);
+
+                u64 words = exp[3] == reject ? 4 : 1;
+                if (memcmp(&exp[4 - words], &hashes[idx][4 - words], words * 4) != 0)
+                    error(
+                        "kernel '%s' rejects early wrongly in lane %lld\n",
+                        cpu::kernels::name(kernel),
+                        idx);
+            }
+        }
+    }
+
+    printf("\t%s() works\n", __func__);
+}
+
+void cpu_decoder() {
+    // Reciprocal division against the real one, around the edges of the 64-bit range.
+    for (u32 size = 2; size < 300; size++) {
+        cpu::hash::Radix radix = cpu::hash::make_radix(size);
+        u64 seed = size;
+        for (u64 idx = 0; idx < 4096; idx++) {
+            seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+            u64 n = idx < 1024 ? idx : idx < 2048 ? ~(u64)0 - (idx - 1024) : seed;
+            if (cpu::hash::divide(radix, n) != n / size)
+                error("dividing %llu by %u is off\n", n, size);
+        }
+    }
+
+    // Indices past 2^64 decode like with plain 128-bit divisions.
+    const char* pattern = "??????????????";
+    u64 len = strlen(pattern);
+    const char* char_sets[64];
+    u32 set_sizes[64];
+    cpu::hash::init_char_sets((const u8*)pattern, len, char_sets, set_sizes);
+    cpu::hash::Decoder decoder;
+    cpu::hash::init_decoder(set_sizes, len, &decoder);
+
+    u128 keyspace = cpu::hash::keyspace((const u8*)pattern, len);
+    if (!(keyspace >> 64) || cpu::hash::to_string((u128)1 << 64) != "18446744073709551616")
+        error("keyspace doesn't have 128 bits\n");
+
+    for (u128 idx : {(u128)0, (u128)12345, ((u128)1 << 64) - 1, (u128)1 << 64, keyspace - 1}) {
+        u32 indices[64];
+        cpu::hash::initialize_indices(decoder, idx, indices);
+
+        u128 rest = idx;
+        for (u64 pos = 0; pos < len; pos++) {
+            if (indices[pos] != (u32)(rest % set_sizes[pos]))
+                error("index %s decodes wrongly\n", cpu::hash::to_string(idx).c_str());
+            rest /= set_sizes[pos];
+        }
+    }
+
+    // A batch at the end of the keyspace stops where it ends.
+    u8 batch[cpu::kernels::MAX_LANES][64];
+    u64 count = cpu::hash::decode_batch(decoder, char_sets, keyspace - 3, 8, batch);
+    for (u64 idx = 0; idx < count; idx++) {
+        u8 exp[64] = {0};
+        u32 indices[64];
+        cpu::hash::initialize_indices(decoder, keyspace - 3 + idx, indices);
+        cpu::hash::pack_candidate(indices, char_sets, len, exp);
+        if (memcmp(exp, batch[idx], 64) != 0)
+            error("batch decoding mismatches at %lld\n", idx);
+    }
+
+    if (count != 3)
+        error("batch decoding ran past the keyspace\n");
+
+    printf("\t%s() works\n", __func__);
+}
+
+void cpu_permutation() {
+    for (u64 size : {1, 2, 3, 1000, 1024, 13 * 29 * 29}) {
+        cpu::hash::Permutation permutation;
+        cpu::hash::init_permutation(size, 42, &permutation);
+
+        std::vector<bool> seen(size, false);
+        u64 fixed = 0;
+        for (u64 idx = 0; idx < size; idx++) {
+            u64 out = (u64)cpu::hash::permute(permutation, idx);
+            if (out >= size || seen[out])
+                error("permutation of %lld isn't a bijection\n", size);
+            seen[out] = true;
+            fixed += out == idx;
+        }
+
+        if (size >= 1000 && fixed > size / 10)
+            error("permutation of %lld barely shuffles\n", size);
+    }
+
+    // Every candidate once over all chunks, in a different order than without a permutation.
+    const char* pattern = "dl";
+    u128 keyspace = cpu::hash::keyspace((const u8*)pattern, 2);
+    cpu::hash::Permutation permutation;
+    cpu::hash::init_permutation(keyspace, 7, &permutation);
+
+    std::vector<std::string> plain, shuffled;
+    for (u64 chunk = 0; chunk < 3; chunk++) {
+        cpu::hash::generate_permutations((const u8*)pattern, 2, chunk, 3, [&](const u8 tc[64]) {
+            plain.push_back(std::string((const char*)tc, 2));
+            return true;
+        });
+        cpu::hash::generate_permutations(
+            (const u8*)pattern, 2, chunk, 3,
+            [&](const u8 tc[64]) {
+                shuffled.push_back(std::string((const char*)tc, 2));
+                return true;
+            },
+            &permutation);
+    }
+
+    if (shuffled.size() != keyspace || shuffled == plain)
+        error("shuffled enumeration isn't a reordering\n");
+
+    std::vector<std::string> sorted = shuffled;
+    std::sort(sorted.begin(), sorted.end());
+    std::sort(plain.begin(), plain.end());
+    if (sorted != plain)
+        error("shuffled enumeration misses candidates\n");
+
+    printf("\t%s() works\n", __func__);
+}
+
+void cpu_generator() {
+    // The batched generator runs through the same candidates in the same order, across strides and
+    // chunks, with and without a permutation.
+    for (const char* pattern : {"", "d", "ldu", "llll"}) {
+        u64 len = strlen(pattern);
+        cpu::hash::Permutation permutation;
+        cpu::hash::init_permutation(cpu::hash::keyspace((const u8*)pattern, len), 5, &permutation);
+
+        for (const cpu::hash::Permutation* perm : {(cpu::hash::Permutation*)nullptr, &permutation}) {
+            for (u64 chunk = 0; chunk < 3; chunk++) {
+                u64 exp = 14695981039346656037ull, got = exp;
+                u64 exp_count = 0, got_count = 0;
+
+                cpu::hash::generate_permutations(
+                    (const u8*)pattern, len, chunk, 3,
+                    [&](const u8 tc[64]) {
+                        for (u64 idx = 0; idx < 64; idx++)
+                            exp = (exp ^ tc[idx]) * 1099511628211ull;
+                        exp_count++;
+                        return true;
+                    },
+                    perm);
+                cpu::hash::generate_batches(
+                    (const u8*)pattern, len, chunk, 3,
+                    [&](const u8 batch[][64], u64 count) {
+                        for (u64 row = 0; row < count; row++)
+                            for (u64 idx = 0; idx < 64; idx++)
+                                got = (got ^ batch[row][idx]) * 1099511628211ull;
+                        got_count += count;
+                        return true;
+                    },
+                    perm);
+
+                if (exp != got || exp_count != got_count)
+                    error("batched generator differs for pattern '%s'\n", pattern);
+            }
+        }
+    }
+
+    printf("\t%s() works\n", __func__);
+}
+
+void cpu_wpa_pmk() {
+    // Test vector from IEEE 802.11i, annex H.4.
+    u8 passphrase[1][64] = {{0}};
+    memcpy(passphrase[0], "password", 8);
+
+    std::string exp = "f42c6fc52df0ebef9ebb4b90b38a5f902e83fe1b135a70e23aed762e9710a12e";
+
+    for (cpu::kernels::Kernel kernel : cpu::kernels::ALL) {
+        if (!cpu::kernels::available(kernel))
+            continue;
+
+        u32 pmk[1][8];
+        cpu::kernels::wpa_pmk(kernel, passphrase, 1, (const u8*)"IEEE", 4, pmk);
+
+        u8 bytes[32];
+        for (u64 idx = 0; idx < 8; idx++)
+            for (u64 byte = 0; byte < 4; byte++)
+                bytes[idx * 4 + byte] = pmk[0][idx] >> (24 - byte * 8);
+
+        std::string got = hash::bytes_to_digest(bytes, sizeof(bytes));
+        if (exp != got)
+            error(
+                "mismatch in pmk of kernel '%s':\nexp: %s\ngot: %s\n",
+                cpu::kernels::name(kernel),
+                exp.c_str(),
+                got.c_str());
+    }
+
+    printf("\t%s() works\n", __func__);
+}
+
+std::string write_temp_file(const std::string& contents) {
+    char path[] = "/tmp/metaling-test-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+        error("failed to create temporary file\n");
+
+    if (write(fd, contents.data(), contents.size()) != (i64)contents.size())
+        error("failed to write temporary file\n");
+    close(fd);
+
+    return path;
+}
+
+std::string read_file(const std::string& path) {
+    std::string contents;
+    FILE* file = fopen(path.c_str(), "r");
+    if (!file)
+        error("failed to open '%s'\n", path.c_str());
+
+    char chunk[4096];
+    while (u64 len = fread(chunk, 1, sizeof(chunk), file))
+        contents.append(chunk, len);
+    fclose(file);
+
+    return contents;
+}
+
+// Example hash of hashcat mode 22000, the passphrase is "hashcat!".
+const char* EXAMPLE_PMKID =
+    "WPA*01*4d4fe7aac3a2cecab195321ceb99a7d0*fc690c158264*f4747f87f9f4*686173686361742d657373"
+    "6964***";
+
+// Handshakes of the same network and passphrase with HMAC-SHA1, HMAC-MD5 and (unsupported)
+// AES-CMAC MICs.
+const char* EXAMPLE_EAPOL_SHA1 =
+    "WPA*02*c8c4939c88fedfb4492909f110f421b8*fc690c158264*f4747f87f9f4*686173686361742d657373"
+    "6964*000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f*0103007502010a0010"
+    "00000000000000016465666768696a6b6c6d6e6f707172737475767778797a7b7c7d7e7f8081828300000000"
+    "0000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "001630140100000fac040100000fac040100000fac020000*02";
+const char* EXAMPLE_EAPOL_MD5 =
+    "WPA*02*607aaab3683ea8705be09d2596beec04*fc690c158264*f4747f87f9f4*686173686361742d657373"
+    "6964*000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f*01030077fe01090010"
+    "00000000000000016465666768696a6b6c6d6e6f707172737475767778797a7b7c7d7e7f8081828300000000"
+    "0000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "0018dd160050f20101000050f20201000050f20201000050f202*02";
+const char* EXAMPLE_EAPOL_CMAC =
+    "WPA*02*00000000000000000000000000000000*fc690c158264*f4747f87f9f4*686173686361742d657373"
+    "6964*000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f*0103007502010b0010"
+    "00000000000000016465666768696a6b6c6d6e6f707172737475767778797a7b7c7d7e7f8081828300000000"
+    "0000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "001630140100000fac040100000fac040100000fac020000*02";
+
+// Same handshake as `EXAMPLE_EAPOL_SHA1`, with the passphrase "x7".
+const char* EXAMPLE_EAPOL_SHORT =
+    "WPA*02*096bf87bbf0fba32713d909fade5c09e*fc690c158264*f4747f87f9f4*686173686361742d657373"
+    "6964*000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f*0103007502010a0010"
+    "00000000000000016465666768696a6b6c6d6e6f707172737475767778797a7b7c7d7e7f8081828300000000"
+    "0000000000000000000000000000000000000000000000000000000000000000000000000000000000000000"
+    "001630140100000fac040100000fac040100000fac020000*02";
+
+// HMAC-SHA256 PMKIDs of the example network for a second station, f4747f87f9f5, with the
+// passphrases "hashcat!" and "x7".
+const char* EXAMPLE_PMKID_SHA256 = "4e6cbf5a4fd5140cec88e7544c03160b";
+const char* EXAMPLE_PMKID_SHA256_SHORT = "4a4890b40aee68237cb904a34793a0c2";
+
+// The example PMKID target with the SHA-256 `hash` for the second station.
+cpu::Target sha256_target(const char* hash) {
+    cpu::Target target;
+    cpu::Handshake handshake;
+    bool skipped;
+    cpu::hashfile::parse_line(EXAMPLE_PMKID, strlen(EXAMPLE_PMKID), &target, &handshake, &skipped);
+
+    target.kind = cpu::TargetKind::PmkidSha256;
+    target.mac_sta[5] = 0xf5;
+    memset(target.hash, 0, sizeof(target.hash));
+    for (u64 idx = 0; idx < 16; idx++)
+        sscanf(hash + idx * 2, "%2hhx", reinterpret_cast<u8*>(target.hash) + idx);
+
+    return target;
+}
+
+bool same_target(const cpu::Target& a, const cpu::Target& b) {
+    return a.essid_len == b.essid_len && memcmp(a.essid, b.essid, a.essid_len) == 0 &&
+           memcmp(a.mac_ap, b.mac_ap, 6) == 0 && memcmp(a.mac_sta, b.mac_sta, 6) == 0 &&
+           memcmp(a.hash, b.hash, 16) == 0 && a.kind == b.kind;
+}
+
+void cpu_hashfile() {
+    cpu::Target target;
+    cpu::Handshake handshake;
+    bool skipped;
+    if (!cpu::hashfile::parse_line(
+            EXAMPLE_PMKID, strlen(EXAMPLE_PMKID), &target, &handshake, &skipped))
+        error("failed to parse 22000 PMKID line\n");
+
+    u8 passphrase[1][64] = {{0}};
+    memcpy(passphrase[0], "hashcat!", 8);
+
+    u8 msg[20];
+    memcpy(msg, "PMK Name", 8);
+    memcpy(msg + 8, target.mac_ap, 6);
+    memcpy(msg + 14, target.mac_sta, 6);
+
+    u32 pmk[1][8];
+    u32 hash[1][5];
+    cpu::kernels::wpa_pmk(
+        cpu::kernels::Kernel::Scalar, passphrase, 1, target.essid, target.essid_len, pmk);
+    cpu::kernels::wpa_pmkid(cpu::kernels::Kernel::Scalar, pmk, 1, msg, hash);
+    if (memcmp(hash[0], target.hash, 16) != 0)
+        error("parsed PMKID doesn't match the derived one\n");
+
+    if (cpu::hashfile::parse_line(
+            EXAMPLE_EAPOL_CMAC, strlen(EXAMPLE_EAPOL_CMAC), &target, &handshake, &skipped) ||
+        !skipped)
+        error("22000 EAPOL line with an AES-CMAC MIC should be skipped\n");
+
+    // The 16800 lines are the PMKID above, the second one with a different station.
+    std::string contents = std::string(EXAMPLE_PMKID) + "\n" + EXAMPLE_EAPOL_CMAC + "\r\n\n" +
+                           "not a hash\n" +
+                           "4d4fe7aac3a2cecab195321ceb99a7d0:fc690c158264:f4747f87f9f4:"
+                           "686173686361742d6573736964\n"
+                           "4d4fe7aac3a2cecab195321ceb99a7d0*fc690c158264*f4747f87f9f5*"
+                           "686173686361742d6573736964\n" +
+                           EXAMPLE_EAPOL_SHA1 + "\n" + EXAMPLE_EAPOL_MD5 + "\n" +
+                           EXAMPLE_EAPOL_SHA1;
+    std::string path = write_temp_file(contents);
+
+    cpu::Job job;
+    cpu::hashfile::Stats stats;
+    cpu::hashfile::load(path.c_str(), 2, &job, &stats);
+    unlink(path.c_str());
+
+    if (stats.lines != 8 || stats.pmkids != 3 || stats.eapols != 3 || stats.skipped != 1 ||
+        stats.invalid != 1 || stats.duplicates != 2 || job.targets.size() != 4 ||
+        job.targets[3].mac_sta[5] != 0xf5)
+        error("unexpected hash file contents\n");
+
+    for (const cpu::Target& target : job.targets)
+        if (target.kind == cpu::TargetKind::Eapol &&
+            (target.handshake_idx >= job.handshakes.size() ||
+             job.handshakes[target.handshake_idx].eapol_len < 121))
+            error("EAPOL target of the hash file lost its handshake\n");
+
+    printf("\t%s() works\n", __func__);
+}
+
+void cpu_eapol() {
+    u8 passphrase[cpu::kernels::MAX_LANES][64] = {{0}};
+    for (u64 idx = 0; idx < cpu::kernels::MAX_LANES; idx++)
+        memcpy(passphrase[idx], idx == 3 ? "hashcat!" : "hashcat?", 8);
+
+    for (const char* line : {EXAMPLE_EAPOL_SHA1, EXAMPLE_EAPOL_MD5}) {
+        cpu::Target target;
+        cpu::Handshake handshake;
+        bool skipped;
+        if (!cpu::hashfile::parse_line(line, strlen(line), &target, &handshake, &skipped))
+            error("failed to parse 22000 EAPOL line\n");
+
+        cpu::kernels::Eapol eapol;
+        cpu::kernels::eapol_init(
+            &eapol,
+            target.mac_ap,
+            target.mac_sta,
+            handshake.anonce,
+            handshake.snonce,
+            handshake.key_version,
+            handshake.eapol,
+            handshake.eapol_len);
+
+        for (cpu::kernels::Kernel kernel : cpu::kernels::ALL) {
+            if (!cpu::kernels::available(kernel))
+                continue;
+
+            u32 pmks[cpu::kernels::MAX_LANES][8];
+            u32 mics[cpu::kernels::MAX_LANES][5];
+            cpu::kernels::wpa_pmk(
+                kernel,
+                passphrase,
+                cpu::kernels::MAX_LANES,
+                target.essid,
+                target.essid_len,
+                pmks);
+            cpu::kernels::eapol_mic(kernel, pmks, cpu::kernels::MAX_LANES, eapol, mics);
+
+            for (u64 idx = 0; idx < cpu::kernels::MAX_LANES; idx++)
+                if ((memcmp(mics[idx], target.hash, 16) == 0) != (idx == 3))
+                    error(
+                        "kernel '%s' mismatches the version %d MIC in lane %lld\n",
+                        cpu::kernels::name(kernel),
+                        handshake.key_version,
+                        idx);
+        }
+    }
+
+    // A handshake and a PMKID of the same network, which share the PMKs.
+    cpu::Job job = cpu::Job{
+        .pattern = "ld",
+        .mode = cpu::Mode::Passphrase,
+        .targets = std::vector<cpu::Target>(2),
+        .handshakes = std::vector<cpu::Handshake>(1),
+    };
+
+    bool skipped;
+    cpu::hashfile::parse_line(
+        EXAMPLE_PMKID, strlen(EXAMPLE_PMKID), &job.targets[0], &job.handshakes[0], &skipped);
+    cpu::hashfile::parse_line(
+        EXAMPLE_EAPOL_SHORT,
+        strlen(EXAMPLE_EAPOL_SHORT),
+        &job.targets[1],
+        &job.handshakes[0],
+        &skipped);
+
+    cpu::Config config;
+    config.thread_count = 2;
+    config.verbose = false;
+
+    cpu::Result result = cpu::run(job, config);
+    if (!result.found || result.target_idx != 1 || strcmp((char*)result.passphrase, "x7") != 0)
+        error("engine didn't find the passphrase of the handshake\n");
+
+    printf("\t%s() works\n", __func__);
+}
+
+void cpu_pmkid_sha256() {
+    u8 passphrase[cpu::kernels::MAX_LANES][64] = {{0}};
+    for (u64 idx = 0; idx < cpu::kernels::MAX_LANES; idx++)
+        memcpy(passphrase[idx], idx == 3 ? "hashcat!" : "hashcat?", 8);
+
+    cpu::Target target = sha256_target(EXAMPLE_PMKID_SHA256);
+    u8 msg[20];
+    memcpy(msg, "PMK Name", 8);
+    memcpy(msg + 8, target.mac_ap, 6);
+    memcpy(msg + 14, target.mac_sta, 6);
+
+    for (cpu::kernels::Kernel kernel : cpu::kernels::ALL) {
+        if (!cpu::kernels::available(kernel))
+            continue;
+
+        u32 pmks[cpu::kernels::MAX_LANES][8];
+        u32 pmkids[cpu::kernels::MAX_LANES][5];
+        cpu::kernels::wpa_pmk(
+            kernel,
+            passphrase,
+            cpu::kernels::MAX_LANES,
+            target.essid,
+            target.essid_len,
+            pmks);
+        cpu::kernels::wpa_pmkid_sha256(kernel, pmks, cpu::kernels::MAX_LANES, msg, pmkids);
+
+        for (u64 idx = 0; idx < cpu::kernels::MAX_LANES; idx++)
+            if ((memcmp(pmkids[idx], target.hash, 16) == 0) != (idx == 3))
+                error(
+                    "kernel '%s' mismatches the SHA-256 PMKID in lane %lld\n",
+                    cpu::kernels::name(kernel),
+                    idx);
+    }
+
+    // A SHA-1 and a SHA-256 PMKID of the same network, only the latter is in the keyspace.
+    cpu::Job job = cpu::Job{
+        .pattern = "ld",
+        .mode = cpu::Mode::Passphrase,
+        .targets = std::vector<cpu::Target>(2),
+    };
+
+    cpu::Handshake handshake;
+    bool skipped;
+    cpu::hashfile::parse_line(
+        EXAMPLE_PMKID, strlen(EXAMPLE_PMKID), &job.targets[0], &handshake, &skipped);
+    job.targets[1] = sha256_target(EXAMPLE_PMKID_SHA256_SHORT);
+
+    cpu::Config config;
+    config.thread_count = 2;
+    config.verbose = false;
+
+    cpu::Result result = cpu::run(job, config);
+    if (!result.found || result.target_idx != 1 || strcmp((char*)result.passphrase, "x7") != 0)
+        error("engine didn't find the passphrase of the SHA-256 PMKID\n");
+
+    printf("\t%s() works\n", __func__);
+}
+
+void cpu_capture() {
+    cpu::Target exp_pmkid, exp_eapol;
+    cpu::Handshake exp_handshake;
+    bool skipped;
+    cpu::hashfile::parse_line(
+        EXAMPLE_PMKID, strlen(EXAMPLE_PMKID), &exp_pmkid, &exp_handshake, &skipped);
+    cpu::hashfile::parse_line(
+        EXAMPLE_EAPOL_SHA1, strlen(EXAMPLE_EAPOL_SHA1), &exp_eapol, &exp_handshake, &skipped);
+
+    std::string mac_ap((char*)exp_pmkid.mac_ap, 6);
+    std::string mac_sta((char*)exp_pmkid.mac_sta, 6);
+    std::string llc("\xaa\xaa\x03\x00\x00\x00\x88\x8e", 8);
+
+    cpu::Target exp_sha256 = sha256_target(EXAMPLE_PMKID_SHA256);
+    std::string mac_sta2((char*)exp_sha256.mac_sta, 6);
+
+    // Beacon with an RSN element advertising PSK (00-0F-AC:2) and PSK-SHA256 (00-0F-AC:6).
+    std::string rsn = std::string("\x30\x18\x01\x00\x00\x0f\xac\x04\x01\x00\x00\x0f\xac\x04", 14) +
+                      std::string("\x02\x00\x00\x0f\xac\x02\x00\x0f\xac\x06\x00\x00", 12);
+    std::string beacon = std::string("\x80\x00\x00\x00", 4) + std::string(6, '\xff') + mac_ap +
+                         mac_ap + std::string(2, 0) + std::string(12, 0) +
+                         std::string("\x00\x0dhashcat-essid", 15) + rsn;
+
+    // Data frame from the AP with an EAPOL-Key message 1 carrying the PMKID KDE, and the ANonce
+    // and replay counter of the example handshake.
+    std::string m1 = std::string("\x08\x02\x00\x00", 4) + mac_sta + mac_ap + mac_ap +
+                     std::string(2, 0) + llc +
+                     std::string("\x02\x03\x00\x75\x02\x00\x8a\x00\x10", 9) +
+                     std::string(7, 0) + "\x01" +
+                     std::string((char*)exp_handshake.anonce, 32) + std::string(48, 0) +
+                     std::string("\x00\x16\xdd\x14\x00\x0f\xac\x04", 8) +
+                     std::string((char*)exp_pmkid.hash, 16);
+
+    // Message 1 with descriptor version 3 to the second station, whose PMKID is HMAC-SHA256.
+    std::string m1_sha256 = m1;
+    m1_sha256.replace(4, 6, mac_sta2);
+    m1_sha256[24 + 8 + 6] = '\x8b';
+    m1_sha256.replace(m1_sha256.size() - 16, 16, std::string((char*)exp_sha256.hash, 16));
+
+    // Message 2 from the station, with its MIC in place.
+    std::string eapol((char*)exp_handshake.eapol, exp_handshake.eapol_len);
+    eapol.replace(81, 16, std::string((char*)exp_eapol.hash, 16));
+    std::string m2 = std::string("\x08\x01\x00\x00", 4) + mac_ap + mac_sta + mac_ap +
+                     std::string(2, 0) + llc + eapol;
+
+    auto u32_bytes = [](u32 val) { return std::string((char*)&val, 4); };
+
+    // pcap of raw 802.11 frames, with the handshake before the beacon.
+    std::string pcap = u32_bytes(0xa1b2c3d4) + u32_bytes(0x00040002) + u32_bytes(0) +
+                       u32_bytes(0) + u32_bytes(65535) + u32_bytes(105);
+    for (const std::string& frame : {m1, m2, m1_sha256, beacon})
+        pcap += u32_bytes(0) + u32_bytes(0) + u32_bytes(frame.size()) + u32_bytes(frame.size()) +
+                frame;
+
+    // pcapng of radiotap frames, the handshake is sent twice.
+    std::string radiotap = std::string("\x00\x00\x08\x00\x00\x00\x00\x00", 8);
+    std::string pcapng = u32_bytes(0x0a0d0d0a) + u32_bytes(28) + u32_bytes(0x1a2b3c4d) +
+                         u32_bytes(1) + std::string(8, '\xff') + u32_bytes(28) +
+                         u32_bytes(1) + u32_bytes(20) + u32_bytes(127) + u32_bytes(0) +
+                         u32_bytes(20);
+    for (const std::string& frame : {beacon, m1, m2, m1_sha256, m1, m2}) {
+        std::string packet = radiotap + frame;
+        packet.resize((packet.size() + 3) / 4 * 4);
+        u32 len = 32 + packet.size();
+        pcapng += u32_bytes(6) + u32_bytes(len) + u32_bytes(0) + u32_bytes(0) + u32_bytes(0) +
+                  u32_bytes(radiotap.size() + frame.size()) +
+                  u32_bytes(radiotap.size() + frame.size()) + packet + u32_bytes(len);
+    }
+
+    for (const std::string& contents : {pcap, pcapng}) {
+        std::string path = write_temp_file(contents);
+        if (!cpu::capture::detect(path.c_str()))
+            error("capture wasn't detected\n");
+
+        cpu::Job job;
+        cpu::capture::Stats stats;
+        cpu::capture::load(path.c_str(), &job, &stats);
+        unlink(path.c_str());
+
+        if (job.targets.size() != 3 || !same_target(job.targets[0], exp_pmkid) ||
+            !same_target(job.targets[1], exp_eapol) || !same_target(job.targets[2], exp_sha256))
+            error("capture didn't yield the example PMKIDs and handshake\n");
+
+        const cpu::Handshake& handshake = job.handshakes[job.targets[1].handshake_idx];
+        if (handshake.key_version != 2 || handshake.eapol_len != exp_handshake.eapol_len ||
+            memcmp(handshake.anonce, exp_handshake.anonce, 32) != 0 ||
+            memcmp(handshake.snonce, exp_handshake.snonce, 32) != 0)
+            error("capture didn't yield the example handshake\n");
+    }
+
+    printf("\t%s() works\n", __func__);
+}
+
+void cpu_raw_modes() {
+    struct Vector {
+        void (*kernel)(cpu::kernels::Kernel, const u8[][64], u64, u32[][5]);
+        const char* input;
+        const char* digest;
+    };
+
+    // FIPS 180 and RFC 1321 test vectors, and the well known NTLM hash of "password".
+    const Vector vectors[] = {
+        {cpu::kernels::raw_sha1, "abc", "a9993e364706816aba3e25717850c26c9cd0d89d"},
+        {cpu::kernels::raw_sha1, "", "da39a3ee5e6b4b0d3255bfef95601890afd80709"},
+        {cpu::kernels::raw_md5, "abc", "900150983cd24fb0d6963f7d28e17f72"},
+        {cpu::kernels::raw_md5, "", "d41d8cd98f00b204e9800998ecf8427e"},
+        {cpu::kernels::ntlm, "password", "8846f7eaee8fb117ad06bdd830b7586c"},
+        {cpu::kernels::ntlm, "", "31d6cfe0d16ae931b73c59d7e0c089c0"},
+    };
+
+    for (const Vector& vector : vectors) {
+        u8 candidates[cpu::kernels::MAX_LANES][64] = {{0}};
+        for (u64 idx = 0; idx < cpu::kernels::MAX_LANES; idx++)
+            strcpy((char*)candidates[idx], idx == 3 ? vector.input : "decoy");
+
+        for (cpu::kernels::Kernel kernel : cpu::kernels::ALL) {
+            if (!cpu::kernels::available(kernel))
+                continue;
+
+            u32 digests[cpu::kernels::MAX_LANES][5];
+            vector.kernel(kernel, candidates, cpu::kernels::MAX_LANES, digests);
+
+            std::string got = hash::bytes_to_digest((u8*)digests[3], strlen(vector.digest) / 2);
+            if (got != vector.digest)
+                error(
+                    "kernel '%s' mismatches the digest of '%s':\nexp: %s\ngot: %s\n",
+                    cpu::kernels::name(kernel),
+                    vector.input,
+                    vector.digest,
+                    got.c_str());
+        }
+    }
+
+    // Digests of "x7" and "abc" in a file, with an invalid line and a duplicate.
+    std::string contents = "bc8fc96cebf44a9eb1f341bfd6d0b7aadb2c1b04\r\n"
+                           "2436f23b98933a71439259c4bca8674b\n"
+                           "A9993E364706816ABA3E25717850C26C9CD0D89D\n"
+                           "bc8fc96cebf44a9eb1f341bfd6d0b7aadb2c1b04\n";
+    std::string path = write_temp_file(contents);
+
+    cpu::Job job;
+    job.pattern = "ld";
+    job.mode = cpu::Mode::RawSha1;
+    cpu::hashfile::Stats stats;
+    cpu::hashfile::load(path.c_str(), 1, &job, &stats);
+    unlink(path.c_str());
+
+    if (stats.lines != 4 || stats.digests != 3 || stats.invalid != 1 || stats.duplicates != 1 ||
+        job.targets.size() != 2)
+        error("unexpected stats after loading SHA-1 digests\n");
+
+    cpu::Config config;
+    config.thread_count = 2;
+    config.verbose = false;
+
+    config.shuffle_seed = 3;
+
+    cpu::Result result = cpu::run(job, config);
+    const cpu::Target& target = job.targets[result.target_idx];
+    if (!result.found || strcmp((char*)result.passphrase, "x7") != 0 ||
+        hash::bytes_to_digest((u8*)target.hash, 20) != "bc8fc96cebf44a9eb1f341bfd6d0b7aadb2c1b04")
+        error("engine didn't find the SHA-1 preimage\n");
+
+    printf("\t%s() works\n", __func__);
+}
+
+void cpu_potfile() {
+    // SHA-1 digests of "abc" and "x7".
+    cpu::Target abc = cpu::Target{};
+    cpu::Target x7 = cpu::Target{};
+    hash::digest_to_bytes("a9993e364706816aba3e25717850c26c9cd0d89d", abc.hash, 20);
+    hash::digest_to_bytes("bc8fc96cebf44a9eb1f341bfd6d0b7aadb2c1b04", x7.hash, 20);
+
+    std::string path = write_temp_file("");
+    std::string abc_key = cpu::potfile::target_key(cpu::Mode::RawSha1, abc);
+    if (abc_key != "sha1*a9993e364706816aba3e25717850c26c9cd0d89d")
+        error("unexpected potfile key '%s'\n", abc_key.c_str());
+
+    // "x7" was cracked in another mode, the record after it was cut short by a crash.
+    cpu::potfile::append(path.c_str(), abc_key, (const u8*)"abc", 3);
+    cpu::potfile::append(path.c_str(), "md5*2436f23b98933a71439259c4bca8674b", (const u8*)"x7", 2);
+    cpu::potfile::append(path.c_str(), "md5*00", (const u8*)"a\nb", 3);
+    {
+        int fd = open(path.c_str(), O_WRONLY | O_APPEND);
+        if (fd < 0 || write(fd, "md5*01:tor", 10) != 10)
+            error("failed to write temporary file\n");
+        close(fd);
+    }
+    cpu::potfile::append(path.c_str(), "md5*02", (const u8*)"after", 5);
+
+    cpu::potfile::Index index;
+    cpu::potfile::load(path.c_str(), &index);
+
+    std::string passphrase;
+    if (index.count != 4 || !cpu::potfile::find(index, abc_key, &passphrase) ||
+        passphrase != "abc" || !cpu::potfile::find(index, "md5*00", &passphrase) ||
+        passphrase != "a\nb" || !cpu::potfile::find(index, "md5*02", &passphrase) ||
+        passphrase != "after" || cpu::potfile::find(index, "md5*01", &passphrase))
+        error("potfile lookups are off\n");
+
+    // The already cracked target is dropped, the other one is cracked by a known passphrase.
+    cpu::Job job = cpu::Job{
+        .pattern = "ld",
+        .mode = cpu::Mode::RawSha1,
+        .targets = {x7, abc},
+    };
+
+    std::vector<cpu::potfile::Cracked> known = cpu::potfile::drop_cracked(index, &job);
+    std::vector<cpu::potfile::Cracked> reused =
+        cpu::potfile::recheck(index, &job, cpu::kernels::Kernel::Scalar, 1);
+    cpu::potfile::unload(&index);
+    unlink(path.c_str());
+
+    if (known.size() != 1 || known[0].passphrase != "abc" || reused.size() != 1 ||
+        reused[0].passphrase != "x7" || memcmp(reused[0].target.hash, x7.hash, 20) != 0 ||
+        !job.targets.empty())
+        error("potfile didn't drop the cracked targets\n");
+
+    // A cut record longer than the window the repair reads at once only loses itself. A file
+    // without any newline isn't a potfile that was cut short, it is kept.
+    std::string tail(5000, 'x');
+    path = write_temp_file("md5*03:first\nmd5*04:second\n" + tail);
+    cpu::potfile::append(path.c_str(), "md5*05", (const u8*)"third", 5);
+    std::string repaired = read_file(path);
+    if (repaired != "md5*03:first\nmd5*04:second\nmd5*05:third\n")
+        error("potfile repair lost records:\n%.200s\n", repaired.c_str());
+    unlink(path.c_str());
+
+    path = write_temp_file(tail);
+    cpu::potfile::append(path.c_str(), "md5*05", (const u8*)"third", 5);
+    repaired = read_file(path);
+    unlink(path.c_str());
+    if (repaired != tail + "\nmd5*05:third\n")
+        error("potfile repair truncated a file without newlines\n");
+
+    printf("\t%s() works\n", __func__);
+}
+
+void cpu_retire() {
+    // Two targets of one MAC pair and one of another, the second one isn't in the keyspace.
+    const char* passphrases[] = {"ab1", "not in the keyspace", "zz9"};
+    cpu::Job job = cpu::Job{
+        .pattern = "lld",
+        .mode = cpu::Mode::Pmk,
+        .targets = std::vector<cpu::Target>(3),
+    };
+
+    for (u64 idx = 0; idx < job.targets.size(); idx++) {
+        cpu::Target& target = job.targets[idx];
+        hash::mac_to_bytes("00:11:22:33:44:55", target.mac_ap);
+        hash::mac_to_bytes(idx == 2 ? "66:77:88:99:AA:BC" : "66:77:88:99:AA:BB", target.mac_sta);
+        hash::generate_example(passphrases[idx], target.mac_ap, target.mac_sta, target.hash);
+    }
+
+    cpu::targets::Table* table = cpu::targets::new_table(job);
+    cpu::targets::Retired retired(job.targets.size());
+    if (!cpu::targets::retire(&retired, 2) || !cpu::targets::retire(&retired, 1) ||
+        cpu::targets::retire(&retired, 1) || retired.remaining.load() != 1)
+        error("targets were retired more than once\n");
+
+    cpu::targets::compact(table, retired);
+    if (table->group_count != 1 || table->digest_count != 1)
+        error(
+            "compacting left %lld groups and %lld digests\n",
+            table->group_count,
+            table->digest_count);
+
+    u8 batch[2][64] = {"zz9", "ab1"};
+    u64 hits = 0;
+    cpu::targets::check<cpu::modes::Pmk>(
+        cpu::kernels::Kernel::Scalar, table, batch, 2, [&](u64 idx, u64 target_idx) {
+            hits += idx == 1 && target_idx == 0 ? 1 : 100;
+            return true;
+        });
+    cpu::targets::free_table(table);
+
+    if (hits != 1)
+        error("compacted table checks the wrong targets\n");
+
+    // The engine keeps going after the first hit and reports each target once.
+    cpu::Config config;
+    config.thread_count = 2;
+    config.verbose = false;
+    config.all_hits = true;
+
+    u64 reported = 0;
+    config.on_hit = [&](const cpu::Hit&) { reported++; };
+
+    cpu::Result result = cpu::run(job, config);
+    bool found[3] = {false};
+    for (const cpu::Hit& hit : result.hits) {
+        if (found[hit.target_idx] || strcmp((char*)hit.passphrase, passphrases[hit.target_idx]))
+            error("engine reported a wrong or repeated hit\n");
+        found[hit.target_idx] = true;
+    }
+
+    if (!result.found || result.hits.size() != 2 || reported != 2 || !found[0] || !found[2])
+        error("engine didn't find every passphrase\n");
+
+    printf("\t%s() works\n", __func__);
+}
+
+void cpu_hit_queue() {
+    const u64 PRODUCERS = 4;
+    const u64 HITS = 10000;
+
+    u64 reported = 0;
+    std::vector<u64> next(PRODUCERS, 0);
+    bool ordered = true;
+    cpu::hits::Queue queue([&](const cpu::Hit& hit) {
+        // Each producer's hits arrive in the order it pushed them.
+        u64 producer = hit.target_idx / HITS;
+        ordered &= hit.target_idx % HITS == next[producer]++;
+        ordered &= hit.passphrase[0] == (u8)hit.target_idx;
+        reported++;
+    });
+    queue.start();
+
+    std::vector<std::thread> producers;
+    for (u64 pdx = 0; pdx < PRODUCERS; pdx++)
+        producers.emplace_back([&queue, pdx]() {
+            for (u64 idx = 0; idx < HITS; idx++) {
+                cpu::Hit hit = {.target_idx = pdx * HITS + idx, .passphrase = {0}};
+                hit.passphrase[0] = (u8)hit.target_idx;
+                queue.push(hit);
+            }
+        });
+
+    for (std::thread& producer : producers)
+        producer.join();
+
+    std::vector<cpu::Hit> hits = queue.stop();
+    if (!ordered || reported != PRODUCERS * HITS || hits.size() != reported)
+        error("hit queue lost or reordered hits\n");
+
+    printf("\t%s() works\n", __func__);
+}
+
+// SHA-1 of "abc" searched with `lll`, a run that hits within the first few thousand candidates.
+cpu::Job abc_sha1_job() {
+    cpu::Job job = cpu::Job{
+        .pattern = "lll",
+        .mode = cpu::Mode::RawSha1,
+        .targets = std::vector<cpu::Target>(1),
+    };
+    hash::digest_to_bytes("a9993e364706816aba3e25717850c26c9cd0d89d", job.targets[0].hash, 20);
+    return job;
+}
+
+void cpu_trace() {
+    cpu::Job job = abc_sha1_job();
+
+    std::string path = write_temp_file("");
+
+    cpu::Config config;
+    config.thread_count = 2;
+    config.verbose = false;
+    config.trace_path = path.c_str();
+    config.trace_sample = 1;
+
+    cpu::Result result = cpu::run(job, config);
+    if (!result.found || strcmp((char*)result.passphrase, "abc") != 0)
+        error("engine didn't find 'abc' while tracing\n");
+
+    std::string trace = read_file(path);
+    unlink(path.c_str());
+
+    for (const char* expected :
+         {"\"traceEvents\"",
+          "\"name\": \"reporter\"",
+          "\"name\": \"stride\"",
+          "\"name\": \"generate\"",
+          "\"name\": \"check\"",
+          "\"name\": \"hit\""}) {
+        if (trace.find(expected) == std::string::npos)
+            error("trace is missing %s\n", expected);
+    }
+
+    if (!trace.ends_with("\n]}\n"))
+        error("trace isn't terminated\n");
+
+    printf("\t%s() works\n", __func__);
+}
+
+void cpu_metrics() {
+    cpu::Job job = abc_sha1_job();
+
+    std::string json_path = write_temp_file("");
+    std::string prometheus_path = write_temp_file("");
+
+    cpu::Config config;
+    config.thread_count = 2;
+    config.verbose = false;
+    config.metrics_path = json_path.c_str();
+    config.prometheus_path = prometheus_path.c_str();
+
+    cpu::Result result = cpu::run(job, config);
+    if (!result.found)
+        error("engine didn't find 'abc' while exporting metrics\n");
+
+    // The run ends before the first interval, so the final sample is the only one.
+    std::string lines = read_file(json_path);
+    std::string text = read_file(prometheus_path);
+    unlink(json_path.c_str());
+    unlink(prometheus_path.c_str());
+
+    for (const char* expected :
+         {"\"mode\": \"sha1\"", "\"hits\": 1,", "\"finished\": true", "\"threads\": [{"}) {
+        if (lines.find(expected) == std::string::npos)
+            error("metrics line is missing %s:\n%s", expected, lines.c_str());
+    }
+
+    for (const char* expected :
+         {"# TYPE metaling_hashes_total counter\n",
+          "metaling_hits_total{mode=\"sha1\",kernel=",
+          "metaling_thread_hashes_total{",
+          "metaling_running{"}) {
+        if (text.find(expected) == std::string::npos)
+            error("prometheus file is missing %s:\n%s", expected, text.c_str());
+    }
+
+    printf("\t%s() works\n", __func__);
+}
+
+void cpu_tuning() {
+    std::string path =
+        write_temp_file("other-host\tmodel\t4\tmd5\tscalar\tsmt\t4\t4096\t1.0\t0.0\n");
+    cpu::topology::Topology topo = cpu::topology::discover();
+
+    cpu::tuning::Tuning sha1 = cpu::tuning::Tuning{
+        .kernel = cpu::kernels::Kernel::Scalar,
+        .smt = false,
+        .thread_count = 3,
+        .stride = 1 << 12,
+        .rate = 1000.0,
+        .cancel_latency = 0.01,
+    };
+    cpu::tuning::Tuning md5 = sha1;
+    md5.thread_count = 1;
+
+    // Storing a mode again replaces its entry, other hosts and modes are kept.
+    cpu::tuning::Tuning loaded;
+    if (cpu::tuning::load(path, topo, cpu::Mode::RawMd5, &loaded))
+        error("tuning of another host was loaded\n");
+    cpu::tuning::store(path, topo, cpu::Mode::RawSha1, sha1);
+    cpu::tuning::store(path, topo, cpu::Mode::RawMd5, sha1);
+    cpu::tuning::store(path, topo, cpu::Mode::RawMd5, md5);
+
+    if (!cpu::tuning::load(path, topo, cpu::Mode::RawMd5, &loaded) || loaded.thread_count != 1)
+        error("stored md5 tuning wasn't loaded\n");
+    if (!cpu::tuning::load(path, topo, cpu::Mode::RawSha1, &loaded) || loaded.thread_count != 3 ||
+        loaded.smt || loaded.stride != 1 << 12 || loaded.kernel != cpu::kernels::Kernel::Scalar)
+        error("stored sha1 tuning wasn't loaded\n");
+
+    // A cached entry fills in what the config leaves open, but a fixed thread count or stride wins.
+    cpu::Config config;
+    config.verbose = false;
+    cpu::Config fixed = config;
+    fixed.thread_count = 2;
+    fixed.stride = 1 << 14;
+    cpu::tuning::apply(cpu::Mode::RawSha1, path.c_str(), &config);
+    cpu::tuning::apply(cpu::Mode::RawSha1, path.c_str(), &fixed);
+
+    if (config.kernel != cpu::kernels::Kernel::Scalar || config.smt || config.thread_count != 3 ||
+        config.stride != 1 << 12)
+        error("cached sha1 tuning wasn't applied\n");
+    if (fixed.kernel != cpu::kernels::Kernel::Scalar || fixed.thread_count != 2 ||
+        fixed.stride != 1 << 14)
+        error("cached sha1 tuning overrode the fixed thread count or stride\n");
+
+    std::string text = read_file(path);
+    if (text.find("other-host") == std::string::npos)
+        error("tuning of another host was dropped:\n%s", text.c_str());
+
+    // A cache that can't be written, here below a regular file, is skipped rather than fatal.
+    if (cpu::tuning::store(path + "/tuning.tsv", topo, cpu::Mode::RawSha1, sha1))
+        error("tuning was stored below a regular file\n");
+    unlink(path.c_str());
+
+    // A stride other than the default still covers the whole keyspace.
+    config = cpu::Config();
+    config.thread_count = 2;
+    config.stride = 1 << 4;
+    config.verbose = false;
+
+    cpu::Result result = cpu::run(abc_sha1_job(), config);
+    if (!result.found || memcmp(result.passphrase, "abc", 4) != 0)
+        error("engine didn't find 'abc' with a stride of %lld\n", config.stride);
+
+    printf("\t%s() works\n", __func__);
+}
+
+// Sends `request` to the daemon at `path` and returns everything it replies until it hangs up.
+std::string daemon_request(const char* path, const std::string& request) {
+    sockaddr_un addr = {.sun_family = AF_UNIX, .sun_path = {0}};
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    for (u64 attempt = 0; connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0; attempt++) {
+        if (attempt == 100)
+            error("failed to connect to the daemon\n");
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    if (write(fd, request.data(), request.size()) != (i64)request.size())
+        error("failed to send a request to the daemon\n");
+    shutdown(fd, SHUT_WR);
+
+    std::string reply;
+    char chunk[4096];
+    while (true) {
+        ssize_t len = read(fd, chunk, sizeof(chunk));
+        if (len <= 0)
+            break;
+        reply.append(chunk, len);
+    }
+    close(fd);
+
+    return reply;
+}
+
+void cpu_daemon() {
+    std::string path = "/tmp/metaling-test-" + std::to_string(getpid()) + ".sock";
+
+    cpu::Config config;
+    config.thread_count = 2;
+    config.verbose = false;
+
+    std::atomic<bool> stop = false;
+    std::thread server([&]() { cpu::daemon::serve(path.c_str(), config, &stop); });
+
+    // Two jobs on the same pool, the digest of "abc" and of "x7" from `cpu_raw_modes`.
+    std::string first = daemon_request(
+        path.c_str(), "job sha1 lll 5\na9993e364706816aba3e25717850c26c9cd0d89d\n\n");
+    std::string second =
+        daemon_request(path.c_str(), "job sha1 ld\nbc8fc96cebf44a9eb1f341bfd6d0b7aadb2c1b04\n");
+    std::string invalid = daemon_request(path.c_str(), "job sha1 lxl\n");
+
+    stop.store(true);
+    server.join();
+
+    if (first.find("queued 1 1 ") != 0 || first.find("\nstarted 1\n") == std::string::npos ||
+        first.find("\nhit 1 ") == std::string::npos || first.find(":abc\n") == std::string::npos ||
+        first.find("\ndone 1 1 ") == std::string::npos)
+        error("unexpected reply to the first daemon job:\n%s", first.c_str());
+
+    if (second.find(":x7\n") == std::string::npos ||
+        second.find("\ndone 2 1 ") == std::string::npos)
+        error("unexpected reply to the second daemon job:\n%s", second.c_str());
+
+    if (invalid.find("error invalid pattern") != 0)
+        error("daemon accepted an invalid pattern:\n%s", invalid.c_str());
+
+    if (access(path.c_str(), F_OK) == 0)
+        error("daemon left its socket behind\n");
+
+    printf("\t%s() works\n", __func__);
+}
+
+void cpu_engine() {
+    cpu::Job job = cpu::Job{
+        .pattern = "llld",
+        .mode = cpu::Mode::Pmk,
+        .targets = std::vector<cpu::Target>(2),
+    };
+
+    for (u64 idx = 0; idx < job.targets.size(); idx++) {
+        cpu::Target& target = job.targets[idx];
+        hash::mac_to_bytes("00:11:22:33:44:55", target.mac_ap);
+        hash::mac_to_bytes(idx ? "66:77:88:99:AA:BB" : "66:77:88:99:AA:BC", target.mac_sta);
+        const char* passphrase = idx ? "lol1" : "not in the keyspace";
+        hash::generate_example(passphrase, target.mac_ap, target.mac_sta, target.hash);
+    }
+
+    cpu::Config config;
+    config.thread_count = 2;
+    config.verbose = false;
+
+    // Runs the same whether or not the sandbox lets us open hardware counters.
+    config.perf_report = true;
+
+    cpu::Result result = cpu::run(job, config);
+    if (!result.found || result.target_idx != 1 || strcmp((char*)result.passphrase, "lol1") != 0)
+        error("engine didn't find the example passphrase\n");
+    if (result.perf.hashes == 0)
+        error("engine didn't count the hashes of its perf report\n");
+
+    printf("\t%s() works\n", __func__);
+}
+
+#if defined(METALING_METAL)
+
 void sha1() {
     auto pool = metal::new_scoped_memory_pool();
 
@@ -114,14 +1249,37 @@ void sha1_hmac() {
         printf("\t%s() works\n", __func__);
 }
 
+#endif
+
 void run() {
+    printf("tests:\n");
+    cpu_kernels();
+    cpu_decoder();
+    cpu_permutation();
+    cpu_generator();
+    cpu_wpa_pmk();
+    cpu_hashfile();
+    cpu_eapol();
+    cpu_pmkid_sha256();
+    cpu_capture();
+    cpu_raw_modes();
+    cpu_potfile();
+    cpu_retire();
+    cpu_hit_queue();
+    cpu_trace();
+    cpu_metrics();
+    cpu_daemon();
+    cpu_tuning();
+    cpu_engine();
+
+#if defined(METALING_METAL)
     // metal::start_capture("metaling.gputrace");
 
-    printf("tests:\n");
     sha1();
     sha1_hmac();
 
     // metal::stop_capture();
+#endif
 }
 
 }